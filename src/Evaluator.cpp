@@ -5,54 +5,130 @@
 #include "common/Timer.hpp"
 #include "simulation/Car.hpp"
 #include "simulation/Track.hpp"
+#include "simulation/TrackSuite.hpp"
 #include "simulation/World.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 using namespace learning;
 using namespace simulation;
 
-static constexpr unsigned NUM_EPISODES = 10;
 static constexpr unsigned EPISODE_LENGTH = 100;
 
-static vector<sptr<Track>> generateTestTracks(unsigned num) {
-  vector<sptr<Track>> result;
-  for (unsigned i = 0; i < num; i++) {
-    result.push_back(
-        make_shared<Track>(TrackSpec(TRACK_RADIUS, TRACK_MIN_WIDTH, TRACK_MAX_WIDTH,
-                                     TRACK_NUM_POINTS, TRACK_COLOR_PALETTE, TRACK_MAX_SKEW)));
-  }
-  return result;
+// Every evaluation plays on the same suite of tracks, generated from a fixed seed, so scores are
+// comparable between evaluations and between runs. Episode i plays on track i of the suite,
+// wrapping around if there are more episodes than tracks. The suite is cached in this file, or
+// regenerated on every run if it is null.
+static constexpr const char *TRACK_SUITE_FILE = "evaluation_tracks.suite";
+static constexpr unsigned TRACK_SUITE_SIZE = 200;
+static constexpr uint32_t TRACK_SUITE_SEED = 1;
+
+// The most episodes a thread plays in lockstep. Large enough that the batched network evaluation
+// pays off, small enough that a few hundred episodes still divide among all the cores.
+static constexpr unsigned MAX_EPISODES_PER_BATCH = 16;
+
+// Loaded on first use, then shared by all evaluations.
+static const TrackSuite &trackSuite(void) {
+  static TrackSuite suite(TrackSpec(TRACK_RADIUS, TRACK_MIN_WIDTH, TRACK_MAX_WIDTH,
+                                    TRACK_NUM_POINTS, TRACK_COLOR_PALETTE, TRACK_MAX_SKEW),
+                          TRACK_SUITE_SIZE, TRACK_SUITE_SEED,
+                          TRACK_SUITE_FILE == nullptr ? "" : TRACK_SUITE_FILE);
+  return suite;
 }
 
-float Evaluator::Evaluate(Agent *agent) {
-  vector<sptr<Track>> tracks = generateTestTracks(NUM_EPISODES);
+static State observeState(World *world) {
+  pair<vector<ColorRGB>, vector<ColorRGB>> eyeView = world->GetCar()->EyeView(world->GetTrack());
+  // State observedState(eyeView.first, eyeView.second);
+  Vector2 nextWaypoint = world->NextWaypoint();
+  Vector2 toNextWaypoint = (nextWaypoint - world->GetCar()->GetPos()).normalised();
+
+  return State(eyeView.first, eyeView.second, world->GetCar()->SonarView(world->GetTrack()),
+               world->GetProgress(), world->GetCar()->RelVelocity(),
+               world->GetCar()->RelHeading(toNextWaypoint));
+}
+
+// All of the episodes in a batch are run in lockstep, so the agent can select the actions for every
+// episode with a single batched network evaluation. Returns the total reward.
+static float runBatch(Agent *agent, unsigned firstEpisode, unsigned numEpisodes) {
+  const TrackSuite &suite = trackSuite();
+
+  vector<uptr<World>> worlds;
+  for (unsigned i = firstEpisode; i < firstEpisode + numEpisodes; i++) {
+    unsigned track = i % suite.NumTracks();
+    worlds.push_back(make_unique<World>(
+        suite.GetTrack(track), CarDef(CAR_SIZE, CAR_EYE_SEPARATION, CAR_TURN_RATE, CAR_ACCEL_RATE),
+        suite.StartSegment(track)));
+  }
+  uptr<Agent::BatchMemory> memory = agent->NewBatchMemory(worlds.size());
 
   float reward = 0.0f;
-  for (const auto &track : tracks) {
-    agent->ResetMemory();
-    uptr<World> world = make_unique<World>(
-        track, CarDef(CAR_SIZE, CAR_EYE_SEPARATION, CAR_TURN_RATE, CAR_ACCEL_RATE));
-
-    for (unsigned j = 0; j < EPISODE_LENGTH; j++) {
-      pair<vector<ColorRGB>, vector<ColorRGB>> eyeView =
-          world->GetCar()->EyeView(world->GetTrack());
-      // State observedState(eyeView.first, eyeView.second);
-      Vector2 nextWaypoint = world->GetTrack()->NextWaypoint(world->GetCar()->GetPos());
-      Vector2 toNextWaypoint = (nextWaypoint - world->GetCar()->GetPos()).normalised();
-
-      State observedState(eyeView.first, eyeView.second,
-                          world->GetCar()->SonarView(world->GetTrack()), world->GetProgress(),
-                          world->GetCar()->RelVelocity(),
-                          world->GetCar()->RelHeading(toNextWaypoint));
-      Action performedAction = agent->SelectAction(&observedState);
-
-      world->GetCar()->SetAcceleration(performedAction.GetAcceleration());
-      world->GetCar()->SetTurn(performedAction.GetTurn());
+  vector<State> observedStates;
+  observedStates.reserve(worlds.size());
+
+  for (unsigned j = 0; j < EPISODE_LENGTH; j++) {
+    observedStates.clear();
+    for (const auto &world : worlds) {
+      observedStates.push_back(observeState(world.get()));
+    }
+
+    vector<Action> performedActions = agent->SelectBatchActions(observedStates, *memory);
+    assert(performedActions.size() == worlds.size());
+
+    for (unsigned i = 0; i < worlds.size(); i++) {
+      worlds[i]->GetCar()->SetAcceleration(performedActions[i].GetAcceleration());
+      worlds[i]->GetCar()->SetTurn(performedActions[i].GetTurn());
 
       for (unsigned k = 0; k < STEPS_PER_ACTION; k++) {
-        reward += world->Update(STEP_LENGTH_SECS);
+        reward += worlds[i]->Update(STEP_LENGTH_SECS);
       }
     }
   }
 
-  return reward / NUM_EPISODES;
+  return reward;
+}
+
+float Evaluator::Evaluate(Agent *agent, unsigned numEpisodes) {
+  assert(agent != nullptr && numEpisodes > 0);
+
+  unsigned cores = max(1u, std::thread::hardware_concurrency());
+  unsigned numBatches = max((numEpisodes + MAX_EPISODES_PER_BATCH - 1) / MAX_EPISODES_PER_BATCH,
+                            min(cores, numEpisodes));
+  unsigned numThreads = min(cores, numBatches);
+
+  // Built before the threads start, rather than by whichever thread gets there first.
+  trackSuite();
+
+  // The batches are handed out as threads become free. Each batch's reward has its own slot and
+  // they are summed in order, so the result doesn't depend on which thread ran which batch.
+  atomic<unsigned> nextBatch(0);
+  vector<float> batchRewards(numBatches, 0.0f);
+
+  vector<std::thread> threads;
+  for (unsigned t = 0; t < numThreads; t++) {
+    threads.emplace_back([agent, numEpisodes, numBatches, &nextBatch, &batchRewards]() {
+      for (unsigned b = nextBatch++; b < numBatches; b = nextBatch++) {
+        unsigned start = b * numEpisodes / numBatches;
+        unsigned end = (b + 1) * numEpisodes / numBatches;
+        batchRewards[b] = runBatch(agent, start, end - start);
+      }
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  float reward = 0.0f;
+  for (float batchReward : batchRewards) {
+    reward += batchReward;
+  }
+
+  return reward / numEpisodes;
+}
+
+std::future<float> Evaluator::EvaluateAsync(Agent *agent, unsigned numEpisodes) {
+  return std::async(std::launch::async, [agent, numEpisodes]() {
+    return Evaluator::Evaluate(agent, numEpisodes);
+  });
 }
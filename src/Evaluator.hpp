@@ -1,8 +1,19 @@
 #pragma once
 
 #include "learning/Agent.hpp"
+#include <future>
 
 namespace Evaluator {
 
-float Evaluate(learning::Agent *agent);
+static constexpr unsigned DEFAULT_EPISODES = 10;
+
+// Average reward of the agent over numEpisodes episodes, played on a fixed, seeded suite of tracks
+// that is shared by every evaluation. The episodes are spread over a thread per core, each playing
+// its share in lockstep batches with their own recurrent memory, so the agent must support
+// concurrent SelectBatchActions calls.
+float Evaluate(learning::Agent *agent, unsigned numEpisodes = DEFAULT_EPISODES);
+
+// Same as Evaluate, but runs in the background, so the caller can carry on in the meantime. The
+// agent must outlive the evaluation.
+std::future<float> EvaluateAsync(learning::Agent *agent, unsigned numEpisodes = DEFAULT_EPISODES);
 };
@@ -0,0 +1,158 @@
+// Round trip test for ModelCheckpoint. Checks that weights come back bit for bit through the
+// write and mapped read path, for a network as well as for the raw format, and that a file with a
+// flipped byte, a truncated file and one of the wrong format version are all rejected. A rejected
+// file exits the process, so each of those is opened in a child process. Exits with 1 on failure.
+
+#include "../common/Common.hpp"
+#include "../math/Math.hpp"
+#include "../rnn/ModelCheckpoint.hpp"
+#include "../rnn/RNN.hpp"
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const char *CHECKPOINT_PATH = "checkpoint_round_trip.model";
+static const char *OTHER_PATH = "checkpoint_round_trip_other.model";
+
+// Offset of the format version in the header, just after the 8 byte magic.
+static constexpr size_t VERSION_OFFSET = 8;
+
+static unsigned numFailures = 0;
+
+static void check(bool ok, const string &what) {
+  std::cout << (ok ? "ok: " : "FAILED: ") << what << std::endl;
+  if (!ok) {
+    numFailures++;
+  }
+}
+
+static rnn::RNNSpec testSpec(void) {
+  rnn::RNNSpec spec;
+
+  spec.numInputs = 11;
+  spec.numOutputs = 9;
+  spec.hiddenActivation = rnn::LayerActivation::TANH;
+  spec.outputActivation = rnn::LayerActivation::LINEAR;
+  spec.nodeActivationRate = 1.0f;
+  spec.maxBatchSize = 4;
+  spec.maxTraceLength = 2;
+  spec.trainerBackend = rnn::TrainerBackend::CPU;
+
+  spec.connections.emplace_back(0, 1, 0);
+  spec.connections.emplace_back(1, 2, 0);
+  spec.connections.emplace_back(2, 3, 0);
+  spec.connections.emplace_back(2, 2, 1);
+
+  spec.layers.emplace_back(1, 64, false);
+  spec.layers.emplace_back(2, 33, false); // not a multiple of the alignment.
+  spec.layers.emplace_back(3, spec.numOutputs, true);
+
+  return spec;
+}
+
+static unsigned layerSize(const rnn::RNNSpec &spec, unsigned layerId) {
+  if (layerId == 0) {
+    return spec.numInputs;
+  }
+  for (const auto &ls : spec.layers) {
+    if (ls.uid == layerId) {
+      return ls.numNodes;
+    }
+  }
+  assert(false);
+  return 0;
+}
+
+static vector<uint8_t> readFile(const string &path) {
+  std::ifstream in(path, std::ios::binary);
+  return vector<uint8_t>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const string &path, const vector<uint8_t> &bytes) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+}
+
+// Whether opening the file at path exits the process with an error.
+static bool isRejected(const string &path) {
+  std::cout.flush();
+  pid_t pid = fork();
+  if (pid == 0) {
+    rnn::ModelCheckpoint checkpoint(path);
+    _exit(0);
+  }
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) != 0;
+}
+
+int main(void) {
+  srand(1234);
+  rnn::RNNSpec spec = testSpec();
+
+  // Weights with arbitrary bit patterns, including a denormal and a negative zero.
+  vector<EMatrix> matrices;
+  vector<pair<rnn::LayerConnection, const EMatrix *>> weights;
+  for (const auto &c : spec.connections) {
+    matrices.emplace_back(layerSize(spec, c.dstLayerId), layerSize(spec, c.srcLayerId) + 1);
+  }
+  for (unsigned i = 0; i < spec.connections.size(); i++) {
+    EMatrix &m = matrices[i];
+    for (int j = 0; j < m.size(); j++) {
+      m.data()[j] = math::RandInterval(-1.0f, 1.0f);
+    }
+    m(0, 0) = 1e-40f;
+    m(0, 1) = -0.0f;
+    weights.emplace_back(spec.connections[i], &m);
+  }
+
+  rnn::ModelCheckpoint::Write(CHECKPOINT_PATH, spec, weights);
+  {
+    rnn::ModelCheckpoint checkpoint(CHECKPOINT_PATH);
+    bool exact = checkpoint.Spec().connections.size() == spec.connections.size() &&
+                 checkpoint.Spec().layers.size() == spec.layers.size();
+    for (unsigned i = 0; i < spec.connections.size(); i++) {
+      Eigen::Map<const EMatrix> read = checkpoint.Weights(spec.connections[i]);
+      exact = exact && read.rows() == matrices[i].rows() && read.cols() == matrices[i].cols() &&
+              memcmp(read.data(), matrices[i].data(), matrices[i].size() * sizeof(float)) == 0;
+    }
+    check(exact, "weights round trip bit for bit");
+  }
+
+  // A network read from a checkpoint writes out the same file again.
+  {
+    rnn::ModelCheckpoint checkpoint(CHECKPOINT_PATH);
+    uptr<rnn::RNN> network = rnn::RNN::Read(checkpoint);
+    network->WriteCheckpoint(OTHER_PATH);
+    check(readFile(OTHER_PATH) == readFile(CHECKPOINT_PATH), "network round trip bit for bit");
+  }
+
+  vector<uint8_t> original = readFile(CHECKPOINT_PATH);
+
+  vector<uint8_t> flipped = original;
+  flipped[flipped.size() / 2] ^= 0x10;
+  writeFile(OTHER_PATH, flipped);
+  check(isRejected(OTHER_PATH), "flipped byte rejected");
+
+  vector<uint8_t> truncated(original.begin(), original.end() - 100);
+  writeFile(OTHER_PATH, truncated);
+  check(isRejected(OTHER_PATH), "truncated file rejected");
+
+  vector<uint8_t> wrongVersion = original;
+  wrongVersion[VERSION_OFFSET] ^= 0xff;
+  writeFile(OTHER_PATH, wrongVersion);
+  check(isRejected(OTHER_PATH), "wrong version rejected");
+
+  remove(CHECKPOINT_PATH);
+  remove(OTHER_PATH);
+
+  return numFailures == 0 ? 0 : 1;
+}
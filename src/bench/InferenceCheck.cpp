@@ -0,0 +1,139 @@
+// Checks that every inference path gives the same outputs for the same trained weights: single
+// step Process on the compile time specialized FixedRNN, single step Process on the generic
+// forward pass, and ProcessBatch. The network is trained first, as untrained weights are small
+// enough for the output activation to hardly matter. Exits with 1 if any output disagrees.
+
+#include "../common/Common.hpp"
+#include "../math/Math.hpp"
+#include "../rnn/FixedRNN.hpp"
+#include "../rnn/ModelCheckpoint.hpp"
+#include "../rnn/RNN.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+static constexpr unsigned NUM_TRAIN_STEPS = 300;
+static constexpr unsigned TRAIN_BATCH_SIZE = 32;
+static constexpr unsigned TRAIN_TRACE_LENGTH = 4;
+static constexpr float TRAIN_REWARD = 3.0f;
+static constexpr float TRAIN_LEARN_RATE = 0.1f;
+
+static constexpr unsigned NUM_STATES = 8;
+static constexpr unsigned EPISODE_LENGTH = 20;
+static constexpr float TOLERANCE = 1e-4f;
+
+using DeployedRNN = rnn::FixedRNN<11, 64, 128, 9>;
+
+// Same topology as the network built by LearningAgent.
+static rnn::RNNSpec checkSpec(void) {
+  rnn::RNNSpec spec;
+
+  spec.numInputs = 11;
+  spec.numOutputs = 9;
+  spec.hiddenActivation = rnn::LayerActivation::TANH;
+  spec.outputActivation = rnn::LayerActivation::LINEAR;
+  spec.nodeActivationRate = 1.0f;
+  spec.maxBatchSize = TRAIN_BATCH_SIZE;
+  spec.maxTraceLength = TRAIN_TRACE_LENGTH;
+  spec.trainerBackend = rnn::TrainerBackend::CPU;
+
+  spec.connections.emplace_back(0, 1, 0);
+  spec.connections.emplace_back(1, 2, 0);
+  spec.connections.emplace_back(2, 3, 0);
+  spec.connections.emplace_back(2, 2, 1);
+
+  spec.layers.emplace_back(1, 64, false);
+  spec.layers.emplace_back(2, 128, false);
+  spec.layers.emplace_back(3, spec.numOutputs, true);
+
+  return spec;
+}
+
+static EMatrix randomMatrix(unsigned rows, unsigned cols) {
+  EMatrix result(rows, cols);
+  for (int r = 0; r < result.rows(); r++) {
+    for (int c = 0; c < result.cols(); c++) {
+      result(r, c) = math::RandInterval(-1.0f, 1.0f);
+    }
+  }
+  return result;
+}
+
+// Trains every action towards a constant reward, so the outputs end up well outside the range of
+// the hidden activation.
+static void train(rnn::RNN &network) {
+  rnn::RNNSpec spec = network.GetSpec();
+
+  for (unsigned i = 0; i < NUM_TRAIN_STEPS; i++) {
+    vector<rnn::SliceBatch> trace;
+    for (unsigned j = 0; j < TRAIN_TRACE_LENGTH; j++) {
+      EMatrix actions = EMatrix::Zero(TRAIN_BATCH_SIZE, spec.numOutputs);
+      for (unsigned b = 0; b < TRAIN_BATCH_SIZE; b++) {
+        actions(b, rand() % spec.numOutputs) = 1.0f;
+      }
+
+      trace.emplace_back(randomMatrix(TRAIN_BATCH_SIZE, spec.numInputs), actions,
+                         EMatrix::Constant(TRAIN_BATCH_SIZE, 1, TRAIN_REWARD));
+    }
+
+    network.Update(trace, TRAIN_LEARN_RATE);
+    if (i % 50 == 49) {
+      network.RefreshAndGetTarget();
+    }
+  }
+  network.RefreshAndGetTarget();
+}
+
+int main(void) {
+  srand(1234);
+
+  auto fixed = make_shared<rnn::FixedInferenceFor<DeployedRNN>>();
+  rnn::RNN network(checkSpec(), fixed);
+  train(network);
+
+  // The same weights, without the FixedRNN, for the generic single step path.
+  string path = "inference_check.model";
+  network.WriteCheckpoint(path);
+  uptr<rnn::RNN> generic;
+  {
+    rnn::ModelCheckpoint checkpoint(path);
+    generic = rnn::RNN::Read(checkpoint);
+  }
+  remove(path.c_str());
+
+  uptr<rnn::RNNBatchState> batchState = network.NewBatchState(NUM_STATES);
+  vector<uptr<rnn::RNNState>> fixedStates, genericStates;
+  for (unsigned i = 0; i < NUM_STATES; i++) {
+    fixedStates.push_back(network.NewState());
+    genericStates.push_back(generic->NewState());
+  }
+
+  float maxError = 0.0f;
+  float maxOutput = 0.0f;
+  EMatrix batchOutputs;
+  EVector fixedOutput, genericOutput;
+
+  for (unsigned step = 0; step < EPISODE_LENGTH; step++) {
+    EMatrix inputs = randomMatrix(NUM_STATES, network.GetSpec().numInputs);
+    network.ProcessBatch(inputs, *batchState, batchOutputs);
+
+    for (unsigned i = 0; i < NUM_STATES; i++) {
+      EVector input = inputs.row(i).transpose();
+      network.Process(input, *fixedStates[i], fixedOutput);
+      generic->Process(input, *genericStates[i], genericOutput);
+
+      EVector batchOutput = batchOutputs.row(i).transpose();
+      maxError = std::max(maxError, (fixedOutput - batchOutput).cwiseAbs().maxCoeff());
+      maxError = std::max(maxError, (genericOutput - batchOutput).cwiseAbs().maxCoeff());
+      maxOutput = std::max(maxOutput, batchOutput.cwiseAbs().maxCoeff());
+    }
+  }
+
+  std::cout << "largest output " << maxOutput << ", largest difference " << maxError << std::endl;
+  if (!(maxError <= TOLERANCE * std::max(1.0f, maxOutput))) {
+    std::cout << "FAILED: inference paths disagree" << std::endl;
+    return 1;
+  }
+  return 0;
+}
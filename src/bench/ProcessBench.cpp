@@ -0,0 +1,146 @@
+// Microbenchmark for single step and batched RNN inference. Reports the time per step and the number of heap
+// allocations made by RNN::Process. Allocations are counted by wrapping glibc's malloc, which
+// catches both operator new and Eigen's own allocations.
+
+#include "../common/Common.hpp"
+#include "../common/Timer.hpp"
+#include "../math/Math.hpp"
+#include "../rnn/RNN.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+
+static std::atomic<unsigned long> numAllocs(0);
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t num, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+  numAllocs++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size) {
+  numAllocs++;
+  return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  numAllocs++;
+  return __libc_realloc(ptr, size);
+}
+}
+
+static constexpr unsigned NUM_STEPS = 100000;
+static constexpr unsigned EPISODE_LENGTH = 1000;
+
+// Same topology as the network built by LearningAgent.
+static rnn::RNNSpec benchSpec(void) {
+  rnn::RNNSpec spec;
+
+  spec.numInputs = 11;
+  spec.numOutputs = 9;
+  spec.hiddenActivation = rnn::LayerActivation::TANH;
+  spec.outputActivation = rnn::LayerActivation::LINEAR;
+  spec.nodeActivationRate = 1.0f;
+  spec.maxBatchSize = 1;
+  spec.maxTraceLength = 1;
+  spec.trainerBackend = rnn::TrainerBackend::CPU;
+
+  spec.connections.emplace_back(0, 1, 0);
+  spec.connections.emplace_back(1, 2, 0);
+  spec.connections.emplace_back(2, 3, 0);
+  spec.connections.emplace_back(2, 2, 1);
+
+  spec.layers.emplace_back(1, 64, false);
+  spec.layers.emplace_back(2, 128, false);
+  spec.layers.emplace_back(3, spec.numOutputs, true);
+
+  return spec;
+}
+
+static void runBench(const char *name, rnn::RNN &network, const EVector &input, bool byReference) {
+  uptr<rnn::RNNState> state = network.NewState();
+  EVector output(network.GetSpec().numOutputs);
+  float checksum = 0.0f;
+
+  Timer timer;
+  timer.Start();
+  unsigned long allocsBefore = numAllocs;
+
+  for (unsigned i = 0; i < NUM_STEPS; i++) {
+    if (i % EPISODE_LENGTH == 0) {
+      state->Clear();
+    }
+
+    if (byReference) {
+      network.Process(input, *state, output);
+    } else {
+      output = network.Process(input, *state);
+    }
+    checksum += output(0);
+  }
+
+  unsigned long allocs = numAllocs - allocsBefore;
+  timer.Stop();
+
+  float usPerStep = timer.GetIntervalElapsedSeconds() * 1000000.0f / NUM_STEPS;
+  std::cout << name << ": " << usPerStep << " us/step, "
+            << static_cast<float>(allocs) / NUM_STEPS << " allocs/step (checksum " << checksum
+            << ")" << std::endl;
+}
+
+// Steps batchSize independent states per call, reports the time per state step.
+static void runBatchBench(rnn::RNN &network, const EVector &input, unsigned batchSize) {
+  uptr<rnn::RNNBatchState> states = network.NewBatchState(batchSize);
+
+  EMatrix inputs(batchSize, input.rows());
+  inputs.rowwise() = input.transpose();
+  EMatrix outputs(batchSize, network.GetSpec().numOutputs);
+
+  unsigned numCalls = NUM_STEPS / batchSize;
+  float checksum = 0.0f;
+
+  Timer timer;
+  timer.Start();
+  unsigned long allocsBefore = numAllocs;
+
+  for (unsigned i = 0; i < numCalls; i++) {
+    if (i % EPISODE_LENGTH == 0) {
+      states->ClearAll();
+    }
+
+    network.ProcessBatch(inputs, *states, outputs);
+    checksum += outputs(0, 0);
+  }
+
+  unsigned long allocs = numAllocs - allocsBefore;
+  timer.Stop();
+
+  float usPerStep = timer.GetIntervalElapsedSeconds() * 1000000.0f / (numCalls * batchSize);
+  std::cout << "ProcessBatch (" << batchSize << " states): " << usPerStep << " us/step, "
+            << static_cast<float>(allocs) / numCalls << " allocs/call (checksum " << checksum
+            << ")" << std::endl;
+}
+
+int main(void) {
+  srand(1234);
+
+  rnn::RNN network(benchSpec());
+
+  EVector input(network.GetSpec().numInputs);
+  for (int i = 0; i < input.rows(); i++) {
+    input(i) = math::RandInterval(-1.0f, 1.0f);
+  }
+
+  runBench("Process (by value)", network, input, false);
+  runBench("Process (by reference)", network, input, true);
+
+  for (unsigned batchSize : {10, 64, 256}) {
+    runBatchBench(network, input, batchSize);
+  }
+
+  return 0;
+}
@@ -0,0 +1,120 @@
+// Benchmark for Track::IntersectRay and the packet IntersectRays against the brute force reference,
+// on tracks generated with the standard TrackSpec. Rays are cast in random directions from points
+// along the track centre line, which is where the car's eye and sonar rays start from. Each origin
+// gets as many rays as one eye samples, and these form one IntersectRays call.
+
+#include "../Constants.hpp"
+#include "../common/Common.hpp"
+#include "../common/Timer.hpp"
+#include "../math/Math.hpp"
+#include "../simulation/Track.hpp"
+#include <cmath>
+#include <iostream>
+
+using namespace simulation;
+
+static constexpr unsigned NUM_TRACKS = 20;
+static constexpr unsigned RAYS_PER_ORIGIN = PIXELS_PER_EYE * SAMPLER_PER_PIXEL;
+static constexpr unsigned RAYS_PER_TRACK = RAYS_PER_ORIGIN * 300;
+
+struct Ray {
+  Vector2 start;
+  Vector2 dir;
+};
+
+static vector<Ray> generateRays(const Track &track) {
+  vector<Ray> result;
+  result.reserve(RAYS_PER_TRACK);
+
+  Vector2 origin;
+  for (unsigned i = 0; i < RAYS_PER_TRACK; i++) {
+    if (i % RAYS_PER_ORIGIN == 0) {
+      origin = track.StartPosAndOrientation().first;
+    }
+
+    float theta = math::RandInterval(0.0f, 2.0f * static_cast<float>(M_PI));
+    result.push_back(Ray{origin, Vector2(cosf(theta), sinf(theta))});
+  }
+  return result;
+}
+
+int main(void) {
+  srand(1234);
+
+  vector<uptr<Track>> tracks;
+  vector<vector<Ray>> rays;
+  for (unsigned i = 0; i < NUM_TRACKS; i++) {
+    tracks.push_back(make_unique<Track>(TrackSpec(TRACK_RADIUS, TRACK_MIN_WIDTH, TRACK_MAX_WIDTH,
+                                                  TRACK_NUM_POINTS, TRACK_COLOR_PALETTE,
+                                                  TRACK_MAX_SKEW)));
+    rays.push_back(generateRays(*tracks.back()));
+  }
+
+  unsigned numRays = NUM_TRACKS * RAYS_PER_TRACK;
+  unsigned numHits = 0;
+  unsigned numMismatches = 0;
+
+  Timer timer;
+  timer.Start();
+  for (unsigned i = 0; i < NUM_TRACKS; i++) {
+    for (const auto &ray : rays[i]) {
+      numHits += tracks[i]->IntersectRayBruteForce(ray.start, ray.dir).valid() ? 1 : 0;
+    }
+  }
+  timer.Stop();
+  float bruteForceSecs = timer.GetIntervalElapsedSeconds();
+
+  timer.Start();
+  for (unsigned i = 0; i < NUM_TRACKS; i++) {
+    for (const auto &ray : rays[i]) {
+      numHits -= tracks[i]->IntersectRay(ray.start, ray.dir).valid() ? 1 : 0;
+    }
+  }
+  timer.Stop();
+  float gridSecs = timer.GetIntervalElapsedSeconds();
+
+  vector<vector<Vector2>> packetDirs(NUM_TRACKS);
+  for (unsigned i = 0; i < NUM_TRACKS; i++) {
+    for (const auto &ray : rays[i]) {
+      packetDirs[i].push_back(ray.dir);
+    }
+  }
+  vector<Maybe<TrackRayIntersection>> packetHits(RAYS_PER_TRACK);
+
+  timer.Start();
+  for (unsigned i = 0; i < NUM_TRACKS; i++) {
+    for (unsigned j = 0; j < RAYS_PER_TRACK; j += RAYS_PER_ORIGIN) {
+      tracks[i]->IntersectRays(rays[i][j].start, &packetDirs[i][j], RAYS_PER_ORIGIN,
+                               &packetHits[j]);
+    }
+  }
+  timer.Stop();
+  float packetSecs = timer.GetIntervalElapsedSeconds();
+
+  auto sameHit = [](const Maybe<TrackRayIntersection> &a, const Maybe<TrackRayIntersection> &b) {
+    return a.valid() == b.valid() && (!a.valid() || a.val().pos.distanceTo(b.val().pos) < 0.001f);
+  };
+
+  for (unsigned i = 0; i < NUM_TRACKS; i++) {
+    for (unsigned j = 0; j < RAYS_PER_TRACK; j += RAYS_PER_ORIGIN) {
+      tracks[i]->IntersectRays(rays[i][j].start, &packetDirs[i][j], RAYS_PER_ORIGIN,
+                               &packetHits[j]);
+    }
+
+    for (unsigned j = 0; j < RAYS_PER_TRACK; j++) {
+      const Ray &ray = rays[i][j];
+      auto reference = tracks[i]->IntersectRayBruteForce(ray.start, ray.dir);
+      if (!sameHit(reference, tracks[i]->IntersectRay(ray.start, ray.dir)) ||
+          !sameHit(reference, packetHits[j])) {
+        numMismatches++;
+      }
+    }
+  }
+
+  std::cout << "brute force: " << numRays / bruteForceSecs << " rays/sec" << std::endl;
+  std::cout << "grid: " << numRays / gridSecs << " rays/sec" << std::endl;
+  std::cout << "packet: " << numRays / packetSecs << " rays/sec" << std::endl;
+  std::cout << "mismatches: " << numMismatches << " / " << numRays << std::endl;
+
+  return numHits == 0 && numMismatches == 0 ? 0 : 1;
+}
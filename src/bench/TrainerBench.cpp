@@ -0,0 +1,99 @@
+// Microbenchmark for RNN training. Reports the time per training step of each trainer backend
+// available, over a range of trace lengths, using the batch size the Trainer learns with. The
+// CUDA_HOST backend runs the CudaTrainer's task graphs on the host, so it measures the
+// scheduling overhead of the CudaTrainer without a device.
+
+#include "../common/Common.hpp"
+#include "../common/Timer.hpp"
+#include "../math/Math.hpp"
+#include "../rnn/CudaTrainer.hpp"
+#include "../rnn/RNN.hpp"
+#include <cstdlib>
+#include <iostream>
+
+static constexpr unsigned NUM_STEPS = 200;
+static constexpr unsigned BATCH_SIZE = 32;
+static constexpr unsigned MAX_TRACE_LENGTH = 16;
+static constexpr float LEARN_RATE = 0.001f;
+
+// Same topology as the network built by LearningAgent.
+static rnn::RNNSpec benchSpec(rnn::TrainerBackend backend) {
+  rnn::RNNSpec spec;
+
+  spec.numInputs = 11;
+  spec.numOutputs = 9;
+  spec.hiddenActivation = rnn::LayerActivation::TANH;
+  spec.outputActivation = rnn::LayerActivation::LINEAR;
+  spec.nodeActivationRate = 1.0f;
+  spec.maxBatchSize = BATCH_SIZE;
+  spec.maxTraceLength = MAX_TRACE_LENGTH;
+  spec.trainerBackend = backend;
+
+  spec.connections.emplace_back(0, 1, 0);
+  spec.connections.emplace_back(1, 2, 0);
+  spec.connections.emplace_back(2, 3, 0);
+  spec.connections.emplace_back(2, 2, 1);
+
+  spec.layers.emplace_back(1, 64, false);
+  spec.layers.emplace_back(2, 128, false);
+  spec.layers.emplace_back(3, spec.numOutputs, true);
+
+  return spec;
+}
+
+static EMatrix randomMatrix(unsigned rows, unsigned cols) {
+  EMatrix result(rows, cols);
+  for (int r = 0; r < result.rows(); r++) {
+    for (int c = 0; c < result.cols(); c++) {
+      result(r, c) = math::RandInterval(-1.0f, 1.0f);
+    }
+  }
+  return result;
+}
+
+static vector<rnn::SliceBatch> randomTrace(const rnn::RNNSpec &spec, unsigned traceLength) {
+  vector<rnn::SliceBatch> trace;
+  for (unsigned i = 0; i < traceLength; i++) {
+    EMatrix actions = EMatrix::Zero(BATCH_SIZE, spec.numOutputs);
+    for (unsigned b = 0; b < BATCH_SIZE; b++) {
+      actions(b, rand() % spec.numOutputs) = 1.0f;
+    }
+    trace.emplace_back(randomMatrix(BATCH_SIZE, spec.numInputs), actions,
+                       randomMatrix(BATCH_SIZE, 1));
+  }
+  return trace;
+}
+
+static void runBench(const char *name, rnn::TrainerBackend backend) {
+  rnn::RNN network(benchSpec(backend));
+
+  for (unsigned traceLength : {1, 4, 16}) {
+    vector<rnn::SliceBatch> trace = randomTrace(network.GetSpec(), traceLength);
+
+    // The first step builds the trace length's task graph, so leave it out of the timing.
+    network.Update(trace, LEARN_RATE);
+
+    Timer timer;
+    timer.Start();
+    for (unsigned i = 0; i < NUM_STEPS; i++) {
+      network.Update(trace, LEARN_RATE);
+    }
+    timer.Stop();
+
+    float msPerStep = timer.GetIntervalElapsedSeconds() * 1000.0f / NUM_STEPS;
+    std::cout << name << " (trace length " << traceLength << "): " << msPerStep << " ms/step"
+              << std::endl;
+  }
+}
+
+int main(void) {
+  srand(1234);
+
+  runBench("CPU", rnn::TrainerBackend::CPU);
+  runBench("CUDA_HOST", rnn::TrainerBackend::CUDA_HOST);
+  if (rnn::CudaTrainer::IsAvailable()) {
+    runBench("CUDA", rnn::TrainerBackend::CUDA);
+  }
+
+  return 0;
+}
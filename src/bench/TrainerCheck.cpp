@@ -0,0 +1,161 @@
+// Trains the same network with the same batches on the CudaTrainer's host executor (CUDA_HOST)
+// and on the device (CUDA), and reports how far apart the two end up: the per step TD errors, and
+// every weight, Adam moment and output once training is done. Without a device the reference is
+// the CPU trainer instead, which implements the same algorithm. Exits with 1 if they disagree.
+
+#include "../common/Common.hpp"
+#include "../math/Math.hpp"
+#include "../rnn/CudaTrainer.hpp"
+#include "../rnn/RNN.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+static constexpr unsigned NUM_TRAIN_STEPS = 200;
+static constexpr unsigned MAX_BATCH_SIZE = 32;
+static constexpr unsigned MAX_TRACE_LENGTH = 8;
+static constexpr unsigned TARGET_UPDATE_INTERVAL = 25;
+static constexpr float LEARN_RATE = 0.5f;
+
+static constexpr unsigned NUM_OUTPUT_CHECKS = 50;
+static constexpr float TOLERANCE = 1e-4f;
+
+// Same topology as the network built by LearningAgent.
+static rnn::RNNSpec checkSpec(rnn::TrainerBackend backend) {
+  rnn::RNNSpec spec;
+
+  spec.numInputs = 11;
+  spec.numOutputs = 9;
+  spec.hiddenActivation = rnn::LayerActivation::TANH;
+  spec.outputActivation = rnn::LayerActivation::LINEAR;
+  spec.nodeActivationRate = 1.0f;
+  spec.maxBatchSize = MAX_BATCH_SIZE;
+  spec.maxTraceLength = MAX_TRACE_LENGTH;
+  spec.trainerBackend = backend;
+
+  spec.connections.emplace_back(0, 1, 0);
+  spec.connections.emplace_back(1, 2, 0);
+  spec.connections.emplace_back(2, 3, 0);
+  spec.connections.emplace_back(2, 2, 1);
+
+  spec.layers.emplace_back(1, 64, false);
+  spec.layers.emplace_back(2, 128, false);
+  spec.layers.emplace_back(3, spec.numOutputs, true);
+
+  return spec;
+}
+
+static EMatrix randomMatrix(unsigned rows, unsigned cols, float min, float max) {
+  EMatrix result(rows, cols);
+  for (int r = 0; r < result.rows(); r++) {
+    for (int c = 0; c < result.cols(); c++) {
+      result(r, c) = math::RandInterval(min, max);
+    }
+  }
+  return result;
+}
+
+// Varies the batch size and trace length, so that partly filled batches and each trace length's
+// task graph are covered.
+static vector<rnn::SliceBatch> randomTrace(unsigned step, const rnn::RNNSpec &spec) {
+  unsigned batchSize = step % 2 == 0 ? MAX_BATCH_SIZE : MAX_BATCH_SIZE / 2 + step % 7;
+  unsigned traceLength = 1 + step % MAX_TRACE_LENGTH;
+
+  vector<rnn::SliceBatch> trace;
+  for (unsigned i = 0; i < traceLength; i++) {
+    EMatrix actions = EMatrix::Zero(batchSize, spec.numOutputs);
+    for (unsigned b = 0; b < batchSize; b++) {
+      actions(b, rand() % spec.numOutputs) = 1.0f;
+    }
+
+    trace.emplace_back(randomMatrix(batchSize, spec.numInputs, -1.0f, 1.0f), actions,
+                       randomMatrix(batchSize, 1, -1.0f, 1.0f));
+    trace.back().batchWeights = randomMatrix(batchSize, 1, 0.5f, 1.0f);
+  }
+  return trace;
+}
+
+// Infinite if either has a NaN or infinity, so that a diverged trainer never compares equal.
+static float relativeDifference(const EMatrix &a, const EMatrix &b) {
+  if (!a.allFinite() || !b.allFinite()) {
+    return INFINITY;
+  }
+
+  float scale = std::max(1.0f, std::max(a.cwiseAbs().maxCoeff(), b.cwiseAbs().maxCoeff()));
+  return (a - b).cwiseAbs().maxCoeff() / scale;
+}
+
+int main(void) {
+  srand(1234);
+
+  bool haveDevice = rnn::CudaTrainer::IsAvailable();
+  rnn::TrainerBackend referenceBackend =
+      haveDevice ? rnn::TrainerBackend::CUDA : rnn::TrainerBackend::CPU;
+  std::cout << "comparing CUDA_HOST against " << (haveDevice ? "CUDA" : "CPU (no CUDA device)")
+            << std::endl;
+
+  rnn::RNN host(checkSpec(rnn::TrainerBackend::CUDA_HOST));
+  rnn::RNN reference(checkSpec(referenceBackend));
+
+  vector<rnn::TrainerConnectionState> initialState;
+  host.GetTrainingState(initialState);
+  reference.SetTrainingState(initialState);
+
+  float maxErrorDifference = 0.0f;
+  for (unsigned step = 0; step < NUM_TRAIN_STEPS; step++) {
+    vector<rnn::SliceBatch> trace = randomTrace(step, host.GetSpec());
+    host.Update(trace, LEARN_RATE);
+    reference.Update(trace, LEARN_RATE);
+
+    unsigned batchSize = trace.front().batchInput.rows();
+    maxErrorDifference =
+        std::max(maxErrorDifference, relativeDifference(host.TraceErrors().head(batchSize),
+                                                        reference.TraceErrors().head(batchSize)));
+
+    if (step % TARGET_UPDATE_INTERVAL == TARGET_UPDATE_INTERVAL - 1) {
+      host.RefreshAndGetTarget();
+      reference.RefreshAndGetTarget();
+    }
+  }
+
+  vector<rnn::TrainerConnectionState> hostState, referenceState;
+  host.GetTrainingState(hostState);
+  reference.GetTrainingState(referenceState);
+
+  float maxStateDifference = 0.0f;
+  for (unsigned i = 0; i < hostState.size(); i++) {
+    const rnn::TrainerConnectionState &a = hostState[i];
+    const rnn::TrainerConnectionState &b = referenceState[i];
+    maxStateDifference = std::max(maxStateDifference, relativeDifference(a.weights, b.weights));
+    maxStateDifference =
+        std::max(maxStateDifference, relativeDifference(a.targetWeights, b.targetWeights));
+    maxStateDifference = std::max(maxStateDifference, relativeDifference(a.momentum, b.momentum));
+    maxStateDifference = std::max(maxStateDifference, relativeDifference(a.rms, b.rms));
+  }
+
+  host.RefreshAndGetTarget();
+  reference.RefreshAndGetTarget();
+
+  uptr<rnn::RNNState> hostRNNState = host.NewState();
+  uptr<rnn::RNNState> referenceRNNState = reference.NewState();
+  float maxOutputDifference = 0.0f;
+  for (unsigned i = 0; i < NUM_OUTPUT_CHECKS; i++) {
+    EVector input = randomMatrix(host.GetSpec().numInputs, 1, -1.0f, 1.0f);
+    EVector hostOutput = host.Process(input, *hostRNNState);
+    EVector referenceOutput = reference.Process(input, *referenceRNNState);
+    maxOutputDifference =
+        std::max(maxOutputDifference, relativeDifference(hostOutput, referenceOutput));
+  }
+
+  std::cout << "largest relative difference in TD errors " << maxErrorDifference
+            << ", trainer state " << maxStateDifference << ", outputs " << maxOutputDifference
+            << std::endl;
+
+  if (!(std::max(maxErrorDifference, std::max(maxStateDifference, maxOutputDifference)) <=
+        TOLERANCE)) {
+    std::cout << "FAILED: host and reference trainers disagree" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,57 @@
+#include "BinaryFile.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+void FailFile(const std::string &kind, const std::string &path, const std::string &what) {
+  std::cerr << kind << " " << path << ": " << what << std::endl;
+  exit(1);
+}
+
+void WriteFileAtomically(const std::string &kind, const std::string &path, const void *data,
+                         size_t size) {
+  std::string tmpPath = path + ".tmp";
+  int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    FailFile(kind, tmpPath, strerror(errno));
+  }
+
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  size_t written = 0;
+  while (written < size) {
+    ssize_t n = write(fd, bytes + written, size - written);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      FailFile(kind, tmpPath, strerror(errno));
+    }
+    written += n;
+  }
+
+  if (fsync(fd) != 0) {
+    FailFile(kind, tmpPath, strerror(errno));
+  }
+  close(fd);
+
+  CommitFile(kind, tmpPath, path);
+}
+
+void CommitFile(const std::string &kind, const std::string &tmpPath, const std::string &path) {
+  if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+    FailFile(kind, path, strerror(errno));
+  }
+
+  std::string directory = path.substr(0, path.find_last_of('/') + 1);
+  if (directory.empty()) {
+    directory = ".";
+  }
+  int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0 || fsync(fd) != 0) {
+    FailFile(kind, directory, strerror(errno));
+  }
+  close(fd);
+}
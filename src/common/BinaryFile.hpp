@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Checksum.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Helpers for the binary files that models, checkpoints and caches are saved in. Their headers
+// start with an 8 byte magic and a format version, and have fileSize and checksum fields holding
+// the size of the whole file and the Checksum64 of everything after the header.
+
+// Reports a problem with a file and exits. kind says what the file is, e.g. "model checkpoint".
+void FailFile(const std::string &kind, const std::string &path, const std::string &what);
+
+// Writes size bytes to path + ".tmp", flushes them to disk and renames the file over path, so that
+// path holds either the old or the new contents even after a crash or power loss.
+void WriteFileAtomically(const std::string &kind, const std::string &path, const void *data,
+                         size_t size);
+
+// Renames tmpPath over path and flushes the directory, so that the rename survives a power loss.
+// tmpPath's contents must already be on disk.
+void CommitFile(const std::string &kind, const std::string &tmpPath, const std::string &path);
+
+// Fills in the fileSize and checksum of the header at the start of image.
+template <typename Header> void SealFileImage(void *image, size_t size) {
+  Header header;
+  memcpy(&header, image, sizeof(Header));
+  header.fileSize = size;
+  header.checksum =
+      Checksum64(static_cast<const uint8_t *>(image) + sizeof(Header), size - sizeof(Header));
+  memcpy(image, &header, sizeof(Header));
+}
+
+// True if image is as long as its header says, and matches its checksum.
+template <typename Header> bool FileImageIntact(const void *image, size_t size) {
+  if (size < sizeof(Header)) {
+    return false;
+  }
+
+  Header header;
+  memcpy(&header, image, sizeof(Header));
+  return header.fileSize == size &&
+         header.checksum == Checksum64(static_cast<const uint8_t *>(image) + sizeof(Header),
+                                       size - sizeof(Header));
+}
+
+// Fails unless image is a whole, uncorrupted file with the given magic and format version.
+template <typename Header>
+void CheckFileImage(const std::string &kind, const std::string &path, const void *image,
+                    size_t size, const char (&magic)[8], uint32_t formatVersion) {
+  if (size < sizeof(Header)) {
+    FailFile(kind, path, "too small for a header");
+  }
+
+  Header header;
+  memcpy(&header, image, sizeof(Header));
+  if (memcmp(header.magic, magic, sizeof(magic)) != 0) {
+    FailFile(kind, path, "not a " + kind);
+  }
+  if (header.formatVersion != formatVersion) {
+    FailFile(kind, path, "unsupported format version " + std::to_string(header.formatVersion));
+  }
+  if (header.fileSize != size) {
+    FailFile(kind, path, "truncated");
+  }
+  if (!FileImageIntact<Header>(image, size)) {
+    FailFile(kind, path, "checksum mismatch");
+  }
+}
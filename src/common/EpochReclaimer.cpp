@@ -0,0 +1,87 @@
+#include "EpochReclaimer.hpp"
+#include <cassert>
+
+// A reader registers in the counter for the epoch it saw, then checks the epoch is unchanged so
+// that it can not have registered in a counter that a concurrent tryAdvance had already found
+// empty.
+unsigned long EpochReclaimer::enter(void) {
+  while (true) {
+    unsigned long e = epoch.load();
+    readers[e & 1]++;
+    if (epoch.load() == e) {
+      return e;
+    }
+    readers[e & 1]--;
+  }
+}
+
+void EpochReclaimer::exit(unsigned long readerEpoch) {
+  unsigned prev = readers[readerEpoch & 1]--;
+  assert(prev > 0);
+  (void)prev;
+}
+
+EpochReclaimer::~EpochReclaimer() {
+  assert(readers[0] == 0 && readers[1] == 0);
+
+  Retired *r = retired.exchange(nullptr);
+  while (r != nullptr) {
+    Retired *next = r->next;
+    r->deleter(r->object);
+    delete r;
+    r = next;
+  }
+}
+
+// The object is tagged with the epoch after it was unlinked. A reader that can still hold it must
+// have entered in that epoch or earlier, and the epoch can only move two past that once all such
+// readers have exited.
+void EpochReclaimer::retire(void *object, void (*deleter)(void *)) {
+  Retired *r = new Retired{object, deleter, epoch.load(), nullptr};
+  push(r, r);
+
+  tryAdvance();
+  reclaim();
+}
+
+// Moving from epoch e to e + 1 requires that there be no readers left from epoch e - 1, which share
+// a counter with e + 1.
+void EpochReclaimer::tryAdvance(void) {
+  unsigned long e = epoch.load();
+  if (readers[(e + 1) & 1].load() == 0) {
+    epoch.compare_exchange_strong(e, e + 1);
+  }
+}
+
+void EpochReclaimer::reclaim(void) {
+  Retired *r = retired.exchange(nullptr);
+  unsigned long e = epoch.load();
+
+  Retired *keepFirst = nullptr;
+  Retired *keepLast = nullptr;
+  while (r != nullptr) {
+    Retired *next = r->next;
+    if (r->epoch + 2 <= e) {
+      r->deleter(r->object);
+      delete r;
+    } else {
+      r->next = keepFirst;
+      keepFirst = r;
+      if (keepLast == nullptr) {
+        keepLast = r;
+      }
+    }
+    r = next;
+  }
+
+  if (keepFirst != nullptr) {
+    push(keepFirst, keepLast);
+  }
+}
+
+void EpochReclaimer::push(Retired *first, Retired *last) {
+  Retired *head = retired.load();
+  do {
+    last->next = head;
+  } while (!retired.compare_exchange_weak(head, first));
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+
+// Epoch based reclamation for lock-free data structures. An object that a writer has unlinked may
+// still be in use by a reader that loaded a pointer to it just before. So rather than deleting it,
+// the writer retires it, and it is deleted once every reader that could have seen it has finished.
+// Readers bracket their accesses with a Guard. Neither side ever blocks the other.
+class EpochReclaimer {
+public:
+  EpochReclaimer() = default;
+
+  // Deletes everything still retired, so no readers may be active.
+  ~EpochReclaimer();
+
+  EpochReclaimer(const EpochReclaimer &) = delete;
+  EpochReclaimer &operator=(const EpochReclaimer &) = delete;
+
+  class Guard {
+  public:
+    Guard(EpochReclaimer &reclaimer) : reclaimer(reclaimer), epoch(reclaimer.enter()) {}
+    ~Guard() { reclaimer.exit(epoch); }
+
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+
+  private:
+    EpochReclaimer &reclaimer;
+    unsigned long epoch;
+  };
+
+  // obj must already be unreachable for readers that start after this call.
+  template <typename T> void Retire(const T *obj) {
+    retire(const_cast<T *>(obj), [](void *p) { delete static_cast<T *>(p); });
+  }
+
+private:
+  struct Retired {
+    void *object;
+    void (*deleter)(void *);
+    unsigned long epoch;
+    Retired *next;
+  };
+
+  std::atomic<unsigned long> epoch{0};
+
+  // Number of active readers that entered in an even and an odd epoch.
+  std::atomic<unsigned> readers[2] = {{0}, {0}};
+
+  // Lock-free stack of retired objects.
+  std::atomic<Retired *> retired{nullptr};
+
+  unsigned long enter(void);
+  void exit(unsigned long readerEpoch);
+
+  void retire(void *object, void (*deleter)(void *));
+  void tryAdvance(void);
+  void reclaim(void);
+  void push(Retired *first, Retired *last);
+};
@@ -0,0 +1,79 @@
+#include "WorkerPool.hpp"
+#include <cassert>
+
+WorkerPool::WorkerPool(unsigned numThreads)
+    : generation(0), numBusy(0), exiting(false), curTask(nullptr), curNumTasks(0), nextTask(0) {
+  assert(numThreads > 0);
+  for (unsigned i = 1; i < numThreads; i++) {
+    workers.emplace_back([this]() { workerLoop(); });
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(m);
+    exiting = true;
+  }
+  startCv.notify_all();
+
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+// Every worker takes part in every run, even if there are fewer tasks than threads, so that Run
+// can wait for them all to let go of the task before it returns.
+void WorkerPool::Run(unsigned numTasks, const std::function<void(unsigned)> &task) {
+  if (workers.empty() || numTasks <= 1) {
+    for (unsigned i = 0; i < numTasks; i++) {
+      task(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m);
+    curTask = &task;
+    curNumTasks = numTasks;
+    nextTask = 0;
+    numBusy = workers.size();
+    generation++;
+  }
+  startCv.notify_all();
+
+  runTasks();
+
+  std::unique_lock<std::mutex> lock(m);
+  doneCv.wait(lock, [this]() { return numBusy == 0; });
+  curTask = nullptr;
+}
+
+void WorkerPool::workerLoop(void) {
+  unsigned long seenGeneration = 0;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m);
+      startCv.wait(lock, [this, seenGeneration]() {
+        return generation != seenGeneration || exiting;
+      });
+      if (exiting) {
+        return;
+      }
+      seenGeneration = generation;
+    }
+
+    runTasks();
+
+    std::lock_guard<std::mutex> lock(m);
+    if (--numBusy == 0) {
+      doneCv.notify_one();
+    }
+  }
+}
+
+void WorkerPool::runTasks(void) {
+  for (unsigned i = nextTask++; i < curNumTasks; i = nextTask++) {
+    (*curTask)(i);
+  }
+}
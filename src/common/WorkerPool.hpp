@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that run a function over a range of task indices, for splitting one
+// step of work into pieces. The threads are started once and sleep between runs, so a run costs a
+// wake up rather than creating threads. The thread calling Run works on the tasks as well.
+class WorkerPool {
+public:
+  // numThreads includes the calling thread, so a pool of 1 runs everything on the caller.
+  WorkerPool(unsigned numThreads);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  unsigned NumThreads(void) const { return workers.size() + 1; }
+
+  // Calls task(i) for every i in [0, numTasks), spread over the threads, and returns once all of
+  // the calls have returned. Must not be called concurrently with another Run.
+  void Run(unsigned numTasks, const std::function<void(unsigned)> &task);
+
+private:
+  std::vector<std::thread> workers;
+
+  std::mutex m;
+  std::condition_variable startCv;
+  std::condition_variable doneCv;
+  unsigned long generation; // of the current run, counts up from 0.
+  unsigned numBusy;         // workers yet to finish with the current run.
+  bool exiting;
+
+  const std::function<void(unsigned)> *curTask;
+  unsigned curNumTasks;
+  std::atomic<unsigned> nextTask;
+
+  void workerLoop(void);
+  void runTasks(void);
+};
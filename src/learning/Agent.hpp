@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include "../common/Common.hpp"
 #include "../simulation/Action.hpp"
 #include "../simulation/State.hpp"
 
@@ -10,8 +11,20 @@ namespace learning {
 
 class Agent {
 public:
+  // Recurrent memory for a batch of episodes, created by and only usable with one agent.
+  class BatchMemory {
+  public:
+    virtual ~BatchMemory() = default;
+  };
+
   virtual ~Agent() = default;
   virtual Action SelectAction(const State *state) = 0;
   virtual void ResetMemory(void) = 0;
+
+  // Lockstep variant for running several independent episodes at once, each position in the batch
+  // has its own memory. NewBatchMemory starts batchSize fresh episodes. The memory belongs to the
+  // caller, so several threads can each run their own batch at the same time.
+  virtual uptr<BatchMemory> NewBatchMemory(unsigned batchSize) = 0;
+  virtual vector<Action> SelectBatchActions(const vector<State> &states, BatchMemory &memory) = 0;
 };
 }
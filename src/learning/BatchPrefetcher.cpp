@@ -0,0 +1,63 @@
+#include "BatchPrefetcher.hpp"
+#include "../rnn/NetworkTrainer.hpp"
+#include "LearningAgent.hpp"
+#include <cassert>
+
+using namespace learning;
+
+BatchPrefetcher::BatchPrefetcher(LearningAgent *agent, ExperienceMemory *memory,
+                                 unsigned batchSize, unsigned maxTraceLength)
+    : memory(memory), batchSize(batchSize), maxTraceLength(maxTraceLength), nextAcquire(0),
+      freeBuffers(rnn::NetworkTrainer::NUM_STAGING_BUFFERS), readyBuffers(0), stopping(false) {
+  assert(agent != nullptr && memory != nullptr);
+  assert(batchSize > 0 && maxTraceLength > 0);
+
+  for (unsigned i = 0; i < rnn::NetworkTrainer::NUM_STAGING_BUFFERS; i++) {
+    buffers.push_back(&agent->TrainingStaging(i));
+    sampledTraces.emplace_back();
+    sampledTraces.back().reserve(batchSize);
+    traceLengths.push_back(0);
+  }
+
+  assembler = std::thread([this]() { assemble(); });
+}
+
+BatchPrefetcher::~BatchPrefetcher() {
+  stopping = true;
+  freeBuffers.notify(); // in case the assembler is waiting for a buffer.
+  assembler.join();
+}
+
+BatchPrefetcher::Batch BatchPrefetcher::Acquire(void) {
+  readyBuffers.wait();
+
+  Batch result;
+  result.buffer = nextAcquire;
+  result.traceLength = traceLengths[nextAcquire];
+
+  nextAcquire = (nextAcquire + 1) % buffers.size();
+  return result;
+}
+
+void BatchPrefetcher::Release(const Batch &batch, const EVector &traceErrors) {
+  if (batch.traceLength > 0) {
+    memory->UpdatePriorities(sampledTraces[batch.buffer], traceErrors);
+  }
+  freeBuffers.notify();
+}
+
+void BatchPrefetcher::assemble(void) {
+  for (unsigned buffer = 0;; buffer = (buffer + 1) % buffers.size()) {
+    freeBuffers.wait();
+    if (stopping) {
+      break;
+    }
+
+    traceLengths[buffer] = 0;
+    if (memory->NumMemories() > 0) {
+      traceLengths[buffer] = memory->SampleInto(batchSize, maxTraceLength, *buffers[buffer],
+                                                &sampledTraces[buffer]);
+    }
+    readyBuffers.notify();
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "../common/Common.hpp"
+#include "../common/Semaphore.hpp"
+#include "../rnn/SliceBatch.hpp"
+#include "ExperienceMemory.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace learning {
+
+class LearningAgent;
+
+// Samples training batches out of an ExperienceMemory on a dedicated thread, straight into the
+// agent's staging buffers, so that the next batch is assembled while the current one trains. The
+// staging buffers form a bounded queue: the assembly thread fills free buffers in turn and blocks
+// while all of them are ready or being trained on.
+//
+// A batch's TD errors are fed back to the memory's priorities when it is released, so with more
+// than one buffer a batch is sampled before the priorities from the one ahead of it are updated.
+class BatchPrefetcher {
+public:
+  struct Batch {
+    unsigned buffer;      // index of the agent's staging buffer holding the batch.
+    unsigned traceLength; // number of slices written, 0 if the memory was empty.
+  };
+
+  BatchPrefetcher(LearningAgent *agent, ExperienceMemory *memory, unsigned batchSize,
+                  unsigned maxTraceLength);
+  ~BatchPrefetcher();
+
+  BatchPrefetcher(const BatchPrefetcher &other) = delete;
+  BatchPrefetcher &operator=(const BatchPrefetcher &other) = delete;
+
+  unsigned BatchSize(void) const { return batchSize; }
+
+  // Blocks until the next batch is ready. Batches are handed out in order, one at a time, and each
+  // must be released before the next is acquired.
+  Batch Acquire(void);
+
+  // Sets the priorities of the batch's traces from their TD errors, then hands its buffer back
+  // to be refilled.
+  void Release(const Batch &batch, const EVector &traceErrors);
+
+private:
+  ExperienceMemory *memory;
+  unsigned batchSize;
+  unsigned maxTraceLength;
+
+  vector<vector<rnn::SliceBatch> *> buffers;
+  vector<vector<ExperienceMemory::SampledTrace>> sampledTraces; // per buffer.
+  vector<unsigned> traceLengths;                                // per buffer.
+  unsigned nextAcquire;
+
+  Semaphore freeBuffers;
+  Semaphore readyBuffers;
+  atomic<bool> stopping;
+  std::thread assembler;
+
+  void assemble(void);
+};
+}
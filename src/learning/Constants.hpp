@@ -5,6 +5,14 @@ namespace learning {
 
 static constexpr unsigned EXPERIENCE_BATCH_SIZE = 32;
 static constexpr unsigned EXPERIENCE_MAX_TRACE_LENGTH = 16;
+static constexpr unsigned GENERATED_TRACE_LENGTH = 50; // moments per generated experience.
 static constexpr unsigned TARGET_FUNCTION_UPDATE_RATE = 5000;
 static constexpr float REWARD_DELAY_DISCOUNT = 0.9f;
+
+// Prioritized replay: traces are sampled in proportion to (|TD error| + epsilon)^alpha, and their
+// errors weighted by (N * P(trace))^-beta, normalised to a batch maximum of 1.
+static constexpr bool PRIORITIZED_REPLAY = true;
+static constexpr float REPLAY_PRIORITY_ALPHA = 0.6f;
+static constexpr float REPLAY_PRIORITY_BETA = 0.4f;
+static constexpr float REPLAY_PRIORITY_EPSILON = 0.01f;
 }
@@ -2,6 +2,7 @@
 
 #include "../common/Common.hpp"
 #include "../math/Math.hpp"
+#include "../rnn/SliceBatch.hpp"
 #include "../simulation/State.hpp"
 #include "../simulation/Action.hpp"
 #include <cstdlib>
@@ -19,6 +20,16 @@ struct ExperienceMoment {
   ExperienceMoment() = default;
   ExperienceMoment(const EVector &observedState, const Action &actionTaken, float reward)
       : observedState(observedState), actionTaken(actionTaken), reward(reward) {}
+
+  // Writes this moment into the given row of a training slice, with a one hot action. The row is
+  // weighted 1, as the slice may hold importance sampling weights from a prioritized batch.
+  void WriteTo(rnn::SliceBatch &slice, unsigned row) const {
+    slice.batchInput.row(row) = observedState.transpose();
+    slice.batchActions.row(row).setZero();
+    slice.batchActions(row, Action::ACTION_INDEX(actionTaken)) = 1.0f;
+    slice.batchRewards(row, 0) = reward;
+    slice.batchWeights(row, 0) = 1.0f;
+  }
 };
 
 struct Experience {
@@ -12,7 +12,6 @@ using namespace learning;
 using namespace simulation;
 
 static constexpr unsigned NUM_TRACKS = 100;
-static constexpr unsigned MAX_TRACE_LENGTH = 50;
 
 struct ExperienceGenerator::ExperienceGeneratorImpl {
   vector<sptr<Track>> tracks;
@@ -25,23 +24,23 @@ struct ExperienceGenerator::ExperienceGeneratorImpl {
     }
   }
 
-  Experience GenerateExperience(LearningAgent *agent) {
+  Experience GenerateExperience(LearningAgent *agent, rnn::RNNState &memory) {
     assert(agent != nullptr);
-    agent->ResetMemory();
+    memory.Clear();
 
     Experience result;
-    result.moments.reserve(MAX_TRACE_LENGTH);
+    result.moments.reserve(GENERATED_TRACE_LENGTH);
 
     const auto &track = tracks[rand() % tracks.size()];
     uptr<World> world = make_unique<World>(
         track, CarDef(CAR_SIZE, CAR_EYE_SEPARATION, CAR_TURN_RATE, CAR_ACCEL_RATE));
 
-    for (unsigned i = 0; i < MAX_TRACE_LENGTH; i++) {
+    for (unsigned i = 0; i < GENERATED_TRACE_LENGTH; i++) {
       pair<vector<ColorRGB>, vector<ColorRGB>> eyeView =
           world->GetCar()->EyeView(world->GetTrack());
       // State observedState(eyeView.first, eyeView.second);
 
-      Vector2 nextWaypoint = world->GetTrack()->NextWaypoint(world->GetCar()->GetPos());
+      Vector2 nextWaypoint = world->NextWaypoint();
       Vector2 toNextWaypoint = (nextWaypoint - world->GetCar()->GetPos()).normalised();
 
       State observedState(eyeView.first, eyeView.second,
@@ -53,7 +52,7 @@ struct ExperienceGenerator::ExperienceGeneratorImpl {
       // cout << observedState << endl;
 
       // }
-      Action performedAction = agent->SelectLearningAction(&observedState);
+      Action performedAction = agent->SelectLearningAction(&observedState, memory);
       // cout << performedAction << endl;
       // getchar();
       world->GetCar()->SetAcceleration(performedAction.GetAcceleration());
@@ -82,6 +81,7 @@ ExperienceGenerator::ExperienceGenerator() : impl(new ExperienceGeneratorImpl())
 
 ExperienceGenerator::~ExperienceGenerator() = default;
 
-Experience ExperienceGenerator::GenerateExperience(LearningAgent *agent) {
-  return impl->GenerateExperience(agent);
+Experience ExperienceGenerator::GenerateExperience(LearningAgent *agent,
+                                                   rnn::RNNState &memory) {
+  return impl->GenerateExperience(agent, memory);
 }
@@ -16,7 +16,9 @@ public:
   ExperienceGenerator(ExperienceGenerator &&other) = delete;
   ExperienceGenerator &operator=(const ExperienceGenerator &other) = delete;
 
-  Experience GenerateExperience(LearningAgent *agent);
+  // Plays out an episode, clearing and then using the given recurrent memory. Safe to call
+  // concurrently from several threads, provided each uses its own memory.
+  Experience GenerateExperience(LearningAgent *agent, rnn::RNNState &memory);
 
 private:
   struct ExperienceGeneratorImpl;
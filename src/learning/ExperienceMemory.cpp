@@ -1,83 +1,297 @@
-
 #include "ExperienceMemory.hpp"
 #include "../common/Common.hpp"
+#include "Constants.hpp"
 #include <cassert>
+#include <cmath>
+#include <thread>
 
 using namespace learning;
 
-// How much memory to purge (as a ratio of max size) when the occupancy is saturated.
-static constexpr float PURGE_RATIO = 0.2f;
-
-ExperienceMemory::ExperienceMemory(unsigned maxSize)
-    : pastExperiences(maxSize), head(0), tail(0), occupancy(0) {}
+ExperienceMemory::ExperienceMemory(unsigned maxSize, unsigned maxTraceLength,
+                                   unsigned observationDim, bool prioritized)
+    : ExperienceMemory(make_unique<ReplayStore>(maxSize, maxTraceLength, observationDim),
+                       prioritized) {}
 
-void ExperienceMemory::AddExperience(const Experience &moment) {
-  // obtain a write lock
-  boost::unique_lock<boost::shared_mutex> lock(smutex);
+ExperienceMemory::ExperienceMemory(uptr<ReplayStore> store, bool prioritized)
+    : store(std::move(store)), traceSlots(new TraceSlot[this->store->NumTraces()]),
+      maxSize(this->store->NumTraces()), nextSlot(0), numStored(0), prioritized(prioritized),
+      priorities(maxSize), maxPriority(1.0) {
+  assert(maxSize > 0);
+  resume();
+}
 
-  pastExperiences[tail] = moment;
-  tail = (tail + 1) % pastExperiences.size();
-  occupancy++;
+// Resumes the ring after the most recent experience in the store.
+void ExperienceMemory::resume(void) {
+  unsigned long numPrevious = 0;
+  for (unsigned i = 0; i < maxSize; i++) {
+    bool stored = store->TraceLength(i) > 0;
+    traceSlots[i].version = stored ? 2 : 0;
+    traceSlots[i].readers = 0;
 
-  if (occupancy == pastExperiences.size()) {
-    purgeOldMemories();
+    if (stored) {
+      numPrevious = std::max(numPrevious, store->Sequence(i) + 1);
+    }
+    if (prioritized) {
+      priorities.Set(i, stored ? maxPriority : 0.0);
+    }
   }
+
+  nextSlot = numPrevious;
+  numStored = numPrevious;
 }
 
-void ExperienceMemory::AddExperiences(const vector<Experience> &moments) {
-  // obtain a write lock
-  boost::unique_lock<boost::shared_mutex> lock(smutex);
+void ExperienceMemory::AddExperience(const Experience &moment) {
+  assert(!store->IsReadOnly());
 
-  for (unsigned i = 0; i < moments.size(); i++) {
-    pastExperiences[tail] = moments[i];
-    tail = (tail + 1) % pastExperiences.size();
-    occupancy++;
+  unsigned long sequence = nextSlot++;
+  unsigned trace = sequence % maxSize;
+  TraceSlot &slot = traceSlots[trace];
 
-    if (occupancy == pastExperiences.size()) {
-      purgeOldMemories();
+  // Claim the slot by making its version odd. It can only already be claimed if the ring has
+  // wrapped all the way round during another writer's Store.
+  unsigned long version = slot.version.load();
+  while ((version & 1) || !slot.version.compare_exchange_weak(version, version + 1)) {
+    if (version & 1) {
+      std::this_thread::yield();
+      version = slot.version.load();
     }
   }
+
+  if (prioritized) {
+    std::lock_guard<std::mutex> lock(priorityMutex);
+    priorities.Set(trace, 0.0);
+  }
+
+  // New samplers now skip this slot, wait for the ones that got in before the claim.
+  while (slot.readers.load() != 0) {
+    std::this_thread::yield();
+  }
+
+  store->Store(trace, sequence, moment);
+  slot.version = version + 2;
+
+  if (prioritized) {
+    std::lock_guard<std::mutex> lock(priorityMutex);
+    priorities.Set(trace, maxPriority);
+  }
+  numStored++;
+}
+
+void ExperienceMemory::AddExperiences(const vector<Experience> &moments) {
+  for (const auto &moment : moments) {
+    AddExperience(moment);
+  }
 }
 
 vector<Experience> ExperienceMemory::Sample(unsigned numSamples, unsigned experienceLength) const {
-  // obtain a read lock
-  boost::shared_lock<boost::shared_mutex> lock(smutex);
+  unsigned occupancy = NumMemories();
+  assert(occupancy > 0);
 
   vector<Experience> result;
   result.reserve(numSamples);
 
   for (unsigned i = 0; i < numSamples; i++) {
-    result.push_back(trimmed(pastExperiences[wrappedIndex(rand())], experienceLength));
+    double probability;
+    unsigned trace = pinSampledTrace(i, numSamples, occupancy, probability);
+
+    unsigned length = std::min(store->TraceLength(trace), experienceLength);
+    unsigned start = windowStart(store->TraceLength(trace), length);
+
+    result.emplace_back();
+    result.back().moments.reserve(length);
+    for (unsigned j = 0; j < length; j++) {
+      result.back().moments.emplace_back(store->Observation(trace, start + j),
+                                         Action::ACTION(store->ActionIndex(trace, start + j)),
+                                         store->Reward(trace, start + j));
+    }
+
+    unpin(trace);
   }
 
   return result;
 }
 
+unsigned ExperienceMemory::SampleInto(unsigned numSamples, unsigned experienceLength,
+                                      vector<rnn::SliceBatch> &outTrace,
+                                      vector<SampledTrace> *outSampled) const {
+  unsigned occupancy = NumMemories();
+  assert(occupancy > 0);
+
+  if (outSampled != nullptr) {
+    outSampled->clear();
+  }
+
+  unsigned traceLength = 0;
+  float maxWeight = 0.0f;
+  for (unsigned i = 0; i < numSamples; i++) {
+    double probability;
+    unsigned trace = pinSampledTrace(i, numSamples, occupancy, probability);
+
+    float weight = 1.0f;
+    if (prioritized) {
+      weight = powf(static_cast<float>(occupancy * probability), -REPLAY_PRIORITY_BETA);
+      maxWeight = std::max(maxWeight, weight);
+    }
+
+    if (outSampled != nullptr) {
+      outSampled->push_back(SampledTrace{trace, traceSlots[trace].version.load()});
+    }
+
+    unsigned length = std::min(store->TraceLength(trace), experienceLength);
+    if (i == 0) {
+      traceLength = length;
+      assert(traceLength <= outTrace.size());
+    }
+    assert(length == traceLength);
+
+    unsigned start = windowStart(store->TraceLength(trace), length);
+    for (unsigned j = 0; j < length; j++) {
+      assert(i < outTrace[j].batchInput.rows());
+      store->WriteTo(trace, start + j, outTrace[j], i);
+      outTrace[j].batchWeights(i, 0) = weight;
+    }
+
+    unpin(trace);
+  }
+
+  if (prioritized) {
+    for (unsigned j = 0; j < traceLength; j++) {
+      outTrace[j].batchWeights.topRows(numSamples) *= 1.0f / maxWeight;
+    }
+  }
+
+  return traceLength;
+}
+
+void ExperienceMemory::UpdatePriorities(const vector<SampledTrace> &sampled,
+                                        const EVector &errors) {
+  if (!prioritized) {
+    return;
+  }
+  assert(errors.rows() >= static_cast<int>(sampled.size()));
+
+  std::lock_guard<std::mutex> lock(priorityMutex);
+  for (unsigned i = 0; i < sampled.size(); i++) {
+    // A writer that claims the slot after this check zeroes its priority under this lock, so
+    // after this update.
+    if (traceSlots[sampled[i].trace].version.load() != sampled[i].version) {
+      continue;
+    }
+
+    double priority = pow(fabs(errors(i)) + REPLAY_PRIORITY_EPSILON, REPLAY_PRIORITY_ALPHA);
+    priorities.Set(sampled[i].trace, priority);
+    maxPriority = std::max(maxPriority, priority);
+  }
+}
+
+void ExperienceMemory::Snapshot(ReplayStore &outStore, vector<double> &outPriorities,
+                                double &outMaxPriority) const {
+  for (unsigned i = 0; i < maxSize; i++) {
+    if (tryPin(i)) {
+      outStore.CopyTrace(i, *store);
+      unpin(i);
+    } else {
+      outStore.Erase(i);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(priorityMutex);
+  outPriorities.clear();
+  if (prioritized) {
+    for (unsigned i = 0; i < maxSize; i++) {
+      outPriorities.push_back(priorities.Get(i));
+    }
+  }
+  outMaxPriority = maxPriority;
+}
+
+void ExperienceMemory::Restore(const ReplayStore &snapshot, const vector<double> &tracePriorities,
+                               double newMaxPriority) {
+  assert(!store->IsReadOnly());
+
+  for (unsigned i = 0; i < maxSize; i++) {
+    store->CopyTrace(i, snapshot);
+  }
+
+  maxPriority = newMaxPriority;
+  resume();
+
+  if (prioritized && tracePriorities.size() == maxSize) {
+    for (unsigned i = 0; i < maxSize; i++) {
+      if (store->TraceLength(i) > 0) {
+        priorities.Set(i, tracePriorities[i]);
+      }
+    }
+  }
+}
+
 unsigned ExperienceMemory::NumMemories(void) const {
-  boost::shared_lock<boost::shared_mutex> lock(smutex);
-  return occupancy;
+  return static_cast<unsigned>(std::min<unsigned long>(numStored.load(), maxSize));
 }
 
-unsigned ExperienceMemory::wrappedIndex(unsigned i) const {
-  assert(occupancy > 0 && pastExperiences.size() > 0);
-  return ((i % occupancy) + head) % pastExperiences.size();
+// Registering as a reader before checking the version pairs with AddExperience claiming the slot
+// before checking the readers: one of the two always sees the other.
+unsigned ExperienceMemory::pinRandomTrace(unsigned occupancy) const {
+  while (true) {
+    unsigned trace = rand() % occupancy;
+    if (tryPin(trace)) {
+      return trace;
+    }
+  }
 }
 
-void ExperienceMemory::purgeOldMemories(void) {
-  unsigned purgeAmount = PURGE_RATIO * occupancy;
-  occupancy -= purgeAmount;
-  head = (head + purgeAmount) % pastExperiences.size();
+bool ExperienceMemory::tryPin(unsigned trace) const {
+  TraceSlot &slot = traceSlots[trace];
+
+  slot.readers++;
+  unsigned long version = slot.version.load();
+  if (version != 0 && (version & 1) == 0) {
+    return true;
+  }
+  slot.readers--;
+  return false;
 }
 
-Experience ExperienceMemory::trimmed(const Experience &experience, unsigned targetLength) const {
-  if (experience.moments.size() <= targetLength) {
-    return experience;
+void ExperienceMemory::unpin(unsigned trace) const { traceSlots[trace].readers--; }
+
+unsigned ExperienceMemory::pinSampledTrace(unsigned sample, unsigned numSamples,
+                                           unsigned occupancy, double &outProbability) const {
+  if (!prioritized) {
+    outProbability = 1.0 / occupancy;
+    return pinRandomTrace(occupancy);
+  }
+
+  // If the picked trace is being overwritten, retry from the whole span.
+  double lo = static_cast<double>(sample) / numSamples;
+  double hi = static_cast<double>(sample + 1) / numSamples;
+  while (true) {
+    unsigned trace;
+    {
+      std::lock_guard<std::mutex> lock(priorityMutex);
+      double total = priorities.Total();
+      if (total <= 0.0) {
+        break;
+      }
+
+      trace = priorities.Find((lo + (hi - lo) * math::UnitRand()) * total);
+      outProbability = priorities.Get(trace) / total;
+    }
+
+    if (outProbability > 0.0 && tryPin(trace)) {
+      return trace;
+    }
+    lo = 0.0;
+    hi = 1.0;
   }
 
-  Experience result;
-  unsigned startIndex = rand() % (experience.moments.size() - targetLength);
-  for (unsigned i = 0; i < targetLength; i++) {
-    result.moments.push_back(experience.moments[startIndex + i]);
+  // Every stored trace is being overwritten.
+  outProbability = 1.0 / occupancy;
+  return pinRandomTrace(occupancy);
+}
+
+unsigned ExperienceMemory::windowStart(unsigned traceLength, unsigned targetLength) const {
+  if (traceLength <= targetLength) {
+    return 0;
   }
-  return result;
+  return rand() % (traceLength - targetLength);
 }
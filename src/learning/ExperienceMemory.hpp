@@ -1,26 +1,63 @@
 #pragma once
 
 #include "Experience.hpp"
+#include "ReplayStore.hpp"
+#include "SumTree.hpp"
 #include "../math/Math.hpp"
+#include "../rnn/SliceBatch.hpp"
 #include "../simulation/State.hpp"
+#include <atomic>
 #include <cstdlib>
-#include <boost/thread/shared_mutex.hpp>
+#include <mutex>
 
 using namespace simulation;
 
 namespace learning {
 
+// A ring of the most recent experiences, kept in a columnar ReplayStore, which any number of
+// threads may add to and sample from concurrently. Each trace slot has a version, which is odd
+// while a writer is overwriting the slot, and a count of the samplers reading it. Samplers skip a
+// slot that is being written and never wait; a writer waits only for the samplers already
+// copying out of the slot it is about to overwrite.
+//
+// In prioritized mode traces are instead sampled in proportion to a priority derived from their
+// last TD error, from a SumTree guarded by a mutex that is only held for O(log n) tree operations.
 class ExperienceMemory {
-  mutable boost::shared_mutex smutex;
+public:
+  // A trace handed out by SampleInto, so that its TD error can be fed back. The version identifies
+  // the experience, in case the slot has been overwritten since.
+  struct SampledTrace {
+    unsigned trace;
+    unsigned long version;
+  };
+
+private:
+  struct TraceSlot {
+    atomic<unsigned long> version; // 0 until first written.
+    atomic<unsigned> readers;
+  };
+
+  uptr<ReplayStore> store;
+  uptr<TraceSlot[]> traceSlots;
+  unsigned maxSize;
 
-  vector<Experience> pastExperiences;
-  unsigned head;
-  unsigned tail;
-  unsigned occupancy;
+  atomic<unsigned long> nextSlot;  // total number of experiences that have started to be added.
+  atomic<unsigned long> numStored; // total number of experiences that have finished being added.
+
+  bool prioritized;
+  mutable std::mutex priorityMutex;
+  SumTree priorities;
+  double maxPriority; // given to new experiences, so that they are soon sampled.
 
 public:
-  ExperienceMemory(unsigned maxSize);
-  ~ExperienceMemory() = default;
+  // Holds the maxSize most recent experiences, each of at most maxTraceLength moments with
+  // observations of observationDim.
+  ExperienceMemory(unsigned maxSize, unsigned maxTraceLength, unsigned observationDim,
+                   bool prioritized = false);
+
+  // Uses the given store, e.g. a memory mapped one, with one slot per experience. Any experiences
+  // already in the store are kept, in their original order. A read-only store can only be sampled.
+  ExperienceMemory(uptr<ReplayStore> store, bool prioritized = false);
 
   ExperienceMemory(const ExperienceMemory &other) = delete;
   ExperienceMemory(ExperienceMemory &&other) = delete;
@@ -30,12 +67,51 @@ public:
   void AddExperiences(const vector<Experience> &moments);
 
   vector<Experience> Sample(unsigned numSamples, unsigned experienceLength) const;
+
+  // Samples like Sample, but writes the moments straight into rows [0, numSamples) of the leading
+  // slices of outTrace (e.g. a trainer's staging slices), without copying any Experience, along
+  // with each row's importance sampling weight (1 unless prioritized). Returns the number of
+  // slices written. If outSampled is given it is filled with the trace of each row.
+  unsigned SampleInto(unsigned numSamples, unsigned experienceLength,
+                      vector<rnn::SliceBatch> &outTrace,
+                      vector<SampledTrace> *outSampled = nullptr) const;
+
+  // Sets the priority of each sampled trace from its TD error, errors(i) being for sampled[i].
+  // Does nothing unless prioritized.
+  void UpdatePriorities(const vector<SampledTrace> &sampled, const EVector &errors);
+
   unsigned NumMemories(void) const;
 
+  const ReplayStore &Store(void) const { return *store; }
+
+  // Copies the stored experiences into outStore, which must have the same shape and encoding as
+  // this memory's store, along with each slot's priority (none unless prioritized) and the
+  // priority given to new experiences. May run concurrently with adding and sampling, and leaves
+  // out any experience that is part way through being added.
+  void Snapshot(ReplayStore &outStore, vector<double> &outPriorities,
+                double &outMaxPriority) const;
+
+  // Replaces the stored experiences and priorities with a snapshot. Must not run concurrently
+  // with anything else.
+  void Restore(const ReplayStore &snapshot, const vector<double> &tracePriorities,
+               double newMaxPriority);
+
 private:
-  unsigned wrappedIndex(unsigned i) const;
-  void purgeOldMemories(void);
+  // Sets up the slots and the ring from the experiences in the store.
+  void resume(void);
+
+  // Picks a random readable trace below the occupancy and registers as its reader. Must be paired
+  // with a call to unpin.
+  unsigned pinRandomTrace(unsigned occupancy) const;
+  bool tryPin(unsigned trace) const;
+  void unpin(unsigned trace) const;
+
+  // Picks and pins the trace for the given sample out of numSamples, along with the probability of
+  // picking it. Prioritized sampling is stratified, each sample drawing from its own equal span of
+  // the cumulative priorities.
+  unsigned pinSampledTrace(unsigned sample, unsigned numSamples, unsigned occupancy,
+                           double &outProbability) const;
 
-  Experience trimmed(const Experience &experience, unsigned targetLength) const;
+  unsigned windowStart(unsigned traceLength, unsigned targetLength) const;
 };
 }
@@ -1,28 +1,46 @@
 
 #include "LearningAgent.hpp"
 #include "../common/Common.hpp"
+#include "../rnn/FixedRNN.hpp"
 #include "../rnn/RNN.hpp"
 #include "../rnn/RNNSpec.hpp"
+#include "BatchPrefetcher.hpp"
 #include "Constants.hpp"
 
-#include <boost/thread/shared_mutex.hpp>
+#include <atomic>
 #include <cassert>
 #include <random>
 
 using namespace learning;
 
-struct LearningAgent::LearningAgentImpl {
-  mutable boost::shared_mutex rwMutex;
+// The topology built by createNetwork for the car's observations. Single step inference runs on
+// this compile time specialization when the input size matches.
+using DeployedRNN = rnn::FixedRNN<11, 64, 128, 9>;
 
-  float pRandom;
-  float temperature;
+struct LearningAgent::LearningAgentImpl {
+  // Inference takes no lock: Finalise publishes the refreshed weights as a new snapshot which
+  // inference picks up on its next step (see rnn::RNN). The recurrent memory used by inference is
+  // never shared between threads.
+  atomic<float> pRandom;
+  atomic<float> temperature;
 
   uptr<rnn::RNN> network;
   unsigned itersSinceTargetUpdated = 0;
 
+  // Memory for the Agent interface, which is used from one thread at a time.
+  uptr<rnn::RNNState> agentMemory;
+
+  struct NetworkBatchMemory : public BatchMemory {
+    uptr<rnn::RNNBatchState> states;
+  };
+
+  // The traces sampled for the current learn step.
+  vector<ExperienceMemory::SampledTrace> sampledTraces;
+
   LearningAgentImpl(unsigned inputDim) : pRandom(0.1f), temperature(0.1f) {
     createNetwork(inputDim);
     itersSinceTargetUpdated = 0;
+    sampledTraces.reserve(EXPERIENCE_BATCH_SIZE);
   }
 
   void createNetwork(unsigned inputDim) {
@@ -35,6 +53,7 @@ struct LearningAgent::LearningAgentImpl {
     spec.nodeActivationRate = 1.0f;
     spec.maxBatchSize = EXPERIENCE_BATCH_SIZE;
     spec.maxTraceLength = EXPERIENCE_MAX_TRACE_LENGTH;
+    spec.trainerBackend = rnn::TrainerBackend::AUTO;
 
     // Forward connections
     spec.connections.emplace_back(0, 1, 0);
@@ -50,19 +69,41 @@ struct LearningAgent::LearningAgentImpl {
     spec.layers.emplace_back(2, 128, false);
     spec.layers.emplace_back(3, spec.numOutputs, true);
 
-    network = make_unique<rnn::RNN>(spec);
+    network = make_unique<rnn::RNN>(spec, make_shared<rnn::FixedInferenceFor<DeployedRNN>>());
+    agentMemory = network->NewState();
   }
 
   Action SelectAction(const State *state) {
     assert(state != nullptr);
-
-    boost::shared_lock<boost::shared_mutex> lock(rwMutex);
     return chooseBestAction(state, false);
   }
 
-  void ResetMemory(void) {
-    boost::unique_lock<boost::shared_mutex> lock(rwMutex);
-    network->ClearMemory();
+  void ResetMemory(void) { agentMemory->Clear(); }
+
+  uptr<BatchMemory> NewBatchMemory(unsigned batchSize) {
+    auto result = make_unique<NetworkBatchMemory>();
+    result->states = network->NewBatchState(batchSize);
+    return move(result);
+  }
+
+  vector<Action> SelectBatchActions(const vector<State> &states, BatchMemory &memory) {
+    rnn::RNNBatchState &batchMemory = *static_cast<NetworkBatchMemory &>(memory).states;
+    assert(states.size() == batchMemory.NumStates());
+
+    EMatrix inputs(states.size(), network->GetSpec().numInputs);
+    for (unsigned i = 0; i < states.size(); i++) {
+      inputs.row(i) = states[i].Encode().transpose();
+    }
+
+    EMatrix qvalues;
+    network->ProcessBatch(inputs, batchMemory, qvalues);
+
+    vector<Action> result;
+    result.reserve(states.size());
+    for (unsigned i = 0; i < states.size(); i++) {
+      result.push_back(bestAvailableAction(&states[i], qvalues.row(i).transpose(), false));
+    }
+    return result;
   }
 
   void SetPRandom(float pRandom) {
@@ -75,72 +116,87 @@ struct LearningAgent::LearningAgentImpl {
     this->temperature = temperature;
   }
 
-  Action SelectLearningAction(const State *state) {
+  Action SelectLearningAction(const State *state, rnn::RNNState &memory) {
     assert(state != nullptr);
 
-    boost::shared_lock<boost::shared_mutex> lock(rwMutex);
     if (math::RandInterval(0.0, 1.0) < pRandom) {
       return chooseExplorativeAction(state);
     } else {
-      return chooseWeightedAction(state);
+      return chooseWeightedAction(state, process(state, memory));
       // return chooseBestAction(state, false);
     }
   }
 
+  EVector process(const State *state, rnn::RNNState &memory) {
+    EVector encoded = state->Encode();
+    return network->Process(encoded, memory);
+  }
+
   void Learn(const vector<Experience> &experiences, float learnRate) {
-    rnn::RNNSpec rnnSpec = network->GetSpec();
-    assert(experiences.size() <= rnnSpec.maxBatchSize);
+    assert(experiences.size() <= network->GetSpec().maxBatchSize);
 
     if (experiences.empty() || experiences.front().moments.empty()) {
       return;
     }
 
-    assert(experiences.front().moments.size() <= network->GetSpec().maxTraceLength);
+    unsigned traceLength = experiences.front().moments.size();
+    assert(traceLength <= network->GetSpec().maxTraceLength);
 
-    if (itersSinceTargetUpdated > TARGET_FUNCTION_UPDATE_RATE) {
-      Finalise();
-      itersSinceTargetUpdated = 0;
+    vector<rnn::SliceBatch> &staging = network->TrainingStaging(0);
+    for (unsigned i = 0; i < experiences.size(); i++) {
+      assert(experiences[i].moments.size() == traceLength);
+      for (unsigned j = 0; j < traceLength; j++) {
+        experiences[i].moments[j].WriteTo(staging[j], i);
+      }
     }
-    itersSinceTargetUpdated++;
-
-    vector<rnn::SliceBatch> trainInput;
-    trainInput.reserve(experiences.size());
 
-    // TODO: this could probably be just a "static" slice batch vector that is kept and reset
-    // between Learn calls.
-    for (unsigned i = 0; i < experiences.front().moments.size(); i++) {
-      trainInput.emplace_back(EMatrix(experiences.size(), rnnSpec.numInputs),
-                              EMatrix(experiences.size(), rnnSpec.numOutputs),
-                              EMatrix(experiences.size(), 1));
+    updateStaged(0, experiences.size(), traceLength, learnRate);
+  }
 
-      trainInput.back().batchInput.fill(0.0f);
-      trainInput.back().batchActions.fill(0.0f);
-      trainInput.back().batchRewards.fill(0.0f);
+  void Learn(ExperienceMemory &memory, float learnRate) {
+    if (memory.NumMemories() == 0) {
+      return;
     }
 
-    for (unsigned i = 0; i < experiences.size(); i++) {
-      assert(experiences[i].moments.size() == trainInput.size());
+    unsigned traceLength = memory.SampleInto(EXPERIENCE_BATCH_SIZE, EXPERIENCE_MAX_TRACE_LENGTH,
+                                             network->TrainingStaging(0), &sampledTraces);
+    if (traceLength > 0) {
+      updateStaged(0, EXPERIENCE_BATCH_SIZE, traceLength, learnRate);
+      memory.UpdatePriorities(sampledTraces, network->TraceErrors());
+    }
+  }
 
-      for (unsigned j = 0; j < experiences[i].moments.size(); j++) {
-        unsigned actionIndex = Action::ACTION_INDEX(experiences[i].moments[j].actionTaken);
+  void Learn(BatchPrefetcher &batches, float learnRate) {
+    BatchPrefetcher::Batch batch = batches.Acquire();
+    if (batch.traceLength > 0) {
+      updateStaged(batch.buffer, batches.BatchSize(), batch.traceLength, learnRate);
+    }
+    batches.Release(batch, network->TraceErrors());
+  }
 
-        trainInput[j].batchInput.row(i) = experiences[i].moments[j].observedState.transpose();
-        trainInput[j].batchActions(i, actionIndex) = 1.0f;
-        trainInput[j].batchRewards(i, 0) = experiences[i].moments[j].reward;
-      }
+  void updateStaged(unsigned buffer, unsigned batchSize, unsigned traceLength, float learnRate) {
+    if (itersSinceTargetUpdated > TARGET_FUNCTION_UPDATE_RATE) {
+      Finalise();
+      itersSinceTargetUpdated = 0;
     }
+    itersSinceTargetUpdated++;
 
-    network->Update(trainInput, learnRate);
+    network->UpdateStaged(buffer, batchSize, traceLength, learnRate);
   }
 
-  void Finalise(void) {
-    // obtain a write lock
-    boost::unique_lock<boost::shared_mutex> lock(rwMutex);
-    network->RefreshAndGetTarget();
+  void Finalise(void) { network->RefreshAndGetTarget(); }
+
+  void SetTrainingState(const vector<rnn::TrainerConnectionState> &state,
+                        unsigned itersSinceTargetUpdated) {
+    network->SetTrainingState(state);
+    this->itersSinceTargetUpdated = itersSinceTargetUpdated;
   }
 
   Action chooseBestAction(const State *state, bool print) {
-    EVector qvalues = network->Process(state->Encode());
+    return bestAvailableAction(state, network->Process(state->Encode(), *agentMemory), print);
+  }
+
+  Action bestAvailableAction(const State *state, const EVector &qvalues, bool print) {
     assert(qvalues.rows() == static_cast<int>(Action::NUM_ACTIONS()));
 
     std::vector<unsigned> availableActions = state->AvailableActions();
@@ -173,8 +229,7 @@ struct LearningAgent::LearningAgentImpl {
     return Action::ACTION(aa[rand() % aa.size()]);
   }
 
-  Action chooseWeightedAction(const State *state) {
-    EVector qvalues = network->Process(state->Encode());
+  Action chooseWeightedAction(const State *state, EVector qvalues) {
     assert(qvalues.rows() == static_cast<int>(Action::NUM_ACTIONS()));
 
     std::vector<unsigned> availableActions = state->AvailableActions();
@@ -200,15 +255,51 @@ LearningAgent::~LearningAgent() = default;
 Action LearningAgent::SelectAction(const State *state) { return impl->SelectAction(state); }
 void LearningAgent::ResetMemory(void) { impl->ResetMemory(); }
 
+uptr<Agent::BatchMemory> LearningAgent::NewBatchMemory(unsigned batchSize) {
+  return impl->NewBatchMemory(batchSize);
+}
+
+vector<Action> LearningAgent::SelectBatchActions(const vector<State> &states,
+                                                 BatchMemory &memory) {
+  return impl->SelectBatchActions(states, memory);
+}
+
+unsigned LearningAgent::InputDim(void) const { return impl->network->GetSpec().numInputs; }
+
 void LearningAgent::SetPRandom(float pRandom) { impl->SetPRandom(pRandom); }
 void LearningAgent::SetTemperature(float temperature) { impl->SetTemperature(temperature); }
 
-Action LearningAgent::SelectLearningAction(const State *state) {
-  return impl->SelectLearningAction(state);
+uptr<rnn::RNNState> LearningAgent::NewMemory(void) const { return impl->network->NewState(); }
+
+Action LearningAgent::SelectLearningAction(const State *state, rnn::RNNState &memory) {
+  return impl->SelectLearningAction(state, memory);
 }
 
 void LearningAgent::Learn(const vector<Experience> &experiences, float learnRate) {
   impl->Learn(experiences, learnRate);
 }
 
+void LearningAgent::Learn(ExperienceMemory &memory, float learnRate) {
+  impl->Learn(memory, learnRate);
+}
+
+void LearningAgent::Learn(BatchPrefetcher &batches, float learnRate) {
+  impl->Learn(batches, learnRate);
+}
+
+vector<rnn::SliceBatch> &LearningAgent::TrainingStaging(unsigned buffer) {
+  return impl->network->TrainingStaging(buffer);
+}
+
 void LearningAgent::Finalise(void) { impl->Finalise(); }
+
+void LearningAgent::GetTrainingState(vector<rnn::TrainerConnectionState> &outState,
+                                     unsigned &outItersSinceTargetUpdated) {
+  impl->network->GetTrainingState(outState);
+  outItersSinceTargetUpdated = impl->itersSinceTargetUpdated;
+}
+
+void LearningAgent::SetTrainingState(const vector<rnn::TrainerConnectionState> &state,
+                                     unsigned itersSinceTargetUpdated) {
+  impl->SetTrainingState(state, itersSinceTargetUpdated);
+}
@@ -1,10 +1,12 @@
 #pragma once
 
 #include "../common/Common.hpp"
+#include "../rnn/RNN.hpp"
 #include "../simulation/Action.hpp"
 #include "../simulation/State.hpp"
 #include "Agent.hpp"
 #include "Experience.hpp"
+#include "ExperienceMemory.hpp"
 
 #include <iostream>
 
@@ -12,6 +14,8 @@ using namespace simulation;
 
 namespace learning {
 
+class BatchPrefetcher;
+
 class LearningAgent : public Agent {
 public:
   LearningAgent(unsigned inputDim);
@@ -20,14 +24,43 @@ public:
   Action SelectAction(const State *state) override;
   void ResetMemory(void) override;
 
+  uptr<BatchMemory> NewBatchMemory(unsigned batchSize) override;
+  vector<Action> SelectBatchActions(const vector<State> &states, BatchMemory &memory) override;
+
+  // Size of the encoded states the network takes as input.
+  unsigned InputDim(void) const;
+
   void SetPRandom(float pRandom);
   void SetTemperature(float temperature);
 
-  Action SelectLearningAction(const State *state);
+  // Recurrent memory for playing out episodes with SelectLearningAction. Each thread generating
+  // experience owns its own, and then they can all select actions concurrently.
+  uptr<rnn::RNNState> NewMemory(void) const;
+  Action SelectLearningAction(const State *state, rnn::RNNState &memory);
+
   void Learn(const vector<Experience> &experiences, float learnRate);
 
+  // Learns from a batch sampled out of memory, gathered straight into the trainer's staging, and
+  // feeds the resulting TD errors back to the memory's priorities.
+  void Learn(ExperienceMemory &memory, float learnRate);
+
+  // Learns from the next batch assembled by the prefetcher, which must have been created for
+  // this agent. The other Learn calls must not be used while a prefetcher exists.
+  void Learn(BatchPrefetcher &batches, float learnRate);
+
+  // The network trainer's staging buffers (see rnn::NetworkTrainer::Staging).
+  vector<rnn::SliceBatch> &TrainingStaging(unsigned buffer);
+
   void Finalise(void);
 
+  // The network's training state (see rnn::RNN::GetTrainingState), along with the number of
+  // learn steps since the target network was last updated, for checkpointing. Neither may run
+  // concurrently with Learn.
+  void GetTrainingState(vector<rnn::TrainerConnectionState> &outState,
+                        unsigned &outItersSinceTargetUpdated);
+  void SetTrainingState(const vector<rnn::TrainerConnectionState> &state,
+                        unsigned itersSinceTargetUpdated);
+
 private:
   struct LearningAgentImpl;
   uptr<LearningAgentImpl> impl;
@@ -20,5 +20,17 @@ public:
   void ResetMemory(void) override {
     // Nothing to do.
   }
+
+  uptr<BatchMemory> NewBatchMemory(unsigned batchSize) override {
+    return make_unique<BatchMemory>();
+  }
+
+  vector<Action> SelectBatchActions(const vector<State> &states, BatchMemory &memory) override {
+    vector<Action> result;
+    for (const auto &state : states) {
+      result.push_back(SelectAction(&state));
+    }
+    return result;
+  }
 };
 }
@@ -0,0 +1,343 @@
+#include "ReplayStore.hpp"
+#include "../common/BinaryFile.hpp"
+#include "../simulation/Action.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+using namespace learning;
+
+static constexpr char FILE_MAGIC[8] = {'R', 'P', 'L', 'S', 'T', 'O', 'R', 'E'};
+static constexpr uint32_t FILE_FORMAT_VERSION = 2;
+static constexpr size_t SECTION_ALIGNMENT = 64;
+
+static constexpr float UINT8_STEP = 1.0f / 127.0f;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t formatVersion;
+  uint32_t numTraces;
+  uint32_t maxTraceLength;
+  uint32_t observationDim;
+  uint32_t observationEncoding;
+};
+
+static size_t aligned(size_t offset) {
+  return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+static unsigned encodedValueBytes(ObservationEncoding encoding) {
+  switch (encoding) {
+  case ObservationEncoding::FLOAT32:
+    return sizeof(float);
+  case ObservationEncoding::FLOAT16:
+    return sizeof(uint16_t);
+  case ObservationEncoding::UINT8:
+    return sizeof(uint8_t);
+  }
+  assert(false);
+  return 0;
+}
+
+static uint8_t quantize(float value) {
+  value = std::min(std::max(value, -1.0f), 1.0f);
+  return static_cast<uint8_t>(lrintf((value + 1.0f) * 127.0f));
+}
+
+static void dequantize(const uint8_t *in, float *out, unsigned n) {
+  unsigned i = 0;
+#ifdef __AVX2__
+  const __m256 step = _mm256_set1_ps(UINT8_STEP);
+  const __m256i zero = _mm256_set1_epi32(127);
+  for (; i + 8 <= n; i += 8) {
+    __m128i q = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i));
+    __m256i centred = _mm256_sub_epi32(_mm256_cvtepu8_epi32(q), zero);
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(centred), step));
+  }
+#endif
+  // Centring before scaling keeps -1, 0 and 1 exact (a fused multiply-add would not).
+  for (; i < n; i++) {
+    out[i] = static_cast<float>(static_cast<int>(in[i]) - 127) * UINT8_STEP;
+  }
+}
+
+// IEEE half precision, rounding to nearest even.
+static uint16_t floatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint16_t sign = (bits >> 16) & 0x8000;
+  bits &= 0x7fffffff;
+
+  if (bits > 0x7f800000) { // NaN
+    return sign | 0x7e00;
+  }
+  if (bits >= 0x477ff000) { // rounds to beyond the largest half, 65504.
+    return sign | 0x7c00;
+  }
+  if (bits < 0x38800000) { // subnormal, in units of 2^-24.
+    return sign | static_cast<uint16_t>(lrintf(fabsf(value) * 16777216.0f));
+  }
+
+  bits += 0xfff + ((bits >> 13) & 1);
+  return sign | static_cast<uint16_t>((bits - 0x38000000) >> 13);
+}
+
+static float halfToFloat(uint16_t half) {
+  uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1f;
+  uint32_t mantissa = half & 0x3ff;
+
+  if (exponent == 0) {
+    float magnitude = mantissa / 16777216.0f;
+    return sign ? -magnitude : magnitude;
+  }
+
+  uint32_t bits = exponent == 0x1f ? sign | 0x7f800000 | (mantissa << 13)
+                                   : sign | ((exponent + 112) << 23) | (mantissa << 13);
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+static void halvesToFloats(const uint16_t *in, float *out, unsigned n) {
+  unsigned i = 0;
+#ifdef __F16C__
+  for (; i + 8 <= n; i += 8) {
+    __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(half));
+  }
+#endif
+  for (; i < n; i++) {
+    out[i] = halfToFloat(in[i]);
+  }
+}
+
+static const string FILE_KIND = "replay store";
+
+// Byte offsets of each array, which are the same on the heap and in the file.
+struct ReplayStore::Layout {
+  size_t sequences, traceLengths, observations, rewards, actions, totalSize;
+
+  Layout(unsigned numTraces, unsigned maxTraceLength, unsigned observationBytes) {
+    size_t numSteps = static_cast<size_t>(numTraces) * maxTraceLength;
+
+    sequences = aligned(sizeof(FileHeader));
+    traceLengths = aligned(sequences + numTraces * sizeof(uint64_t));
+    observations = aligned(traceLengths + numTraces * sizeof(uint32_t));
+    rewards = aligned(observations + numSteps * observationBytes);
+    actions = aligned(rewards + numSteps * sizeof(float));
+    totalSize = aligned(actions + numSteps * sizeof(uint8_t));
+  }
+};
+
+ReplayStore::ReplayStore(unsigned numTraces, unsigned maxTraceLength, unsigned observationDim,
+                         ObservationEncoding encoding)
+    : numTraces(numTraces), maxTraceLength(maxTraceLength), observationDim(observationDim),
+      encoding(encoding), observationBytes(observationDim * encodedValueBytes(encoding)),
+      readOnly(false), mapped(nullptr), mappedSize(0) {
+  assert(numTraces > 0 && maxTraceLength > 0 && observationDim > 0);
+  assert(Action::NUM_ACTIONS() <= std::numeric_limits<uint8_t>::max() + 1u);
+
+  Layout layout(numTraces, maxTraceLength, observationBytes);
+  heap = uptr<uint8_t[]>(new uint8_t[layout.totalSize]());
+  assign(heap.get(), layout);
+}
+
+ReplayStore::ReplayStore(const string &path, unsigned numTraces, unsigned maxTraceLength,
+                         unsigned observationDim, ObservationEncoding encoding, bool readOnly)
+    : numTraces(numTraces), maxTraceLength(maxTraceLength), observationDim(observationDim),
+      encoding(encoding), observationBytes(observationDim * encodedValueBytes(encoding)),
+      readOnly(readOnly), mapped(nullptr), mappedSize(0) {
+  assert(numTraces > 0 && maxTraceLength > 0 && observationDim > 0);
+  assert(Action::NUM_ACTIONS() <= std::numeric_limits<uint8_t>::max() + 1u);
+
+  Layout layout(numTraces, maxTraceLength, observationBytes);
+
+  int fd = readOnly ? open(path.c_str(), O_RDONLY) : open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    FailFile(FILE_KIND, path, strerror(errno));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    FailFile(FILE_KIND, path, strerror(errno));
+  }
+
+  // A new file is extended with zeroes, which is an empty store once it has a header.
+  bool created = st.st_size == 0;
+  if (created) {
+    if (readOnly) {
+      FailFile(FILE_KIND, path, "empty file");
+    }
+    if (ftruncate(fd, layout.totalSize) != 0) {
+      FailFile(FILE_KIND, path, strerror(errno));
+    }
+  } else if (static_cast<size_t>(st.st_size) != layout.totalSize) {
+    FailFile(FILE_KIND, path, "size does not match the requested shape");
+  }
+
+  int prot = readOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+  mapped = mmap(nullptr, layout.totalSize, prot, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    FailFile(FILE_KIND, path, strerror(errno));
+  }
+  mappedSize = layout.totalSize;
+
+  FileHeader *header = static_cast<FileHeader *>(mapped);
+  if (created) {
+    memcpy(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header->formatVersion = FILE_FORMAT_VERSION;
+    header->numTraces = numTraces;
+    header->maxTraceLength = maxTraceLength;
+    header->observationDim = observationDim;
+    header->observationEncoding = static_cast<uint32_t>(encoding);
+  } else if (memcmp(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+             header->formatVersion != FILE_FORMAT_VERSION || header->numTraces != numTraces ||
+             header->maxTraceLength != maxTraceLength ||
+             header->observationDim != observationDim ||
+             header->observationEncoding != static_cast<uint32_t>(encoding)) {
+    FailFile(FILE_KIND, path, "header does not match the requested shape");
+  }
+
+  assign(static_cast<uint8_t *>(mapped), layout);
+}
+
+ReplayStore::~ReplayStore() {
+  if (mapped != nullptr) {
+    munmap(mapped, mappedSize);
+  }
+}
+
+void ReplayStore::assign(uint8_t *base, const Layout &layout) {
+  sequences = reinterpret_cast<uint64_t *>(base + layout.sequences);
+  traceLengths = reinterpret_cast<uint32_t *>(base + layout.traceLengths);
+  observations = base + layout.observations;
+  rewards = reinterpret_cast<float *>(base + layout.rewards);
+  actions = base + layout.actions;
+}
+
+void ReplayStore::Store(unsigned trace, unsigned long sequence, const Experience &experience) {
+  assert(!readOnly);
+  assert(trace < numTraces);
+  assert(experience.moments.size() <= maxTraceLength);
+
+  // Mark the slot empty while it is rewritten, so a store interrupted part way (e.g. by the
+  // process being killed) is skipped on reopen rather than read as a mix of two experiences.
+  traceLengths[trace] = 0;
+  sequences[trace] = sequence;
+
+  size_t first = static_cast<size_t>(trace) * maxTraceLength;
+  for (unsigned step = 0; step < experience.moments.size(); step++) {
+    const ExperienceMoment &moment = experience.moments[step];
+    assert(moment.observedState.rows() == static_cast<int>(observationDim));
+
+    size_t si = first + step;
+    const float *in = moment.observedState.data();
+    uint8_t *out = &observations[si * observationBytes];
+    switch (encoding) {
+    case ObservationEncoding::FLOAT32:
+      memcpy(out, in, observationBytes);
+      break;
+    case ObservationEncoding::FLOAT16:
+      for (unsigned i = 0; i < observationDim; i++) {
+        uint16_t half = floatToHalf(in[i]);
+        memcpy(out + i * sizeof(uint16_t), &half, sizeof(uint16_t));
+      }
+      break;
+    case ObservationEncoding::UINT8:
+      for (unsigned i = 0; i < observationDim; i++) {
+        out[i] = quantize(in[i]);
+      }
+      break;
+    }
+    actions[si] = Action::ACTION_INDEX(moment.actionTaken);
+    rewards[si] = moment.reward;
+  }
+
+  traceLengths[trace] = experience.moments.size();
+}
+
+void ReplayStore::CopyTrace(unsigned trace, const ReplayStore &other) {
+  assert(!readOnly);
+  assert(trace < numTraces);
+  assert(other.numTraces == numTraces && other.maxTraceLength == maxTraceLength &&
+         other.observationDim == observationDim && other.encoding == encoding);
+
+  // As in Store, the slot reads as empty until the copy is complete.
+  traceLengths[trace] = 0;
+  sequences[trace] = other.sequences[trace];
+
+  size_t first = static_cast<size_t>(trace) * maxTraceLength;
+  size_t length = other.traceLengths[trace];
+  memcpy(&observations[first * observationBytes], &other.observations[first * observationBytes],
+         length * observationBytes);
+  memcpy(&rewards[first], &other.rewards[first], length * sizeof(float));
+  memcpy(&actions[first], &other.actions[first], length * sizeof(uint8_t));
+
+  traceLengths[trace] = length;
+}
+
+void ReplayStore::Erase(unsigned trace) {
+  assert(!readOnly);
+  assert(trace < numTraces);
+
+  traceLengths[trace] = 0;
+  sequences[trace] = 0;
+}
+
+bool ReplayStore::Sync(void) {
+  return mapped == nullptr || msync(mapped, mappedSize, MS_SYNC) == 0;
+}
+
+EVector ReplayStore::Observation(unsigned trace, unsigned step) const {
+  EVector result(observationDim);
+  decodeObservation(trace, step, result.data());
+  return result;
+}
+
+Experience ReplayStore::Load(unsigned trace) const {
+  Experience result;
+  result.moments.reserve(TraceLength(trace));
+  for (unsigned step = 0; step < TraceLength(trace); step++) {
+    result.moments.emplace_back(Observation(trace, step), Action::ACTION(ActionIndex(trace, step)),
+                                Reward(trace, step));
+  }
+  return result;
+}
+
+void ReplayStore::WriteTo(unsigned trace, unsigned step, rnn::SliceBatch &slice,
+                          unsigned row) const {
+  // batchInput is row major, so the observation decodes straight into the row.
+  assert(slice.batchInput.cols() == static_cast<int>(observationDim));
+  decodeObservation(trace, step, slice.batchInput.row(row).data());
+  slice.batchActions.row(row).setZero();
+  slice.batchActions(row, ActionIndex(trace, step)) = 1.0f;
+  slice.batchRewards(row, 0) = Reward(trace, step);
+}
+
+void ReplayStore::decodeObservation(unsigned trace, unsigned step, float *out) const {
+  const uint8_t *in = observationData(trace, step);
+  switch (encoding) {
+  case ObservationEncoding::FLOAT32:
+    memcpy(out, in, observationBytes);
+    break;
+  case ObservationEncoding::FLOAT16:
+    halvesToFloats(reinterpret_cast<const uint16_t *>(in), out, observationDim);
+    break;
+  case ObservationEncoding::UINT8:
+    dequantize(in, out, observationDim);
+    break;
+  }
+}
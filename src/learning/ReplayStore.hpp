@@ -0,0 +1,113 @@
+#pragma once
+
+#include "../common/Common.hpp"
+#include "../math/Math.hpp"
+#include "../rnn/SliceBatch.hpp"
+#include "Experience.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace learning {
+
+// How a ReplayStore keeps observations. The compact encodings assume values in [-1, 1], as
+// produced by State::Encode (a +-1 heading flag and normalised sonar distances). UINT8 quantizes
+// to steps of 1/127, keeping -1, 0 and 1 exact, for a quarter of the memory of FLOAT32.
+enum class ObservationEncoding : uint32_t { FLOAT32 = 0, FLOAT16 = 1, UINT8 = 2 };
+
+// Columnar storage for a fixed number of traces of up to maxTraceLength steps each. The
+// observations live in one contiguous array, the action indices in a uint8 array and the rewards
+// in a float array, all addressed by (trace, step), so there is no per-moment allocation and a
+// trace's steps are adjacent in memory. Observations are encoded on Store, and decoded a whole
+// row at a time (with SIMD where available) when read.
+//
+// The arrays either live on the heap, or in a memory mapped file so that the store can be larger
+// than RAM, outlive the process, and be opened read-only by other processes through the page
+// cache. The file is a small header followed by the same arrays, each with a fixed width per
+// trace or step, so it is used in place with no (de)serialisation.
+class ReplayStore {
+public:
+  ReplayStore(unsigned numTraces, unsigned maxTraceLength, unsigned observationDim,
+              ObservationEncoding encoding = ObservationEncoding::FLOAT32);
+
+  // Maps the store file at path, creating it with the given shape if it does not exist. An
+  // existing file must have the same shape and encoding, and keeps its stored traces. A read-only
+  // store may be opened by any number of processes, but should not be written by another at the
+  // same time.
+  ReplayStore(const string &path, unsigned numTraces, unsigned maxTraceLength,
+              unsigned observationDim,
+              ObservationEncoding encoding = ObservationEncoding::FLOAT32, bool readOnly = false);
+  ~ReplayStore();
+
+  ReplayStore(const ReplayStore &other) = delete;
+  ReplayStore &operator=(const ReplayStore &other) = delete;
+
+  unsigned NumTraces(void) const { return numTraces; }
+  unsigned MaxTraceLength(void) const { return maxTraceLength; }
+  unsigned ObservationDim(void) const { return observationDim; }
+  ObservationEncoding Encoding(void) const { return encoding; }
+  bool IsReadOnly(void) const { return readOnly; }
+
+  // Overwrites the given trace slot with the moments of experience. sequence is the experience's
+  // position in the order of everything ever stored, so that the order survives a reopen.
+  void Store(unsigned trace, unsigned long sequence, const Experience &experience);
+  Experience Load(unsigned trace) const;
+
+  // Overwrites the given slot with the same slot of other, which must have the same shape and
+  // encoding, copying the encoded bytes as they are.
+  void CopyTrace(unsigned trace, const ReplayStore &other);
+
+  // Empties the given slot, as if it had never been stored to.
+  void Erase(unsigned trace);
+
+  // Writes a file backed store through to the disk, and returns false (with errno set) if that
+  // failed. A heap store has nothing to write.
+  bool Sync(void);
+
+  // Zero length for a slot that has never been stored to.
+  unsigned TraceLength(unsigned trace) const { return traceLengths[trace]; }
+  unsigned long Sequence(unsigned trace) const { return sequences[trace]; }
+
+  // The decoded observation.
+  EVector Observation(unsigned trace, unsigned step) const;
+  unsigned ActionIndex(unsigned trace, unsigned step) const {
+    return actions[stepIndex(trace, step)];
+  }
+  float Reward(unsigned trace, unsigned step) const { return rewards[stepIndex(trace, step)]; }
+
+  // Writes a step into the given row of a training slice, with a one hot action.
+  void WriteTo(unsigned trace, unsigned step, rnn::SliceBatch &slice, unsigned row) const;
+
+private:
+  struct Layout;
+
+  unsigned numTraces;
+  unsigned maxTraceLength;
+  unsigned observationDim;
+  ObservationEncoding encoding;
+  unsigned observationBytes; // per observation.
+  bool readOnly;
+
+  uptr<uint8_t[]> heap;
+  void *mapped;
+  size_t mappedSize;
+
+  uint64_t *sequences;
+  uint32_t *traceLengths;
+  uint8_t *observations;
+  float *rewards;
+  uint8_t *actions;
+
+  void assign(uint8_t *base, const Layout &layout);
+
+  const uint8_t *observationData(unsigned trace, unsigned step) const {
+    return &observations[stepIndex(trace, step) * observationBytes];
+  }
+  void decodeObservation(unsigned trace, unsigned step, float *out) const;
+
+  size_t stepIndex(unsigned trace, unsigned step) const {
+    assert(trace < numTraces && step < traceLengths[trace]);
+    return static_cast<size_t>(trace) * maxTraceLength + step;
+  }
+};
+}
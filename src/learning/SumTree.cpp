@@ -0,0 +1,41 @@
+#include "SumTree.hpp"
+#include <cassert>
+
+using namespace learning;
+
+SumTree::SumTree(unsigned size) : size(size), leafOffset(1) {
+  assert(size > 0);
+  while (leafOffset < size) {
+    leafOffset *= 2;
+  }
+  nodes.resize(2 * leafOffset, 0.0);
+}
+
+void SumTree::Set(unsigned index, double priority) {
+  assert(index < size);
+  assert(priority >= 0.0);
+
+  unsigned node = leafOffset + index;
+  nodes[node] = priority;
+  for (node /= 2; node >= 1; node /= 2) {
+    nodes[node] = nodes[2 * node] + nodes[2 * node + 1];
+  }
+}
+
+unsigned SumTree::Find(double value) const {
+  unsigned node = 1;
+  while (node < leafOffset) {
+    unsigned left = 2 * node;
+    // Rounding in the sums can leave value past the last non-zero leaf, so never descend into an
+    // empty subtree.
+    if ((value < nodes[left] && nodes[left] > 0.0) || nodes[left + 1] <= 0.0) {
+      node = left;
+    } else {
+      value -= nodes[left];
+      node = left + 1;
+    }
+  }
+
+  unsigned index = node - leafOffset;
+  return index < size ? index : size - 1;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../common/Common.hpp"
+#include <vector>
+
+namespace learning {
+
+// Binary tree over a fixed number of non-negative priorities where each internal node holds the
+// sum of its children, so that setting a priority and sampling an index in proportion to its
+// priority are both O(log n). Not thread safe.
+class SumTree {
+public:
+  SumTree(unsigned size);
+
+  unsigned Size(void) const { return size; }
+
+  void Set(unsigned index, double priority);
+  double Get(unsigned index) const { return nodes[leafOffset + index]; }
+
+  double Total(void) const { return nodes[1]; }
+
+  // The index whose span of the cumulative priorities contains value, for 0 <= value < Total().
+  // Never returns an index with zero priority unless Total() is zero.
+  unsigned Find(double value) const;
+
+private:
+  unsigned size;
+  unsigned leafOffset; // nodes[1] is the root, leaves start at leafOffset.
+  vector<double> nodes;
+};
+}
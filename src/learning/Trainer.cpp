@@ -5,10 +5,12 @@
 #include "../common/Timer.hpp"
 #include "../simulation/Action.hpp"
 #include "../simulation/State.hpp"
+#include "BatchPrefetcher.hpp"
 #include "Constants.hpp"
 #include "ExperienceGenerator.hpp"
 #include "ExperienceMemory.hpp"
 #include "LearningAgent.hpp"
+#include "TrainingCheckpointer.hpp"
 
 #include <atomic>
 #include <cassert>
@@ -20,7 +22,32 @@
 
 using namespace learning;
 
-static constexpr unsigned EXPERIENCE_MEMORY_SIZE = 1000;
+// If set, the replay memory is kept in this memory mapped file rather than on the heap, so it can
+// be much larger than RAM and carries over to the next run.
+static constexpr const char *REPLAY_MEMORY_FILE = nullptr;
+
+// Observations are kept as floats by default. FLOAT16 and UINT8 are lossy (UINT8 leaves the [0, 1]
+// channels only 128 levels), and are only worth it for a memory too large to hold as floats, so
+// the replay memory grows to fill the same space with whichever encoding is chosen.
+static constexpr ObservationEncoding REPLAY_OBSERVATION_ENCODING = ObservationEncoding::FLOAT32;
+
+static constexpr unsigned FLOAT32_EXPERIENCE_MEMORY_SIZE = 1000;
+static constexpr unsigned EXPERIENCE_MEMORY_SIZE =
+    REPLAY_OBSERVATION_ENCODING == ObservationEncoding::UINT8
+        ? 4 * FLOAT32_EXPERIENCE_MEMORY_SIZE
+        : REPLAY_OBSERVATION_ENCODING == ObservationEncoding::FLOAT16
+              ? 2 * FLOAT32_EXPERIENCE_MEMORY_SIZE
+              : FLOAT32_EXPERIENCE_MEMORY_SIZE;
+
+// If set, training is checkpointed into this directory every CHECKPOINT_INTERVAL learn iterations,
+// and resumes from the checkpoint there if there is one. The replay memory is only included if it
+// is on the heap, as a memory mapped one persists by itself.
+static constexpr const char *CHECKPOINT_DIRECTORY = nullptr;
+static constexpr unsigned CHECKPOINT_INTERVAL = 5000;
+
+// Each evaluation during training averages over this many tracks. It runs in the background, so
+// it can be many more than it would be affordable to play on an actor's thread.
+static constexpr unsigned TRAINING_EVALUATION_EPISODES = 200;
 
 static constexpr float INITIAL_PRANDOM = 0.9f;
 static constexpr float TARGET_PRANDOM = 0.1f;
@@ -31,33 +58,79 @@ static constexpr float TARGET_TEMPERATURE = 0.01f;
 static constexpr float INITIAL_LEARN_RATE = 0.5f;
 static constexpr float TARGET_LEARN_RATE = 0.01f;
 
+// One actor per core, leaving a core for the learner.
+static unsigned numActorThreads(void) {
+  unsigned cores = std::thread::hardware_concurrency();
+  return cores > 1 ? cores - 1 : 1;
+}
+
 struct Trainer::TrainerImpl {
   atomic<unsigned> numLearnIters;
+  atomic<unsigned> numExperiences;
 
   void TrainAgent(LearningAgent *agent, unsigned iters) {
-    auto experienceMemory = make_unique<ExperienceMemory>(EXPERIENCE_MEMORY_SIZE);
+    auto experienceMemory = make_unique<ExperienceMemory>(createReplayStore(agent),
+                                                          PRIORITIZED_REPLAY);
     auto experienceGenerator = make_unique<ExperienceGenerator>();
-    numLearnIters = 0;
 
-    std::thread playoutThread =
-        startExperienceThread(agent, experienceMemory.get(), experienceGenerator.get(), iters);
-    std::thread learnThread = startLearnThread(agent, experienceMemory.get(), iters);
-
-    playoutThread.join();
+    uptr<TrainingCheckpointer> checkpointer;
+    unsigned startIter = 0;
+    if (CHECKPOINT_DIRECTORY != nullptr) {
+      checkpointer = make_unique<TrainingCheckpointer>(CHECKPOINT_DIRECTORY, agent,
+                                                       experienceMemory.get(),
+                                                       REPLAY_MEMORY_FILE == nullptr);
+      if (checkpointer->Restore(startIter)) {
+        cout << "resuming from learn iteration " << startIter << endl;
+      }
+    }
+
+    numLearnIters = startIter;
+    numExperiences = 0;
+
+    vector<std::thread> actorThreads;
+    for (unsigned i = 0; i < numActorThreads(); i++) {
+      actorThreads.push_back(startExperienceThread(agent, experienceMemory.get(),
+                                                   experienceGenerator.get(), iters, i));
+    }
+    std::thread learnThread =
+        startLearnThread(agent, experienceMemory.get(), checkpointer.get(), startIter, iters);
+
+    for (auto &t : actorThreads) {
+      t.join();
+    }
     learnThread.join();
   }
 
+  // A memory mapped store in REPLAY_MEMORY_FILE if one is set, otherwise one on the heap.
+  uptr<ReplayStore> createReplayStore(LearningAgent *agent) {
+    if (REPLAY_MEMORY_FILE != nullptr) {
+      return make_unique<ReplayStore>(REPLAY_MEMORY_FILE, EXPERIENCE_MEMORY_SIZE,
+                                      GENERATED_TRACE_LENGTH, agent->InputDim(),
+                                      REPLAY_OBSERVATION_ENCODING);
+    } else {
+      return make_unique<ReplayStore>(EXPERIENCE_MEMORY_SIZE, GENERATED_TRACE_LENGTH,
+                                      agent->InputDim(), REPLAY_OBSERVATION_ENCODING);
+    }
+  }
+
+  // Each actor plays out episodes with its own recurrent memory. The first actor also periodically
+  // starts an evaluation of the agent in the background.
   std::thread startExperienceThread(LearningAgent *agent, ExperienceMemory *memory,
-                                    ExperienceGenerator *generator, unsigned iters) {
+                                    ExperienceGenerator *generator, unsigned iters,
+                                    unsigned actor) {
 
-    return std::thread([this, agent, memory, generator, iters]() {
+    return std::thread([this, agent, memory, generator, iters, actor]() {
       float pRandDecay = powf(TARGET_PRANDOM / INITIAL_PRANDOM, 1.0f / iters);
       assert(pRandDecay > 0.0f && pRandDecay <= 1.0f);
 
       float tempDecay = powf(TARGET_TEMPERATURE / INITIAL_TEMPERATURE, 1.0f / iters);
       assert(tempDecay > 0.0f && tempDecay <= 1.0f);
 
+      uptr<rnn::RNNState> actorMemory = agent->NewMemory();
+
       unsigned nextEvalIters = 0;
+      unsigned evalIters = 0;
+      std::future<float> evaluation;
       while (true) {
         unsigned doneIters = numLearnIters.load();
         if (doneIters >= iters) {
@@ -70,19 +143,34 @@ struct Trainer::TrainerImpl {
         agent->SetPRandom(prand);
         agent->SetTemperature(temp);
 
-        memory->AddExperience(generator->GenerateExperience(agent));
+        memory->AddExperience(generator->GenerateExperience(agent, *actorMemory));
+        numExperiences++;
 
-        if (doneIters > nextEvalIters) {
-          cout << nextEvalIters << "\t" << Evaluator::Evaluate(agent) << endl;
+        // An evaluation is started in the background and its result reported once it is done,
+        // without holding up the actor. If the previous one is still running, the next is put off
+        // rather than run alongside it.
+        if (actor == 0 && evaluation.valid() &&
+            evaluation.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+          cout << evalIters << "\t" << evaluation.get() << endl;
+        }
+        if (actor == 0 && !evaluation.valid() && doneIters > nextEvalIters) {
+          evalIters = nextEvalIters;
+          evaluation = Evaluator::EvaluateAsync(agent, TRAINING_EVALUATION_EPISODES);
           nextEvalIters += iters / 20;
         }
         // cout << "experiences generated: " << memory->NumMemories() << endl;
       }
+
+      if (evaluation.valid()) {
+        cout << evalIters << "\t" << evaluation.get() << endl;
+      }
     });
   }
 
-  std::thread startLearnThread(LearningAgent *agent, ExperienceMemory *memory, unsigned iters) {
-    return std::thread([this, agent, memory, iters]() {
+  std::thread startLearnThread(LearningAgent *agent, ExperienceMemory *memory,
+                               TrainingCheckpointer *checkpointer, unsigned startIter,
+                               unsigned iters) {
+    return std::thread([this, agent, memory, checkpointer, startIter, iters]() {
       float lrDecay = powf(TARGET_LEARN_RATE / INITIAL_LEARN_RATE, 1.0f / iters);
       assert(lrDecay > 0.0f && lrDecay <= 1.0f);
 
@@ -94,12 +182,32 @@ struct Trainer::TrainerImpl {
       // for (unsigned i = 2; i <= EXPERIENCE_MAX_TRACE_LENGTH; i++) {
       //   for (unsigned j = 0; j < iters / EXPERIENCE_MAX_TRACE_LENGTH; j++) {
 
-      for (unsigned it = 0; it < iters; it++) {
+      Timer rateTimer;
+      rateTimer.Start();
+      unsigned rateStartExperiences = numExperiences.load();
+
+      // The next batch is sampled on another thread while the current one trains.
+      BatchPrefetcher batches(agent, memory, EXPERIENCE_BATCH_SIZE, EXPERIENCE_MAX_TRACE_LENGTH);
+
+      for (unsigned it = startIter; it < iters; it++) {
         float lr = INITIAL_LEARN_RATE * powf(lrDecay, it);
-        agent->Learn(memory->Sample(EXPERIENCE_BATCH_SIZE, EXPERIENCE_MAX_TRACE_LENGTH), lr);
+        agent->Learn(batches, lr);
+
+        if (checkpointer != nullptr && (it + 1) % CHECKPOINT_INTERVAL == 0) {
+          checkpointer->Save(it + 1);
+        }
 
         if (it % 1000 == 0) {
-          cout << "learn: " << ((100 * it) / iters) << "%" << endl;
+          rateTimer.Stop();
+          unsigned curExperiences = numExperiences.load();
+          float rate =
+              (curExperiences - rateStartExperiences) / rateTimer.GetIntervalElapsedSeconds();
+
+          cout << "learn: " << ((100 * it) / iters) << "% (" << rate << " experiences/sec)"
+               << endl;
+
+          rateTimer.Start();
+          rateStartExperiences = curExperiences;
         }
 
         this->numLearnIters++;
@@ -0,0 +1,251 @@
+#include "TrainingCheckpointer.hpp"
+#include "../common/BinaryFile.hpp"
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace learning;
+
+static constexpr char FILE_MAGIC[8] = {'R', 'N', 'N', 'T', 'R', 'A', 'I', 'N'};
+static constexpr uint32_t FILE_FORMAT_VERSION = 1;
+static const string FILE_KIND = "training checkpoint";
+
+// The training file is this header, then each connection's header followed by its weights, target
+// weights, momentum and rms, then the replay priorities, then the name of the replay file.
+struct FileHeader {
+  char magic[8];
+  uint32_t formatVersion;
+  uint32_t iteration;
+  uint32_t itersSinceTargetUpdated;
+  uint32_t numConnections;
+  uint32_t numPriorities;
+  uint32_t replayNameLength; // 0 if the checkpoint has no replay memory.
+  double maxPriority;
+  uint64_t fileSize;
+  uint64_t checksum; // of everything after the header.
+};
+
+struct ConnectionHeader {
+  uint32_t srcLayerId;
+  uint32_t dstLayerId;
+  int32_t timeOffset;
+  uint32_t rows;
+  uint32_t cols;
+  uint32_t padding;
+};
+
+static void append(vector<uint8_t> &out, const void *data, size_t size) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  out.insert(out.end(), bytes, bytes + size);
+}
+
+// Reads consecutive sections out of a training file, failing if it runs past the end.
+struct FileReader {
+  const string &path;
+  const vector<uint8_t> &image;
+  size_t offset;
+
+  FileReader(const string &path, const vector<uint8_t> &image, size_t offset)
+      : path(path), image(image), offset(offset) {}
+
+  void Read(void *out, size_t size) {
+    if (offset + size > image.size()) {
+      FailFile(FILE_KIND, path, "truncated");
+    }
+    memcpy(out, image.data() + offset, size);
+    offset += size;
+  }
+};
+
+TrainingCheckpointer::TrainingCheckpointer(const string &directory, LearningAgent *agent,
+                                           ExperienceMemory *memory, bool includeReplay)
+    : directory(directory), agent(agent), memory(memory), writing(false), stopping(false) {
+  assert(agent != nullptr && memory != nullptr);
+
+  if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+    FailFile(FILE_KIND, directory, strerror(errno));
+  }
+
+  if (includeReplay) {
+    const ReplayStore &store = memory->Store();
+    staging.replay = make_unique<ReplayStore>(store.NumTraces(), store.MaxTraceLength(),
+                                              store.ObservationDim(), store.Encoding());
+  }
+
+  writer = std::thread([this]() {
+    while (true) {
+      pending.wait();
+      if (writing) {
+        write();
+        writing = false;
+      }
+      if (stopping) {
+        break;
+      }
+    }
+  });
+}
+
+TrainingCheckpointer::~TrainingCheckpointer() {
+  stopping = true;
+  pending.notify();
+  writer.join();
+}
+
+bool TrainingCheckpointer::Save(unsigned iteration) {
+  if (writing) {
+    return false;
+  }
+
+  staging.iteration = iteration;
+  agent->GetTrainingState(staging.trainer, staging.itersSinceTargetUpdated);
+  if (staging.replay != nullptr) {
+    memory->Snapshot(*staging.replay, staging.priorities, staging.maxPriority);
+  }
+
+  writing = true;
+  pending.notify();
+  return true;
+}
+
+bool TrainingCheckpointer::Restore(unsigned &outIteration) {
+  string path = trainingPath();
+  std::ifstream in(path, std::ios::binary);
+  if (!in.is_open()) {
+    return false;
+  }
+
+  vector<uint8_t> image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  CheckFileImage<FileHeader>(FILE_KIND, path, image.data(), image.size(), FILE_MAGIC,
+                             FILE_FORMAT_VERSION);
+
+  FileHeader header;
+  memcpy(&header, image.data(), sizeof(header));
+
+  FileReader reader(path, image, sizeof(FileHeader));
+
+  staging.trainer.resize(header.numConnections);
+  for (auto &cs : staging.trainer) {
+    ConnectionHeader ch;
+    reader.Read(&ch, sizeof(ch));
+
+    cs.connection = rnn::LayerConnection(ch.srcLayerId, ch.dstLayerId, ch.timeOffset);
+    for (EMatrix *m : {&cs.weights, &cs.targetWeights, &cs.momentum, &cs.rms}) {
+      m->resize(ch.rows, ch.cols);
+      reader.Read(m->data(), m->size() * sizeof(float));
+    }
+  }
+
+  vector<double> priorities(header.numPriorities);
+  reader.Read(priorities.data(), priorities.size() * sizeof(double));
+
+  string replayName(header.replayNameLength, '\0');
+  reader.Read(&replayName[0], replayName.size());
+
+  agent->SetTrainingState(staging.trainer, header.itersSinceTargetUpdated);
+
+  if (!replayName.empty()) {
+    string replayPath = directory + "/" + replayName;
+    if (staging.replay != nullptr) {
+      const ReplayStore &store = memory->Store();
+      ReplayStore replay(replayPath, store.NumTraces(), store.MaxTraceLength(),
+                         store.ObservationDim(), store.Encoding(), true);
+      memory->Restore(replay, priorities, header.maxPriority);
+    }
+    lastReplayPath = replayPath;
+  }
+
+  outIteration = header.iteration;
+  return true;
+}
+
+void TrainingCheckpointer::write(void) {
+  string replay;
+  if (staging.replay != nullptr) {
+    replay = replayPath(staging.iteration);
+    writeReplay(replay);
+  }
+
+  // Once the training file is renamed into place, and the rename is on disk, the checkpoint is
+  // complete and the previous checkpoint's replay file is no longer needed.
+  writeTraining(trainingPath(), replay);
+
+  if (!lastReplayPath.empty() && lastReplayPath != replay) {
+    unlink(lastReplayPath.c_str());
+  }
+  lastReplayPath = replay;
+}
+
+void TrainingCheckpointer::writeReplay(const string &path) {
+  string tmpPath = path + ".tmp";
+
+  // A leftover from an interrupted write would be reopened rather than replaced.
+  unlink(tmpPath.c_str());
+  {
+    const ReplayStore &src = *staging.replay;
+    ReplayStore dst(tmpPath, src.NumTraces(), src.MaxTraceLength(), src.ObservationDim(),
+                    src.Encoding());
+    for (unsigned i = 0; i < src.NumTraces(); i++) {
+      dst.CopyTrace(i, src);
+    }
+    if (!dst.Sync()) {
+      FailFile(FILE_KIND, tmpPath, strerror(errno));
+    }
+  }
+
+  CommitFile(FILE_KIND, tmpPath, path);
+}
+
+void TrainingCheckpointer::writeTraining(const string &path, const string &replayPath) {
+  // The file only records the replay file's name, so the directory can be moved.
+  string replayName = replayPath.substr(replayPath.empty() ? 0 : directory.size() + 1);
+
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+  header.formatVersion = FILE_FORMAT_VERSION;
+  header.iteration = staging.iteration;
+  header.itersSinceTargetUpdated = staging.itersSinceTargetUpdated;
+  header.numConnections = staging.trainer.size();
+  header.numPriorities = replayName.empty() ? 0 : staging.priorities.size();
+  header.replayNameLength = replayName.size();
+  header.maxPriority = staging.maxPriority;
+
+  // The size and checksum are filled in once the rest of the file is known.
+  fileImage.clear();
+  append(fileImage, &header, sizeof(header));
+
+  for (const auto &cs : staging.trainer) {
+    ConnectionHeader ch{cs.connection.srcLayerId,
+                        cs.connection.dstLayerId,
+                        cs.connection.timeOffset,
+                        static_cast<uint32_t>(cs.weights.rows()),
+                        static_cast<uint32_t>(cs.weights.cols()),
+                        0};
+    append(fileImage, &ch, sizeof(ch));
+
+    for (const EMatrix *m : {&cs.weights, &cs.targetWeights, &cs.momentum, &cs.rms}) {
+      assert(m->rows() == cs.weights.rows() && m->cols() == cs.weights.cols());
+      append(fileImage, m->data(), m->size() * sizeof(float));
+    }
+  }
+
+  append(fileImage, staging.priorities.data(), header.numPriorities * sizeof(double));
+  append(fileImage, replayName.data(), replayName.size());
+
+  SealFileImage<FileHeader>(fileImage.data(), fileImage.size());
+  WriteFileAtomically(FILE_KIND, path, fileImage.data(), fileImage.size());
+}
+
+string TrainingCheckpointer::trainingPath(void) const { return directory + "/training.ckpt"; }
+
+string TrainingCheckpointer::replayPath(unsigned iteration) const {
+  return directory + "/replay-" + to_string(iteration) + ".store";
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../common/Common.hpp"
+#include "../common/Semaphore.hpp"
+#include "../rnn/NetworkTrainer.hpp"
+#include "ExperienceMemory.hpp"
+#include "LearningAgent.hpp"
+#include "ReplayStore.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace learning {
+
+// Checkpoints training into a directory, so that an interrupted run can resume where it left off.
+// A checkpoint holds the learning and target weights, the Adam moments, the learn iteration and
+// the steps since the last target update, and optionally the replay memory and its priorities.
+//
+// Save copies all of that into a staging snapshot on the learner's thread, which costs about as
+// much as a learn step, then a writer thread writes the snapshot out while learning carries on.
+// Every file is written beside its final name, flushed to disk and renamed into place, the
+// training file last. It names the replay file that goes with it, so a crash or power loss at any
+// point leaves the previous checkpoint whole.
+class TrainingCheckpointer {
+public:
+  TrainingCheckpointer(const string &directory, LearningAgent *agent, ExperienceMemory *memory,
+                       bool includeReplay);
+
+  // Finishes writing the pending checkpoint, if there is one.
+  ~TrainingCheckpointer();
+
+  TrainingCheckpointer(const TrainingCheckpointer &other) = delete;
+  TrainingCheckpointer &operator=(const TrainingCheckpointer &other) = delete;
+
+  // Checkpoints the state after the given number of learn iterations. Must be called from the
+  // learning thread, between learn steps. Does nothing and returns false if the previous checkpoint
+  // is still being written, rather than wait for it.
+  bool Save(unsigned iteration);
+
+  // Restores the agent and memory from the checkpoint in the directory, if there is one, and
+  // returns the iteration it was saved after. Must be called before training starts.
+  bool Restore(unsigned &outIteration);
+
+private:
+  struct Snapshot {
+    uint32_t iteration = 0;
+    uint32_t itersSinceTargetUpdated = 0;
+    vector<rnn::TrainerConnectionState> trainer;
+
+    uptr<ReplayStore> replay; // null unless the replay memory is checkpointed.
+    vector<double> priorities;
+    double maxPriority = 0.0;
+  };
+
+  string directory;
+  LearningAgent *agent;
+  ExperienceMemory *memory;
+
+  Snapshot staging;
+  vector<uint8_t> fileImage;
+  string lastReplayPath; // of the last complete checkpoint, deleted once superseded.
+
+  atomic<bool> writing;
+  atomic<bool> stopping;
+  Semaphore pending;
+  std::thread writer;
+
+  void write(void);
+  void writeReplay(const string &path);
+  void writeTraining(const string &path, const string &replayPath);
+
+  string trainingPath(void) const;
+  string replayPath(unsigned iteration) const;
+};
+}
@@ -58,7 +58,7 @@ int main(int argc, char **argv) {
     iter++;
     pair<vector<ColorRGB>, vector<ColorRGB>> eyeView = world->GetCar()->EyeView(world->GetTrack());
     // State observedState(eyeView.first, eyeView.second);
-    Vector2 nextWaypoint = world->GetTrack()->NextWaypoint(world->GetCar()->GetPos());
+    Vector2 nextWaypoint = world->NextWaypoint();
     Vector2 toNextWaypoint = (nextWaypoint - world->GetCar()->GetPos()).normalised();
 
     State observedState(eyeView.first, eyeView.second,
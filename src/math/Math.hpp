@@ -22,6 +22,14 @@ static inline MatrixView GetMatrixView(EMatrix &m) {
   return result;
 }
 
+static inline MatrixView GetMatrixView(Eigen::Map<EMatrix> &m) {
+  MatrixView result;
+  result.rows = m.rows();
+  result.cols = m.cols();
+  result.data = m.data();
+  return result;
+}
+
 static inline float Deg2Rad(float degs) { return degs * static_cast<float>(M_PI) / 180.0f; }
 
 // Returns a uniformly distributed random number between 0 and 1.
@@ -0,0 +1,654 @@
+#include "CpuTrainer.hpp"
+#include "../common/Common.hpp"
+#include "../common/WorkerPool.hpp"
+#include "Activations.hpp"
+#include "Layer.hpp"
+#include "TrainerConstants.hpp"
+#include <algorithm>
+#include <cassert>
+#include <thread>
+#include <utility>
+
+using namespace rnn;
+
+// The batch is split into blocks of at least this many rows, one per thread, as each row goes
+// through the forward and backward passes independently of the others. Smaller blocks would
+// leave the products too thin to run efficiently.
+static constexpr unsigned MIN_BLOCK_ROWS = 8;
+
+// Each connection's gradient and Adam update is split into blocks of this many of its rows, so
+// that the largest connection does not hold up the rest.
+static constexpr unsigned GRADIENT_BLOCK_ROWS = 32;
+
+struct CpuConnectionMemory {
+  LayerConnection connection;
+  bool haveActivation;
+
+  // Batch output, row per batch element. The last column is the bias and is always 1.
+  EMatrix activation;
+  EMatrix derivative;
+
+  CpuConnectionMemory(const LayerConnection &connection, unsigned rows, unsigned cols)
+      : connection(connection), haveActivation(false), activation(rows, cols),
+        derivative(rows, cols) {
+    activation.fill(0.0f);
+    activation.rightCols(1).fill(1.0f);
+    derivative.fill(0.0f);
+  }
+};
+
+struct CpuTimeSlice {
+  EMatrix networkOutput;
+  vector<CpuConnectionMemory> connectionData;
+
+  CpuTimeSlice(const RNNSpec &spec) : networkOutput(spec.maxBatchSize, spec.numOutputs) {
+    networkOutput.fill(0.0f);
+
+    for (const auto &connection : spec.connections) {
+      unsigned connectionCols = spec.LayerSize(connection.srcLayerId) + 1;
+      connectionData.emplace_back(connection, spec.maxBatchSize, connectionCols);
+    }
+  }
+
+  CpuConnectionMemory *GetConnectionData(const LayerConnection &connection) {
+    for (auto &cmd : connectionData) {
+      if (cmd.connection == connection) {
+        return &cmd;
+      }
+    }
+
+    assert(false);
+    return nullptr;
+  }
+};
+
+// All of the forward pass memory for a trace. The target and learning networks each have their own
+// so that both forward passes can run in the same task.
+struct CpuTraceMemory {
+  vector<CpuTimeSlice> slices;
+
+  // Per layer scratch space for the incoming sums / activations and derivatives.
+  vector<EMatrix> layerActivation;
+  vector<EMatrix> layerDerivative;
+
+  CpuTraceMemory(const RNNSpec &spec) {
+    slices.reserve(spec.maxTraceLength);
+    for (unsigned i = 0; i < spec.maxTraceLength; i++) {
+      slices.emplace_back(spec);
+    }
+
+    for (const auto &ls : spec.layers) {
+      layerActivation.emplace_back(spec.maxBatchSize, ls.numNodes);
+      layerDerivative.emplace_back(spec.maxBatchSize, ls.numNodes);
+    }
+  }
+
+  void Clear(unsigned traceLength) {
+    for (unsigned i = 0; i < traceLength; i++) {
+      for (auto &cd : slices[i].connectionData) {
+        cd.haveActivation = false;
+      }
+    }
+  }
+};
+
+struct CpuLayerAccum {
+  EMatrix accumDelta;
+
+  CpuLayerAccum(unsigned rows, unsigned cols) : accumDelta(rows, cols) { accumDelta.fill(0.0f); }
+};
+
+// A range of the batch's rows, which a single task takes through the target and learning forward
+// passes and back propagation.
+struct CpuRowBlock {
+  unsigned start;
+  unsigned rows;
+
+  // The number of deltas summed into each layer's accumulator, indexed by [timestamp][layer
+  // index]. The same for every block, but each keeps its own count so that none are shared.
+  vector<vector<unsigned>> deltaSamples;
+};
+
+// Part of a connection's gradient and Adam update, covering some of the rows of its weights.
+struct CpuGradientBlock {
+  unsigned connection; // index into the connection states.
+  unsigned start;
+  unsigned rows;
+};
+
+struct CpuConnectionState {
+  LayerConnection connection;
+
+  EMatrix accumGradient;
+
+  EMatrix momentum;
+  EMatrix rms;
+
+  CpuConnectionState(const LayerConnection &connection, unsigned rows, unsigned cols)
+      : connection(connection), accumGradient(rows, cols), momentum(rows, cols),
+        rms(rows, cols) {
+    accumGradient.fill(0.0f);
+    momentum.fill(0.0f);
+    rms.fill(0.0f);
+  }
+};
+
+static void applyActivation(LayerActivation func, Eigen::Ref<EMatrix> values,
+                            Eigen::Ref<EMatrix> derivatives) {
+  switch (func) {
+  case LayerActivation::TANH:
+    values = values.array().tanh().matrix();
+    derivatives = (1.0f - values.array().square()).matrix();
+    return;
+  case LayerActivation::LINEAR:
+    derivatives.fill(1.0f);
+    return;
+  case LayerActivation::SOFTMAX:
+    for (int r = 0; r < values.rows(); r++) {
+      float maxVal = values.row(r).maxCoeff();
+      values.row(r) = (values.row(r).array() - maxVal).exp().matrix();
+      values.row(r) /= values.row(r).sum();
+    }
+    derivatives.fill(1.0f);
+    return;
+  default:
+    for (int r = 0; r < values.rows(); r++) {
+      for (int c = 0; c < values.cols(); c++) {
+        float in = values(r, c);
+        values(r, c) = ActivationValue(func, in);
+        derivatives(r, c) = ActivationDerivative(func, in, values(r, c));
+      }
+    }
+    return;
+  }
+}
+
+static EMatrix *findWeights(vector<Layer> &layers, const LayerConnection &connection) {
+  for (auto &layer : layers) {
+    if (layer.layerId != connection.dstLayerId) {
+      continue;
+    }
+
+    for (auto &w : layer.weights) {
+      if (w.first == connection) {
+        return &w.second;
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+struct CpuTrainer::CpuTrainerImpl {
+  RNNSpec spec;
+  WorkerPool workers;
+
+  vector<Layer> learningLayers;
+  vector<Layer> targetLayers;
+
+  CpuTraceMemory learningMemory;
+  CpuTraceMemory targetMemory;
+
+  vector<vector<SliceBatch>> staging; // indexed by [buffer][timestamp]
+  vector<EMatrix> traceTargets;
+  EVector traceErrors;
+  vector<vector<CpuLayerAccum>> deltaAccum; // indexed by [timestamp][layer index]
+  vector<CpuConnectionState> connectionState;
+
+  vector<CpuRowBlock> rowBlocks;
+  vector<CpuGradientBlock> gradientBlocks;
+
+  unsigned curBatchSize;
+  unsigned curTraceLength;
+  float curLearnRate;
+
+  CpuTrainerImpl(const RNNSpec &spec)
+      : spec(spec), workers(std::max(1u, std::thread::hardware_concurrency())),
+        learningMemory(spec), targetMemory(spec) {
+    assert(spec.maxTraceLength > 0);
+
+    for (const auto &layerSpec : spec.layers) {
+      learningLayers.emplace_back(spec, layerSpec);
+      targetLayers.emplace_back(spec, layerSpec);
+    }
+
+    traceErrors = EVector::Zero(spec.maxBatchSize);
+    staging.resize(NUM_STAGING_BUFFERS);
+    for (unsigned i = 0; i < spec.maxTraceLength; i++) {
+      for (auto &buffer : staging) {
+        buffer.emplace_back(spec.maxBatchSize, spec.numInputs, spec.numOutputs);
+      }
+      traceTargets.emplace_back(spec.maxBatchSize, spec.numOutputs);
+
+      deltaAccum.emplace_back();
+      for (const auto &layerSpec : spec.layers) {
+        deltaAccum.back().emplace_back(spec.maxBatchSize, layerSpec.numNodes);
+      }
+    }
+
+    for (const auto &connection : spec.connections) {
+      unsigned inputSize = spec.LayerSize(connection.srcLayerId) + 1;
+      unsigned layerSize = spec.LayerSize(connection.dstLayerId);
+      connectionState.emplace_back(connection, layerSize, inputSize);
+
+      unsigned connectionIndex = connectionState.size() - 1;
+      for (unsigned start = 0; start < layerSize; start += GRADIENT_BLOCK_ROWS) {
+        unsigned rows = std::min(GRADIENT_BLOCK_ROWS, layerSize - start);
+        gradientBlocks.push_back(CpuGradientBlock{connectionIndex, start, rows});
+      }
+    }
+
+    UpdateTarget();
+  }
+
+  void SetWeights(const vector<pair<LayerConnection, math::MatrixView>> &inWeights) {
+    for (const auto &w : inWeights) {
+      EMatrix *weights = findWeights(learningLayers, w.first);
+      assert(weights != nullptr);
+      assert(weights->rows() == w.second.rows && weights->cols() == w.second.cols);
+
+      *weights = Eigen::Map<EMatrix>(w.second.data, w.second.rows, w.second.cols);
+    }
+
+    UpdateTarget();
+  }
+
+  void GetWeights(vector<pair<LayerConnection, math::MatrixView>> &outWeights) {
+    for (auto &w : outWeights) {
+      EMatrix *weights = findWeights(learningLayers, w.first);
+      assert(weights != nullptr);
+      assert(weights->rows() == w.second.rows && weights->cols() == w.second.cols);
+
+      Eigen::Map<EMatrix>(w.second.data, w.second.rows, w.second.cols) = *weights;
+    }
+  }
+
+  void UpdateTarget(void) {
+    assert(targetLayers.size() == learningLayers.size());
+    for (unsigned i = 0; i < targetLayers.size(); i++) {
+      assert(targetLayers[i].weights.size() == learningLayers[i].weights.size());
+      for (unsigned j = 0; j < targetLayers[i].weights.size(); j++) {
+        assert(targetLayers[i].weights[j].first == learningLayers[i].weights[j].first);
+        targetLayers[i].weights[j].second = learningLayers[i].weights[j].second;
+      }
+    }
+  }
+
+  void GetState(vector<TrainerConnectionState> &outState) {
+    outState.resize(connectionState.size());
+    for (unsigned i = 0; i < connectionState.size(); i++) {
+      const CpuConnectionState &cs = connectionState[i];
+      TrainerConnectionState &out = outState[i];
+
+      out.connection = cs.connection;
+      out.weights = *findWeights(learningLayers, cs.connection);
+      out.targetWeights = *findWeights(targetLayers, cs.connection);
+      out.momentum = cs.momentum;
+      out.rms = cs.rms;
+    }
+  }
+
+  void SetState(const vector<TrainerConnectionState> &state) {
+    assert(state.size() == connectionState.size());
+    for (const auto &in : state) {
+      CpuConnectionState *cs = findConnectionState(in.connection);
+      EMatrix *weights = findWeights(learningLayers, in.connection);
+      EMatrix *targetWeights = findWeights(targetLayers, in.connection);
+      assert(cs != nullptr && weights != nullptr && targetWeights != nullptr);
+      assert(weights->rows() == in.weights.rows() && weights->cols() == in.weights.cols());
+
+      *weights = in.weights;
+      *targetWeights = in.targetWeights;
+      cs->momentum = in.momentum;
+      cs->rms = in.rms;
+    }
+  }
+
+  void Train(const vector<SliceBatch> &trace, float learnRate) {
+    assert(!trace.empty());
+    for (const auto &slice : trace) {
+      assert(slice.batchInput.rows() == trace.front().batchInput.rows());
+    }
+    train(trace, trace.front().batchInput.rows(), trace.size(), learnRate);
+  }
+
+  void TrainStaged(unsigned buffer, unsigned batchSize, unsigned traceLength, float learnRate) {
+    assert(buffer < staging.size());
+    train(staging[buffer], batchSize, traceLength, learnRate);
+  }
+
+  // Trains on the first batchSize rows of the first traceLength slices of trace.
+  void train(const vector<SliceBatch> &trace, unsigned batchSize, unsigned traceLength,
+             float learnRate) {
+    assert(traceLength > 0 && traceLength <= spec.maxTraceLength);
+    assert(traceLength <= trace.size());
+
+    curBatchSize = batchSize;
+    curTraceLength = traceLength;
+    curLearnRate = learnRate;
+    assert(curBatchSize > 0 && curBatchSize <= spec.maxBatchSize);
+
+    markActivations(targetMemory);
+    markActivations(learningMemory);
+    splitRows();
+
+    traceErrors.setZero();
+    workers.Run(rowBlocks.size(),
+                [this, &trace](unsigned i) { processRows(trace, rowBlocks[i]); });
+    traceErrors *= 1.0f / static_cast<float>(curTraceLength);
+
+    workers.Run(gradientBlocks.size(),
+                [this](unsigned i) { updateWeights(gradientBlocks[i]); });
+  }
+
+  // Splits the batch into a block of rows per thread, or fewer if the batch is small.
+  void splitRows(void) {
+    unsigned numBlocks = std::min(workers.NumThreads(),
+                                  (curBatchSize + MIN_BLOCK_ROWS - 1) / MIN_BLOCK_ROWS);
+    rowBlocks.resize(numBlocks);
+
+    for (unsigned i = 0; i < numBlocks; i++) {
+      CpuRowBlock &block = rowBlocks[i];
+      block.start = i * curBatchSize / numBlocks;
+      block.rows = (i + 1) * curBatchSize / numBlocks - block.start;
+
+      block.deltaSamples.resize(spec.maxTraceLength);
+      for (auto &samples : block.deltaSamples) {
+        samples.assign(learningLayers.size(), 0);
+      }
+    }
+  }
+
+  // Which connections carry an activation at each step of the trace depends only on the topology,
+  // not on the row, so it is worked out once before the rows are processed in parallel.
+  void markActivations(CpuTraceMemory &memory) {
+    memory.Clear(curTraceLength);
+
+    for (unsigned timestamp = 0; timestamp < curTraceLength; timestamp++) {
+      for (auto &cd : memory.slices[timestamp].connectionData) {
+        if (cd.connection.srcLayerId == 0) {
+          cd.haveActivation = true;
+        }
+      }
+
+      for (const auto &layer : learningLayers) {
+        if (layer.isOutput) {
+          continue;
+        }
+
+        for (const auto &out : layer.outgoing) {
+          unsigned dstTimestamp = timestamp + out.timeOffset;
+          if (dstTimestamp < curTraceLength) {
+            CpuConnectionMemory *outData = memory.slices[dstTimestamp].GetConnectionData(out);
+            assert(outData != nullptr && !outData->haveActivation);
+            outData->haveActivation = true;
+          }
+        }
+      }
+    }
+  }
+
+  // Everything up to the gradients for one block of rows. The target and learning forward passes
+  // only share the (read only) trace and weights.
+  void processRows(const vector<SliceBatch> &trace, CpuRowBlock &block) {
+    for (unsigned i = 0; i < curTraceLength; i++) {
+      forwardProp(targetMemory, targetLayers, trace[i], i, block);
+    }
+    calculateTargets(trace, block);
+
+    clearDeltas(block);
+    for (unsigned i = 0; i < curTraceLength; i++) {
+      forwardProp(learningMemory, learningLayers, trace[i], i, block);
+    }
+
+    for (int i = static_cast<int>(curTraceLength) - 1; i >= 0; i--) {
+      backProp(trace[i], i, block);
+    }
+  }
+
+  void calculateTargets(const vector<SliceBatch> &trace, const CpuRowBlock &block) {
+    for (unsigned i = 0; i < curTraceLength; i++) {
+      const Eigen::Map<EMatrix> &rewards = trace[i].batchRewards;
+      assert(rewards.rows() >= curBatchSize && rewards.cols() == 1);
+
+      EMatrix &targets = traceTargets[i];
+      for (unsigned r = block.start; r < block.start + block.rows; r++) {
+        float target = rewards(r, 0);
+        if (i + 1 < curTraceLength) {
+          float maxQ = targetMemory.slices[i + 1].networkOutput.row(r).maxCoeff();
+          target += TARGET_DISCOUNT_FACTOR * maxQ;
+        }
+        targets.row(r).fill(target);
+      }
+    }
+  }
+
+  void forwardProp(CpuTraceMemory &memory, vector<Layer> &layers, const SliceBatch &batch,
+                   int timestamp, const CpuRowBlock &block) {
+    CpuTimeSlice &slice = memory.slices[timestamp];
+
+    for (auto &cd : slice.connectionData) {
+      if (cd.connection.srcLayerId == 0) {
+        assert(batch.batchInput.rows() >= curBatchSize);
+        cd.activation.block(block.start, 0, block.rows, spec.numInputs) =
+            batch.batchInput.middleRows(block.start, block.rows);
+      }
+    }
+
+    for (unsigned li = 0; li < layers.size(); li++) {
+      const Layer &layer = layers[li];
+      assert(!layer.weights.empty());
+
+      auto activation = memory.layerActivation[li].middleRows(block.start, block.rows);
+      auto derivative = memory.layerDerivative[li].middleRows(block.start, block.rows);
+      activation.setZero();
+
+      for (const auto &in : layer.weights) {
+        if (in.first.timeOffset == 1 && timestamp == 0) {
+          continue;
+        }
+
+        CpuConnectionMemory *inData = slice.GetConnectionData(in.first);
+        assert(inData != nullptr && inData->haveActivation);
+        activation.noalias() +=
+            inData->activation.middleRows(block.start, block.rows) * in.second.transpose();
+      }
+
+      applyActivation(layer.activation, activation, derivative);
+
+      if (layer.isOutput) {
+        slice.networkOutput.middleRows(block.start, block.rows) = activation;
+        continue;
+      }
+
+      for (const auto &out : layer.outgoing) {
+        unsigned dstTimestamp = timestamp + out.timeOffset;
+        if (dstTimestamp >= curTraceLength) {
+          continue;
+        }
+
+        CpuConnectionMemory *outData = memory.slices[dstTimestamp].GetConnectionData(out);
+        assert(outData != nullptr && outData->haveActivation);
+
+        outData->activation.block(block.start, 0, block.rows, layer.numNodes) = activation;
+        outData->derivative.block(block.start, 0, block.rows, layer.numNodes) = derivative;
+      }
+    }
+  }
+
+  void clearDeltas(CpuRowBlock &block) {
+    for (unsigned i = 0; i < curTraceLength; i++) {
+      for (auto &da : deltaAccum[i]) {
+        da.accumDelta.middleRows(block.start, block.rows).setZero();
+      }
+      std::fill(block.deltaSamples[i].begin(), block.deltaSamples[i].end(), 0);
+    }
+  }
+
+  void backProp(const SliceBatch &batch, int timestamp, CpuRowBlock &block) {
+    assert(learningLayers.back().isOutput);
+    unsigned outputIndex = learningLayers.size() - 1;
+
+    assert(block.deltaSamples[timestamp][outputIndex] == 0);
+    block.deltaSamples[timestamp][outputIndex] = 1;
+
+    const EMatrix &networkOutput = learningMemory.slices[timestamp].networkOutput;
+    auto delta = deltaAccum[timestamp][outputIndex].accumDelta.middleRows(block.start, block.rows);
+    delta = batch.batchActions.middleRows(block.start, block.rows)
+                .cwiseProduct(networkOutput.middleRows(block.start, block.rows) -
+                              traceTargets[timestamp].middleRows(block.start, block.rows));
+
+    // Only the action taken has a non-zero error.
+    traceErrors.segment(block.start, block.rows) += delta.rowwise().sum().cwiseAbs();
+    delta.array().colwise() *=
+        batch.batchWeights.middleRows(block.start, block.rows).col(0).array();
+
+    recursiveBackprop(outputIndex, timestamp, block);
+  }
+
+  void recursiveBackprop(unsigned layerIndex, int timestamp, CpuRowBlock &block) {
+    const Layer &layer = learningLayers[layerIndex];
+    unsigned samples = block.deltaSamples[timestamp][layerIndex];
+    auto delta = deltaAccum[timestamp][layerIndex].accumDelta.middleRows(block.start, block.rows);
+
+    assert(samples > 0);
+    if (samples > 1) {
+      delta *= 1.0f / static_cast<float>(samples);
+    }
+
+    CpuTimeSlice &slice = learningMemory.slices[timestamp];
+
+    for (const auto &connection : layer.weights) {
+      if (connection.first.timeOffset == 1 && timestamp == 0) {
+        continue;
+      }
+
+      if (connection.first.srcLayerId != 0) {
+        CpuConnectionMemory *connData = slice.GetConnectionData(connection.first);
+        assert(connData != nullptr && connData->haveActivation);
+
+        int srcTimestamp = timestamp - connection.first.timeOffset;
+        assert(srcTimestamp >= 0);
+
+        unsigned srcIndex = layerIndexOf(connection.first.srcLayerId);
+        unsigned srcNodes = learningLayers[srcIndex].numNodes;
+
+        // The bias column of the weights has no corresponding source node.
+        deltaAccum[srcTimestamp][srcIndex].accumDelta.middleRows(block.start, block.rows) +=
+            (delta * connection.second.leftCols(srcNodes))
+                .cwiseProduct(connData->derivative.block(block.start, 0, block.rows, srcNodes));
+        block.deltaSamples[srcTimestamp][srcIndex]++;
+
+        if (connection.first.timeOffset == 0) {
+          recursiveBackprop(srcIndex, timestamp, block);
+        }
+      }
+    }
+  }
+
+  // The gradient and Adam update of some of a connection's rows. The gradient sums over the whole
+  // batch, so it waits until every row block has been back propagated.
+  void updateWeights(const CpuGradientBlock &gb) {
+    CpuConnectionState &cs = connectionState[gb.connection];
+    const LayerConnection &connection = cs.connection;
+    unsigned dstIndex = layerIndexOf(connection.dstLayerId);
+
+    auto gradient = cs.accumGradient.middleRows(gb.start, gb.rows);
+    gradient.setZero();
+    unsigned samples = 0;
+
+    for (unsigned timestamp = 0; timestamp < curTraceLength; timestamp++) {
+      if (connection.timeOffset == 1 && timestamp == 0) {
+        continue;
+      }
+
+      CpuConnectionMemory *connData =
+          learningMemory.slices[timestamp].GetConnectionData(connection);
+      assert(connData != nullptr && connData->haveActivation);
+
+      const CpuLayerAccum &layerDelta = deltaAccum[timestamp][dstIndex];
+      gradient.noalias() +=
+          layerDelta.accumDelta.block(0, gb.start, curBatchSize, gb.rows).transpose() *
+          connData->activation.topRows(curBatchSize);
+      samples++;
+    }
+
+    // Only possible for a recurrent connection with a trace of length 1.
+    if (samples == 0) {
+      return;
+    }
+
+    gradient *= 1.0f / static_cast<float>(curBatchSize * samples);
+
+    auto momentum = cs.momentum.middleRows(gb.start, gb.rows);
+    auto rms = cs.rms.middleRows(gb.start, gb.rows);
+    momentum = momentum * ADAM_BETA1 + gradient * (1.0f - ADAM_BETA1);
+    rms = rms * ADAM_BETA2 + gradient.cwiseAbs2() * (1.0f - ADAM_BETA2);
+
+    EMatrix *weights = findWeights(learningLayers, connection);
+    assert(weights != nullptr);
+
+    float lr = ADAM_LR * curLearnRate;
+    weights->middleRows(gb.start, gb.rows).array() -=
+        lr * (momentum.array() / (1.0f - ADAM_BETA1)) /
+        (rms.array() / (1.0f - ADAM_BETA2) + ADAM_EPSILON).sqrt();
+  }
+
+  CpuConnectionState *findConnectionState(const LayerConnection &connection) {
+    for (auto &cs : connectionState) {
+      if (cs.connection == connection) {
+        return &cs;
+      }
+    }
+    return nullptr;
+  }
+
+  unsigned layerIndexOf(unsigned layerId) const {
+    for (unsigned i = 0; i < learningLayers.size(); i++) {
+      if (learningLayers[i].layerId == layerId) {
+        return i;
+      }
+    }
+
+    assert(false);
+    return 0;
+  }
+};
+
+CpuTrainer::CpuTrainer(const RNNSpec &spec) : impl(new CpuTrainerImpl(spec)) {}
+
+CpuTrainer::~CpuTrainer() = default;
+
+void CpuTrainer::SetWeights(const vector<pair<LayerConnection, math::MatrixView>> &weights) {
+  impl->SetWeights(weights);
+}
+
+void CpuTrainer::GetWeights(vector<pair<LayerConnection, math::MatrixView>> &outWeights) {
+  impl->GetWeights(outWeights);
+}
+
+void CpuTrainer::UpdateTarget(void) { impl->UpdateTarget(); }
+
+void CpuTrainer::GetState(vector<TrainerConnectionState> &outState) {
+  impl->GetState(outState);
+}
+
+void CpuTrainer::SetState(const vector<TrainerConnectionState> &state) {
+  impl->SetState(state);
+}
+
+void CpuTrainer::Train(const vector<SliceBatch> &trace, float learnRate) {
+  impl->Train(trace, learnRate);
+}
+
+vector<SliceBatch> &CpuTrainer::Staging(unsigned buffer) {
+  assert(buffer < impl->staging.size());
+  return impl->staging[buffer];
+}
+
+void CpuTrainer::TrainStaged(unsigned buffer, unsigned batchSize, unsigned traceLength,
+                             float learnRate) {
+  impl->TrainStaged(buffer, batchSize, traceLength, learnRate);
+}
+
+const EVector &CpuTrainer::TraceErrors(void) const { return impl->traceErrors; }
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../common/Common.hpp"
+#include "../math/Math.hpp"
+#include "NetworkTrainer.hpp"
+#include "RNNSpec.hpp"
+#include "SliceBatch.hpp"
+#include <utility>
+
+namespace rnn {
+
+// Host implementation of the CudaTrainer algorithm (target Q values, BPTT and Adam), for machines
+// without a CUDA device. Each training step runs on a persistent pool of threads: the batch is
+// split by rows for the forward passes and back propagation, then the gradient and Adam update of
+// every connection is split by rows of its weights.
+class CpuTrainer : public NetworkTrainer {
+public:
+  CpuTrainer(const RNNSpec &spec);
+  virtual ~CpuTrainer();
+
+  void SetWeights(const vector<pair<LayerConnection, math::MatrixView>> &weights) override;
+  void GetWeights(vector<pair<LayerConnection, math::MatrixView>> &outWeights) override;
+  void UpdateTarget(void) override;
+
+  void GetState(vector<TrainerConnectionState> &outState) override;
+  void SetState(const vector<TrainerConnectionState> &state) override;
+
+  void Train(const vector<SliceBatch> &trace, float learnRate) override;
+
+  vector<SliceBatch> &Staging(unsigned buffer) override;
+  void TrainStaged(unsigned buffer, unsigned batchSize, unsigned traceLength,
+                   float learnRate) override;
+  const EVector &TraceErrors(void) const override;
+
+private:
+  struct CpuTrainerImpl;
+  uptr<CpuTrainerImpl> impl;
+};
+}
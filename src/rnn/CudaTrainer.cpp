@@ -1,70 +1,94 @@
 
 #include "CudaTrainer.hpp"
 #include "../common/Common.hpp"
-#include "../common/Semaphore.hpp"
 #include "../math/MatrixView.hpp"
+#include "TrainerConstants.hpp"
 #include "cuda/CuAdamState.hpp"
 #include "cuda/CuDeltaAccum.hpp"
 #include "cuda/CuGradientAccum.hpp"
 #include "cuda/CuLayer.hpp"
 #include "cuda/CuLayerMemory.hpp"
+#include "cuda/HostTaskExecutor.hpp"
 #include "cuda/TaskExecutor.hpp"
+#include "cuda/TaskScheduler.hpp"
 #include "cuda/Util.hpp"
 #include <cassert>
-#include <condition_variable>
+#include <cstdlib>
 #include <cstring>
-#include <mutex>
-#include <thread>
 #include <utility>
 
 using namespace rnn;
 using namespace rnn::cuda;
 
-constexpr float ADAM_BETA1 = 0.9f;
-constexpr float ADAM_BETA2 = 0.999f;
-constexpr float ADAM_LR = 0.001f;
-constexpr float ADAM_EPSILON = 10e-8;
-
-enum class TrainTask {
-  NONE,
-  EXIT,
-  CLEAR_FORWARDPROP_BUFFERS,
-  CLEAR_BACKPROP_BUFFERS,
-  CALCULATE_TARGETS,
-  FORWARDPROP,
-  BACKPROP_DELTA,
-  COMPUTE_AND_UPDATE_GRADIENTS,
+static constexpr unsigned NUM_TRAIN_WORKERS = 4;
+
+// Where each executor's buffers live. The device executor copies between device memory and page
+// locked host memory. The host executor's "device" memory is ordinary host memory, so its staging
+// buffers need no pinning.
+template <typename Executor> struct ExecutorMemory;
+
+template <> struct ExecutorMemory<TaskExecutor> {
+  static MatrixAllocator Allocator(void) {
+    return MatrixAllocator{util::AllocMatrix, util::FreeMatrix};
+  }
+
+  static void *AllocPinned(size_t bufSize) { return util::AllocPinned(bufSize); }
+  static void FreePinned(void *buf) { util::FreePinned(buf); }
 };
 
+template <> struct ExecutorMemory<HostTaskExecutor> {
+  static MatrixAllocator Allocator(void) {
+    return MatrixAllocator{host::AllocMatrix, host::FreeMatrix};
+  }
+
+  static void *AllocPinned(size_t bufSize) { return malloc(bufSize); }
+  static void FreePinned(void *buf) { free(buf); }
+};
+
+// Views of one staging slice, which the host to device copies read from, and the buffer that the
+// output layer deltas are copied back into. All of them are in the staging buffer's pinned block.
 struct SliceStaging {
   math::MatrixView input;
   math::MatrixView actions;
   math::MatrixView rewards;
+  math::MatrixView weights;
+  math::MatrixView outputDelta;
+
+  SliceStaging(SliceBatch &slice, float *outputDeltaBuffer)
+      : input(math::GetMatrixView(slice.batchInput)),
+        actions(math::GetMatrixView(slice.batchActions)),
+        rewards(math::GetMatrixView(slice.batchRewards)),
+        weights(math::GetMatrixView(slice.batchWeights)) {
+    outputDelta.rows = actions.rows;
+    outputDelta.cols = actions.cols;
+    outputDelta.data = outputDeltaBuffer;
+  }
+};
 
-  SliceStaging(const RNNSpec &spec) {
-    input.rows = spec.maxBatchSize;
-    input.cols = spec.numInputs;
-    input.data = (float *)util::AllocPinned(input.rows * input.cols * sizeof(float));
+// The interface to the trainer's implementation, which runs its tasks on either executor.
+struct CudaTrainer::CudaTrainerImpl {
+  vector<vector<SliceBatch>> staging; // indexed by [buffer][timestamp]
+  EVector traceErrors;
 
-    actions.rows = spec.maxBatchSize;
-    actions.cols = spec.numOutputs;
-    actions.data = (float *)util::AllocPinned(actions.rows * actions.cols * sizeof(float));
+  virtual ~CudaTrainerImpl() = default;
 
-    rewards.rows = spec.maxBatchSize;
-    rewards.cols = 1;
-    rewards.data = (float *)util::AllocPinned(rewards.rows * rewards.cols * sizeof(float));
-  }
+  virtual void SetWeights(const vector<pair<LayerConnection, math::MatrixView>> &inWeights) = 0;
+  virtual void GetWeights(vector<pair<LayerConnection, math::MatrixView>> &outWeights) = 0;
+  virtual void UpdateTarget(void) = 0;
 
-  void Cleanup(void) {
-    util::FreePinned(input.data);
-    util::FreePinned(actions.data);
-    util::FreePinned(rewards.data);
-  }
+  virtual void GetState(vector<TrainerConnectionState> &outState) = 0;
+  virtual void SetState(const vector<TrainerConnectionState> &state) = 0;
+
+  virtual void Train(const vector<SliceBatch> &trace, float learnRate) = 0;
+  virtual void TrainStaged(unsigned buffer, unsigned batchSize, unsigned traceLength,
+                           float learnRate) = 0;
 };
 
-struct CudaTrainer::CudaTrainerImpl {
+template <typename Executor>
+struct CudaTrainer::ExecutorImpl : public CudaTrainer::CudaTrainerImpl {
   RNNSpec spec;
   unsigned maxTraceLength;
+  MatrixAllocator allocator;
 
   vector<CuLayer> learningLayers;
   vector<CuLayer> targetLayers;
@@ -72,91 +96,123 @@ struct CudaTrainer::CudaTrainerImpl {
   CuDeltaAccum deltaAccum;
   CuGradientAccum gradientAccum;
   CuLayerMemory layerMemory;
+  CuLayerMemory targetMemory; // the target network's activations, so both passes can overlap.
   CuAdamState adamState;
 
-  TaskExecutor defaultExecutor;
-  vector<SliceStaging> inputOutputStaging;
+  Executor defaultExecutor;
+  vector<float *> stagingBlocks; // one pinned block per staging buffer.
+  vector<vector<SliceStaging>> inputOutputStaging; // views of staging.
   vector<TargetOutput> traceTargets;
 
-  mutex m; // controls access to tasks for the workers.
-  condition_variable cv;
-  vector<thread> workers;
+  // The work of a training step as a graph per trace length, built on first use. The nodes read
+  // the batch and learn rate from the members below, which are set before each run.
+  TaskScheduler<Executor> scheduler;
+  vector<uptr<TaskGraph<Executor>>> trainGraphs;
 
-  TrainTask currentWorkerTask;
+  vector<SliceStaging> *curStaging; // the staging buffer being trained on.
   unsigned curBatchSize;
   unsigned curTraceLength;
   float curLearnRate;
-  Semaphore taskSem;
-
-  vector<TrainTask> taskList = {
-      TrainTask::CLEAR_FORWARDPROP_BUFFERS,
-      TrainTask::CLEAR_BACKPROP_BUFFERS,
-      TrainTask::CALCULATE_TARGETS,
-      TrainTask::CLEAR_FORWARDPROP_BUFFERS,
-      TrainTask::CLEAR_BACKPROP_BUFFERS,
-      TrainTask::FORWARDPROP,
-      TrainTask::BACKPROP_DELTA,
-      TrainTask::COMPUTE_AND_UPDATE_GRADIENTS,
-  };
-
-  CudaTrainerImpl(const RNNSpec &spec)
-      : spec(spec), maxTraceLength(spec.maxTraceLength), deltaAccum(spec, maxTraceLength),
-        gradientAccum(spec), layerMemory(spec, maxTraceLength), adamState(spec) {
-    assert(maxTraceLength > 0);
 
-    deltaAccum.Clear();
-    gradientAccum.Clear();
-    layerMemory.Clear();
-    adamState.Clear();
+  ExecutorImpl(const RNNSpec &spec)
+      : spec(spec), maxTraceLength(spec.maxTraceLength),
+        allocator(ExecutorMemory<Executor>::Allocator()),
+        deltaAccum(spec, maxTraceLength, allocator), gradientAccum(spec, allocator),
+        layerMemory(spec, maxTraceLength, allocator),
+        targetMemory(spec, maxTraceLength, allocator), adamState(spec, allocator),
+        scheduler(NUM_TRAIN_WORKERS), trainGraphs(maxTraceLength + 1) {
+    assert(maxTraceLength > 0);
 
     for (const auto &layerSpec : spec.layers) {
-      learningLayers.emplace_back(spec, layerSpec);
-      targetLayers.emplace_back(spec, layerSpec);
+      learningLayers.emplace_back(spec, layerSpec, allocator);
+      targetLayers.emplace_back(spec, layerSpec, allocator);
     }
 
+    initialiseBuffers();
     UpdateTarget();
 
+    traceErrors = EVector::Zero(spec.maxBatchSize);
+    staging.resize(NUM_STAGING_BUFFERS);
+    inputOutputStaging.resize(NUM_STAGING_BUFFERS);
+
+    // Each staging buffer's slices and output deltas are carved out of one pinned block.
+    size_t sliceSize = SliceBatch::BufferSize(spec.maxBatchSize, spec.numInputs, spec.numOutputs);
+    size_t deltaSize = spec.maxBatchSize * spec.numOutputs;
+    for (unsigned b = 0; b < NUM_STAGING_BUFFERS; b++) {
+      float *block = static_cast<float *>(ExecutorMemory<Executor>::AllocPinned(
+          maxTraceLength * (sliceSize + deltaSize) * sizeof(float)));
+      stagingBlocks.push_back(block);
+
+      staging[b].reserve(maxTraceLength);
+      for (unsigned i = 0; i < maxTraceLength; i++) {
+        float *sliceBuffer = block + i * (sliceSize + deltaSize);
+        staging[b].emplace_back(spec.maxBatchSize, spec.numInputs, spec.numOutputs, sliceBuffer);
+        inputOutputStaging[b].emplace_back(staging[b].back(), sliceBuffer + sliceSize);
+      }
+    }
+    curStaging = &inputOutputStaging[0];
+
     for (unsigned i = 0; i < maxTraceLength; i++) {
-      inputOutputStaging.emplace_back(spec);
       traceTargets.emplace_back(spec.maxBatchSize,
-                                util::AllocMatrix(spec.maxBatchSize, spec.numOutputs));
+                                allocator.allocMatrix(spec.maxBatchSize, spec.numOutputs));
     }
-
-    createWorkers(4);
   }
 
-  ~CudaTrainerImpl() {
-    currentWorkerTask = TrainTask::EXIT;
-    cv.notify_all();
-    for (auto &w : workers) {
-      w.join();
-    }
-
+  ~ExecutorImpl() {
     for (auto &layer : targetLayers) {
-      layer.Cleanup();
+      layer.Cleanup(allocator);
     }
 
     for (auto &layer : learningLayers) {
-      layer.Cleanup();
+      layer.Cleanup(allocator);
     }
 
-    deltaAccum.Cleanup();
-    gradientAccum.Cleanup();
-    layerMemory.Cleanup();
-    adamState.Cleanup();
+    deltaAccum.Cleanup(allocator);
+    gradientAccum.Cleanup(allocator);
+    layerMemory.Cleanup(allocator);
+    targetMemory.Cleanup(allocator);
+    adamState.Cleanup(allocator);
 
-    for (auto &staging : inputOutputStaging) {
-      staging.Cleanup();
+    for (float *block : stagingBlocks) {
+      ExecutorMemory<Executor>::FreePinned(block);
     }
 
     for (auto &tt : traceTargets) {
-      util::FreeMatrix(tt.value);
+      allocator.freeMatrix(tt.value);
+    }
+  }
+
+  // Device memory starts out uninitialised. The last column of each connection's activation is the
+  // bias input, which is set to 1 here and left alone by every later clear.
+  void initialiseBuffers(void) {
+    for (unsigned t = 0; t < maxTraceLength; t++) {
+      for (CuLayerMemory *memory : {&layerMemory, &targetMemory}) {
+        clearForwardBuffers(defaultExecutor, *memory, t);
+
+        for (auto &cd : memory->GetTimeSlice(t)->connectionData) {
+          CuMatrix bias = cd.activation;
+          bias.data += bias.cols - 1;
+          bias.cols = 1;
+          defaultExecutor.Execute(Task::FillMatrix(bias, 1.0f));
+        }
+      }
+
+      clearDeltaBuffers(defaultExecutor, t);
+    }
+
+    for (unsigned ci = 0; ci < spec.connections.size(); ci++) {
+      clearGradientBuffer(defaultExecutor, ci);
+    }
+
+    for (auto &adam : adamState.allConnections) {
+      defaultExecutor.Execute(Task::FillMatrix(adam.momentum, 0.0f));
+      defaultExecutor.Execute(Task::FillMatrix(adam.rms, 0.0f));
     }
   }
 
   // TODO: SetWeights and GetWeights can share a whole bunch of code in a separate function, instead
   // of the current copy-paste.
-  void SetWeights(const vector<pair<LayerConnection, math::MatrixView>> &inWeights) {
+  void SetWeights(const vector<pair<LayerConnection, math::MatrixView>> &inWeights) override {
     // Don't care about speed here really, so we can skip staging memory.
     for (const auto &w : inWeights) {
       CuLayer *layer = findLayer(w.first.dstLayerId);
@@ -180,7 +236,7 @@ struct CudaTrainer::CudaTrainerImpl {
     UpdateTarget();
   }
 
-  void GetWeights(vector<pair<LayerConnection, math::MatrixView>> &outWeights) {
+  void GetWeights(vector<pair<LayerConnection, math::MatrixView>> &outWeights) override {
     // Don't care about speed here really, so we can skip staging memory.
     for (const auto &w : outWeights) {
       CuLayer *layer = findLayer(w.first.dstLayerId);
@@ -201,7 +257,55 @@ struct CudaTrainer::CudaTrainerImpl {
     }
   }
 
-  void UpdateTarget(void) {
+  void GetState(vector<TrainerConnectionState> &outState) override {
+    outState.resize(adamState.allConnections.size());
+    for (unsigned i = 0; i < adamState.allConnections.size(); i++) {
+      CuAdamConnection &adam = adamState.allConnections[i];
+      const LayerConnection &c = adam.connection;
+      CuWeights *weights = findLayer(learningLayers, c.dstLayerId)->GetWeights(c);
+      CuWeights *targetWeights = findLayer(targetLayers, c.dstLayerId)->GetWeights(c);
+
+      TrainerConnectionState &out = outState[i];
+      out.connection = c;
+      copyToHost(weights->weights, out.weights);
+      copyToHost(targetWeights->weights, out.targetWeights);
+      copyToHost(adam.momentum, out.momentum);
+      copyToHost(adam.rms, out.rms);
+    }
+    defaultExecutor.Synchronize();
+  }
+
+  void SetState(const vector<TrainerConnectionState> &state) override {
+    assert(state.size() == adamState.allConnections.size());
+    for (const auto &in : state) {
+      const LayerConnection &c = in.connection;
+      CuAdamConnection *adam = adamState.GetConnection(c);
+      CuWeights *weights = findLayer(learningLayers, c.dstLayerId)->GetWeights(c);
+      CuWeights *targetWeights = findLayer(targetLayers, c.dstLayerId)->GetWeights(c);
+
+      copyToDevice(in.weights, weights->weights);
+      defaultExecutor.Execute(Task::TransposeMatrix(weights->weights, weights->weightsT));
+      copyToDevice(in.targetWeights, targetWeights->weights);
+      copyToDevice(in.momentum, adam->momentum);
+      copyToDevice(in.rms, adam->rms);
+    }
+    defaultExecutor.Synchronize();
+  }
+
+  void copyToHost(const CuMatrix &src, EMatrix &dst) {
+    dst.resize(src.rows, src.cols);
+    defaultExecutor.Execute(Task::CopyMatrixD2H(src, math::GetMatrixView(dst)));
+  }
+
+  void copyToDevice(const EMatrix &src, const CuMatrix &dst) {
+    assert(src.rows() == static_cast<int>(dst.rows) && src.cols() == static_cast<int>(dst.cols));
+
+    // The copy only reads the host matrix.
+    math::MatrixView view = math::GetMatrixView(const_cast<EMatrix &>(src));
+    defaultExecutor.Execute(Task::CopyMatrixH2D(view, dst));
+  }
+
+  void UpdateTarget(void) override {
     assert(targetLayers.size() == learningLayers.size());
     for (unsigned i = 0; i < targetLayers.size(); i++) {
       assert(targetLayers[i].incoming.size() == learningLayers[i].incoming.size());
@@ -214,7 +318,7 @@ struct CudaTrainer::CudaTrainerImpl {
     }
   }
 
-  void Train(const vector<SliceBatch> &trace, float learnRate) {
+  void Train(const vector<SliceBatch> &trace, float learnRate) override {
     assert(trace.size() <= maxTraceLength);
     assert(!trace.empty());
 
@@ -225,344 +329,366 @@ struct CudaTrainer::CudaTrainerImpl {
     // }
     // getchar();
 
-    {
-      std::lock_guard<std::mutex> lk(m);
-      curBatchSize = trace.front().batchInput.rows();
-      curTraceLength = trace.size();
-      curLearnRate = learnRate;
-    }
-
-    pushTraceToStaging(trace);
+    pushTraceToStaging(trace, inputOutputStaging[0]);
+    TrainStaged(0, trace.front().batchInput.rows(), trace.size(), learnRate);
+  }
 
-    for (TrainTask task : taskList) {
-      {
-        std::lock_guard<std::mutex> lk(m);
-        currentWorkerTask = task;
-      }
+  void TrainStaged(unsigned buffer, unsigned batchSize, unsigned traceLength,
+                   float learnRate) override {
+    assert(buffer < inputOutputStaging.size());
+    assert(traceLength > 0 && traceLength <= maxTraceLength);
+    assert(batchSize > 0 && batchSize <= spec.maxBatchSize);
 
-      cv.notify_all();
+    curStaging = &inputOutputStaging[buffer];
+    curBatchSize = batchSize;
+    curTraceLength = traceLength;
+    curLearnRate = learnRate;
 
-      for (unsigned i = 0; i < workers.size(); i++) {
-        taskSem.wait();
-      }
-      util::CudaSynchronize();
+    if (trainGraphs[traceLength] == nullptr) {
+      trainGraphs[traceLength] = buildTrainGraph(traceLength);
     }
 
-    {
-      std::lock_guard<std::mutex> lk(m);
-      currentWorkerTask = TrainTask::NONE;
+    // The graph's streams are not ordered with the default one, so anything issued on it, such as
+    // new weights, has to complete first.
+    defaultExecutor.Synchronize();
+    scheduler.Run(*trainGraphs[traceLength]);
+
+    computeTraceErrors();
+  }
+
+  // The output deltas have the importance sampling weights applied, so divide them back out.
+  void computeTraceErrors(void) {
+    traceErrors.setZero();
+    for (unsigned i = 0; i < curTraceLength; i++) {
+      const SliceStaging &ss = (*curStaging)[i];
+      for (unsigned r = 0; r < curBatchSize; r++) {
+        float weight = ss.weights.data[r];
+        if (weight > 0.0f) {
+          float rowDelta = 0.0f;
+          for (unsigned c = 0; c < ss.outputDelta.cols; c++) {
+            rowDelta += ss.outputDelta.data[r * ss.outputDelta.cols + c];
+          }
+          traceErrors(r) += fabsf(rowDelta) / weight;
+        }
+      }
     }
+    traceErrors *= 1.0f / static_cast<float>(curTraceLength);
   }
 
-  void pushTraceToStaging(const vector<SliceBatch> &trace) {
+  void pushTraceToStaging(const vector<SliceBatch> &trace,
+                          vector<SliceStaging> &outStaging) {
     for (unsigned i = 0; i < trace.size(); i++) {
-      assert(trace[i].batchInput.cols() == inputOutputStaging[i].input.cols);
-      assert(trace[i].batchInput.rows() <= inputOutputStaging[i].input.rows);
-      assert(trace[i].batchActions.cols() == inputOutputStaging[i].actions.cols);
-      assert(trace[i].batchActions.rows() <= inputOutputStaging[i].actions.rows);
-      assert(trace[i].batchRewards.cols() == inputOutputStaging[i].rewards.cols);
-      assert(trace[i].batchRewards.rows() <= inputOutputStaging[i].rewards.rows);
+      assert(trace[i].batchInput.cols() == outStaging[i].input.cols);
+      assert(trace[i].batchInput.rows() <= outStaging[i].input.rows);
+      assert(trace[i].batchActions.cols() == outStaging[i].actions.cols);
+      assert(trace[i].batchActions.rows() <= outStaging[i].actions.rows);
+      assert(trace[i].batchRewards.cols() == outStaging[i].rewards.cols);
+      assert(trace[i].batchRewards.rows() <= outStaging[i].rewards.rows);
 
       size_t inputSize = trace[i].batchInput.rows() * trace[i].batchInput.cols() * sizeof(float);
-      memcpy(inputOutputStaging[i].input.data, trace[i].batchInput.data(), inputSize);
+      memcpy(outStaging[i].input.data, trace[i].batchInput.data(), inputSize);
 
       size_t actionsSize =
           trace[i].batchActions.rows() * trace[i].batchActions.cols() * sizeof(float);
-      memcpy(inputOutputStaging[i].actions.data, trace[i].batchActions.data(), actionsSize);
+      memcpy(outStaging[i].actions.data, trace[i].batchActions.data(), actionsSize);
 
       size_t rewardsSize =
           trace[i].batchRewards.rows() * trace[i].batchRewards.cols() * sizeof(float);
-      memcpy(inputOutputStaging[i].rewards.data, trace[i].batchRewards.data(), rewardsSize);
+      memcpy(outStaging[i].rewards.data, trace[i].batchRewards.data(), rewardsSize);
+
+      assert(trace[i].batchWeights.rows() == trace[i].batchRewards.rows());
+      memcpy(outStaging[i].weights.data, trace[i].batchWeights.data(), rewardsSize);
     }
   }
 
-  void createWorkers(unsigned numWorkers) {
-    assert(numWorkers > 0);
-    currentWorkerTask = TrainTask::NONE;
-
-    for (unsigned workerIdx = 0; workerIdx < numWorkers; workerIdx++) {
-      workers.emplace_back([this, workerIdx] {
-        TaskExecutor executor;
-        TrainTask prevTask = TrainTask::NONE;
-
-        while (true) {
-          std::unique_lock<std::mutex> lk(m);
-
-          while (currentWorkerTask == TrainTask::NONE || currentWorkerTask == prevTask) {
-            cv.wait(lk, [this, prevTask]() {
-              return currentWorkerTask != TrainTask::NONE && currentWorkerTask != prevTask;
-            });
-          }
-
-          assert(currentWorkerTask != TrainTask::NONE);
-          prevTask = currentWorkerTask;
-          lk.unlock();
-
-          switch (prevTask) {
-          case TrainTask::EXIT:
-            return;
-          case TrainTask::CLEAR_FORWARDPROP_BUFFERS:
-            workerClearForwardBuffers(executor, workerIdx);
-            break;
-          case TrainTask::CLEAR_BACKPROP_BUFFERS:
-            workerClearBackpropBuffers(executor, workerIdx);
-            break;
-          case TrainTask::CALCULATE_TARGETS:
-            workerCalculateTargets(executor, workerIdx);
-            break;
-          case TrainTask::FORWARDPROP:
-            workerForwardprop(executor, workerIdx);
-            break;
-          case TrainTask::BACKPROP_DELTA:
-            workerBackpropDelta(executor, workerIdx);
-            break;
-          case TrainTask::COMPUTE_AND_UPDATE_GRADIENTS:
-            workerComputeAndUpdateGradients(executor, workerIdx);
-            break;
-          default:
-            assert(false);
-          }
+  // A training step over traceLength timesteps:
+  //  - the target network's forward pass, then each timestep's target values,
+  //  - the learning network's forward pass, concurrently with the target pass,
+  //  - backprop of the deltas, from the last timestep to the first,
+  //  - per connection, accumulating the gradient of each timestep as soon as its deltas are
+  //    done, and finally the Adam update once backprop no longer needs the weights.
+  // Each forward and backward pass is a chain over the timesteps because of the recurrent
+  // connections.
+  uptr<TaskGraph<Executor>> buildTrainGraph(unsigned traceLength) {
+    auto graph = make_unique<TaskGraph<Executor>>();
+    int length = static_cast<int>(traceLength);
+
+    // A forward pass at timestamp t also writes the recurrent inputs of t + 1, if that exists.
+    int numCleared = std::min<int>(length + 1, maxTraceLength);
+
+    vector<unsigned> clearLearning, clearTarget;
+    for (int t = 0; t < numCleared; t++) {
+      clearLearning.push_back(graph->Add(
+          [this, t](Executor &executor) { clearForwardBuffers(executor, layerMemory, t); }));
+      clearTarget.push_back(graph->Add(
+          [this, t](Executor &executor) { clearForwardBuffers(executor, targetMemory, t); }));
+    }
+
+    vector<unsigned> clearDeltas, copyLabels, targetForward, learningForward;
+    for (int t = 0; t < length; t++) {
+      clearDeltas.push_back(
+          graph->Add([this, t](Executor &executor) { clearDeltaBuffers(executor, t); }));
+      copyLabels.push_back(
+          graph->Add([this, t](Executor &executor) { copyTraceLabels(executor, t); }));
+
+      vector<unsigned> targetDeps{clearTarget[t]};
+      vector<unsigned> learningDeps{clearLearning[t]};
+      if (t + 1 < numCleared) {
+        targetDeps.push_back(clearTarget[t + 1]);
+        learningDeps.push_back(clearLearning[t + 1]);
+      }
+      if (t > 0) {
+        targetDeps.push_back(targetForward[t - 1]);
+        learningDeps.push_back(learningForward[t - 1]);
+      }
 
-          taskSem.notify();
-        }
-      });
+      targetForward.push_back(graph->Add(
+          [this, t](Executor &executor) {
+            forwardPropSlice(executor, t, targetLayers, targetMemory);
+          },
+          targetDeps));
+      learningForward.push_back(graph->Add(
+          [this, t](Executor &executor) {
+            forwardPropSlice(executor, t, learningLayers, layerMemory);
+          },
+          learningDeps));
+    }
+
+    vector<unsigned> targetValues;
+    for (int t = 0; t < length; t++) {
+      bool isLast = t + 1 == length;
+      vector<unsigned> deps{copyLabels[t], targetForward[isLast ? t : t + 1]};
+      if (!isLast) {
+        deps.push_back(copyLabels[t + 1]);
+      }
+      targetValues.push_back(graph->Add(
+          [this, t, isLast](Executor &executor) { calculateTargets(executor, t, isLast); },
+          deps));
     }
-  }
-
-  void workerClearForwardBuffers(TaskExecutor &executor, unsigned workerIdx) {
-    unsigned skip = workers.size();
 
-    for (unsigned i = workerIdx; i < spec.maxTraceLength; i += skip) {
-      CuTimeSlice *ts = layerMemory.GetTimeSlice(i);
-      if (ts != nullptr) {
-        ts->networkOutput.haveActivation = false;
-        executor.Execute(Task::FillMatrix(ts->networkOutput.activation, 0.0f));
-        executor.Execute(Task::FillMatrix(ts->networkOutput.derivative, 0.0f));
+    vector<unsigned> backprop(length);
+    for (int t = length - 1; t >= 0; t--) {
+      vector<unsigned> deps{learningForward[length - 1], targetValues[t], clearDeltas[t]};
+      if (t > 0) {
+        deps.push_back(clearDeltas[t - 1]); // recurrent deltas propagate back a timestep.
+      }
+      if (t + 1 < length) {
+        deps.push_back(backprop[t + 1]);
+      }
+      backprop[t] = graph->Add([this, t](Executor &executor) { backProp(executor, t); }, deps);
+    }
 
-        for (auto &cd : ts->connectionData) {
-          cd.haveActivation = false;
+    for (unsigned ci = 0; ci < spec.connections.size(); ci++) {
+      unsigned last = graph->Add(
+          [this, ci](Executor &executor) { clearGradientBuffer(executor, ci); });
 
-          // This is so we dont zero out the bias column.
-          CuMatrix trimmed = cd.activation;
-          trimmed.cols--;
-          executor.Execute(Task::FillMatrix(trimmed, 0.0f));
-          executor.Execute(Task::FillMatrix(cd.derivative, 0.0f));
+      unsigned numGradients = 0;
+      for (int t = length - 1; t >= 0; t--) {
+        if (spec.connections[ci].timeOffset == 1 && t == 0) {
+          continue;
         }
+        last = graph->Add(
+            [this, ci, t](Executor &executor) { accumulateGradient(executor, ci, t); },
+            {last, backprop[t]});
+        numGradients++;
       }
-    }
-  }
 
-  void workerClearBackpropBuffers(TaskExecutor &executor, unsigned workerIdx) {
-    unsigned skip = workers.size();
+      // Only possible for a recurrent connection with a trace of length 1.
+      if (numGradients == 0) {
+        continue;
+      }
 
-    for (unsigned i = workerIdx; i < deltaAccum.allDeltaAccum.size(); i += skip) {
-      deltaAccum.allDeltaAccum[i].samples = 0;
-      executor.Execute(Task::FillMatrix(deltaAccum.allDeltaAccum[i].accumDelta, 0.0f));
+      graph->Add([this, ci](Executor &executor) { updateWeights(executor, ci); },
+                 {last, backprop[0]});
     }
 
-    for (unsigned i = workerIdx; i < gradientAccum.allWeightsAccum.size(); i += skip) {
-      gradientAccum.allWeightsAccum[i].samples = 0;
-      executor.Execute(Task::FillMatrix(gradientAccum.allWeightsAccum[i].accumGradient, 0.0f));
-    }
+    return graph;
   }
 
-  void workerCalculateTargets(TaskExecutor &executor, unsigned workerIdx) {
-    unsigned skip = workers.size();
-    for (unsigned i = workerIdx; i < spec.maxTraceLength; i += skip) {
-      CuTimeSlice *ts = layerMemory.GetTimeSlice(i);
-      if (ts != nullptr) {
-        executor.Execute(Task::CopyMatrixH2D(inputOutputStaging[i].actions, ts->actionsMask));
-        executor.Execute(Task::CopyMatrixH2D(inputOutputStaging[i].rewards, ts->rewards));
-      }
-    }
-
-    // Calculate Targets has no 'trivial' stream level parallelism.
-    if (workerIdx != 0) {
-      return;
-    }
+  void clearForwardBuffers(Executor &executor, CuLayerMemory &memory, int timestamp) {
+    CuTimeSlice *ts = memory.GetTimeSlice(timestamp);
+    assert(ts != nullptr);
 
-    for (int i = 0; i < static_cast<int>(curTraceLength); i++) {
-      CuTimeSlice *ts = layerMemory.GetTimeSlice(i);
-      assert(ts != nullptr);
+    ts->networkOutput.haveActivation = false;
+    executor.Execute(Task::FillMatrix(ts->networkOutput.activation, 0.0f));
+    executor.Execute(Task::FillMatrix(ts->networkOutput.derivative, 0.0f));
 
-      bool foundInput = false;
-      for (auto &cd : ts->connectionData) {
-        if (cd.connection.srcLayerId == 0) {
-          executor.Execute(Task::CopyMatrixH2D(inputOutputStaging[i].input, cd.activation));
-          cd.haveActivation = true;
-          foundInput = true;
-        }
-      }
-      assert(foundInput);
+    for (auto &cd : ts->connectionData) {
+      cd.haveActivation = false;
 
-      // Do the forward pass through this time slice.
-      forwardProp(executor, i, targetLayers);
-      assert(ts->networkOutput.haveActivation);
+      // This is so we dont zero out the bias column.
+      CuMatrix trimmed = cd.activation;
+      trimmed.cols--;
+      executor.Execute(Task::FillMatrix(trimmed, 0.0f));
+      executor.Execute(Task::FillMatrix(cd.derivative, 0.0f));
     }
+  }
 
-    for (int i = 0; i < static_cast<int>(curTraceLength); i++) {
-      CuTimeSlice *ts = layerMemory.GetTimeSlice(i);
-      CuTimeSlice *nextSlice = layerMemory.GetTimeSlice(i + 1);
-      assert(ts != nullptr);
-
-      traceTargets[i].batchSize = curBatchSize;
-
-      if (nextSlice == nullptr) {
-        executor.Execute(Task::TargetQValues(ts->networkOutput.activation, ts->actionsMask,
-                                             ts->rewards, 0.9f, true, traceTargets[i].value));
-      } else {
-        executor.Execute(Task::TargetQValues(nextSlice->networkOutput.activation,
-                                             nextSlice->actionsMask, ts->rewards, 0.9f, false,
-                                             traceTargets[i].value));
+  void clearDeltaBuffers(Executor &executor, int timestamp) {
+    for (auto &da : deltaAccum.allDeltaAccum) {
+      if (da.timestamp == timestamp) {
+        da.samples = 0;
+        executor.Execute(Task::FillMatrix(da.accumDelta, 0.0f));
       }
     }
   }
 
-  void workerForwardprop(TaskExecutor &executor, unsigned workerIdx) {
-    // Forward Prop has no 'trivial' stream level parallelism.
-    if (workerIdx != 0) {
-      return;
-    }
+  void clearGradientBuffer(Executor &executor, unsigned connectionIndex) {
+    CuConnectionAccum *connAccum = gradientAccum.GetConnection(spec.connections[connectionIndex]);
+    assert(connAccum != nullptr);
 
-    for (int i = 0; i < static_cast<int>(curTraceLength); i++) {
-      CuTimeSlice *ts = layerMemory.GetTimeSlice(i);
-      assert(ts != nullptr);
+    connAccum->samples = 0;
+    executor.Execute(Task::FillMatrix(connAccum->accumGradient, 0.0f));
+  }
 
-      bool foundInput = false;
-      for (auto &cd : ts->connectionData) {
-        if (cd.connection.srcLayerId == 0) {
-          executor.Execute(Task::CopyMatrixH2D(inputOutputStaging[i].input, cd.activation));
-          cd.haveActivation = true;
-          foundInput = true;
-        }
-      }
-      assert(foundInput);
+  void copyTraceLabels(Executor &executor, int timestamp) {
+    CuTimeSlice *ts = layerMemory.GetTimeSlice(timestamp);
+    assert(ts != nullptr);
 
-      // Do the forward pass through this time slice.
-      forwardProp(executor, i, learningLayers);
-      assert(ts->networkOutput.haveActivation);
-    }
+    executor.Execute(Task::CopyMatrixH2D((*curStaging)[timestamp].actions, ts->actionsMask));
+    executor.Execute(Task::CopyMatrixH2D((*curStaging)[timestamp].rewards, ts->rewards));
+    executor.Execute(Task::CopyMatrixH2D((*curStaging)[timestamp].weights, ts->weights));
   }
 
-  void workerBackpropDelta(TaskExecutor &executor, unsigned workerIdx) {
-    // BackProp of deltas has no 'trivial' stream level parallelism.
-    if (workerIdx != 0) {
-      return;
-    }
+  void forwardPropSlice(Executor &executor, int timestamp, vector<CuLayer> &layers,
+                        CuLayerMemory &memory) {
+    CuTimeSlice *ts = memory.GetTimeSlice(timestamp);
+    assert(ts != nullptr);
 
-    for (int i = static_cast<int>(curTraceLength) - 1; i >= 0; i--) {
-      backProp(executor, i);
+    bool foundInput = false;
+    for (auto &cd : ts->connectionData) {
+      if (cd.connection.srcLayerId == 0) {
+        executor.Execute(Task::CopyMatrixH2D((*curStaging)[timestamp].input, cd.activation));
+        cd.haveActivation = true;
+        foundInput = true;
+      }
     }
+    assert(foundInput);
+
+    forwardProp(executor, timestamp, layers, memory);
+    assert(ts->networkOutput.haveActivation);
   }
 
-  void workerComputeAndUpdateGradients(TaskExecutor &executor, unsigned workerIdx) {
-    unsigned skip = workers.size();
+  // The target of each timestep's Q values is its reward, plus the discounted best Q value of the
+  // next timestep from the target network unless this is the last timestep of the trace.
+  void calculateTargets(Executor &executor, int timestamp, bool isLast) {
+    CuTimeSlice *ts = layerMemory.GetTimeSlice(timestamp);
+    assert(ts != nullptr);
 
-    for (unsigned i = workerIdx; i < spec.connections.size(); i += skip) {
-      LayerConnection connection = spec.connections[i];
-      CuConnectionAccum *connAccum = gradientAccum.GetConnection(connection);
-      assert(connAccum != nullptr);
+    traceTargets[timestamp].batchSize = curBatchSize;
 
-      for (int timestamp = 0; timestamp < static_cast<int>(curTraceLength); timestamp++) {
-        if (connection.timeOffset == 1 && timestamp == 0) {
-          continue;
-        }
+    if (isLast) {
+      CuTimeSlice *targetSlice = targetMemory.GetTimeSlice(timestamp);
+      executor.Execute(Task::TargetQValues(targetSlice->networkOutput.activation, ts->actionsMask,
+                                           ts->rewards, TARGET_DISCOUNT_FACTOR, true,
+                                           traceTargets[timestamp].value));
+    } else {
+      CuTimeSlice *nextSlice = layerMemory.GetTimeSlice(timestamp + 1);
+      CuTimeSlice *nextTargetSlice = targetMemory.GetTimeSlice(timestamp + 1);
+      assert(nextSlice != nullptr && nextTargetSlice != nullptr);
 
-        CuTimeSlice *ts = layerMemory.GetTimeSlice(timestamp);
-        assert(ts != nullptr);
+      executor.Execute(Task::TargetQValues(nextTargetSlice->networkOutput.activation,
+                                           nextSlice->actionsMask, ts->rewards,
+                                           TARGET_DISCOUNT_FACTOR, false,
+                                           traceTargets[timestamp].value));
+    }
+  }
 
-        CuConnectionMemoryData *connData = ts->GetConnectionData(connection);
-        assert(connData != nullptr && connData->haveActivation);
+  void accumulateGradient(Executor &executor, unsigned connectionIndex, int timestamp) {
+    const LayerConnection &connection = spec.connections[connectionIndex];
+    CuConnectionAccum *connAccum = gradientAccum.GetConnection(connection);
+    assert(connAccum != nullptr);
 
-        CuLayerAccum *layerDelta = deltaAccum.GetDelta(connection.dstLayerId, timestamp);
-        assert(layerDelta != nullptr);
+    CuTimeSlice *ts = layerMemory.GetTimeSlice(timestamp);
+    assert(ts != nullptr);
 
-        ConnectionActivation activationIn(curBatchSize, connData->activation, connData->derivative);
+    CuConnectionMemoryData *connData = ts->GetConnectionData(connection);
+    assert(connData != nullptr && connData->haveActivation);
 
-        executor.Execute(
-            Task::GradientIncrement(LayerBatchDeltas(curBatchSize, layerDelta->accumDelta),
-                                    activationIn, connAccum->accumGradient));
-        connAccum->samples++;
-      }
+    CuLayerAccum *layerDelta = deltaAccum.GetDelta(connection.dstLayerId, timestamp);
+    assert(layerDelta != nullptr);
+
+    ConnectionActivation activationIn(curBatchSize, connData->activation, connData->derivative);
 
-      float scaleFactor = 1.0f / static_cast<float>(curBatchSize * connAccum->samples);
-      executor.Execute(Task::ScaleMatrix(connAccum->accumGradient, scaleFactor));
+    executor.Execute(Task::GradientIncrement(LayerBatchDeltas(curBatchSize, layerDelta->accumDelta),
+                                             activationIn, connAccum->accumGradient));
+    connAccum->samples++;
+  }
 
-      CuAdamConnection *adamConn = adamState.GetConnection(connection);
-      assert(adamConn != nullptr);
+  void updateWeights(Executor &executor, unsigned connectionIndex) {
+    const LayerConnection &connection = spec.connections[connectionIndex];
+    CuConnectionAccum *connAccum = gradientAccum.GetConnection(connection);
+    assert(connAccum != nullptr);
 
-      // connection.Print();
-      // cout << "grad: " << endl;
-      // connAccum->accumGradient.Print();
-      // getchar();
+    float scaleFactor = 1.0f / static_cast<float>(curBatchSize * connAccum->samples);
+    executor.Execute(Task::ScaleMatrix(connAccum->accumGradient, scaleFactor));
 
-      executor.Execute(Task::AdamUpdate(connAccum->accumGradient, adamConn->momentum, adamConn->rms,
-                                        ADAM_BETA1, ADAM_BETA2));
+    CuAdamConnection *adamConn = adamState.GetConnection(connection);
+    assert(adamConn != nullptr);
 
-      CuLayer *dstLayer = findLayer(connection.dstLayerId);
-      assert(dstLayer != nullptr);
+    executor.Execute(Task::AdamUpdate(connAccum->accumGradient, adamConn->momentum, adamConn->rms,
+                                      ADAM_BETA1, ADAM_BETA2));
 
-      CuWeights *weights = dstLayer->GetWeights(connection);
-      assert(weights != nullptr);
+    CuLayer *dstLayer = findLayer(connection.dstLayerId);
+    assert(dstLayer != nullptr);
 
-      executor.Execute(Task::AdamIncrement(weights->weights, adamConn->momentum, adamConn->rms,
-                                           ADAM_BETA1, ADAM_BETA2, ADAM_LR * curLearnRate,
-                                           ADAM_EPSILON));
-      executor.Execute(Task::TransposeMatrix(weights->weights, weights->weightsT));
-    }
+    CuWeights *weights = dstLayer->GetWeights(connection);
+    assert(weights != nullptr);
+
+    executor.Execute(Task::AdamIncrement(weights->weights, adamConn->momentum, adamConn->rms,
+                                         ADAM_BETA1, ADAM_BETA2, ADAM_LR * curLearnRate,
+                                         ADAM_EPSILON));
+    executor.Execute(Task::TransposeMatrix(weights->weights, weights->weightsT));
   }
 
-  void forwardProp(TaskExecutor &executor, int timestamp, vector<CuLayer> &layers) {
+  void forwardProp(Executor &executor, int timestamp, vector<CuLayer> &layers,
+                   CuLayerMemory &memory) {
     for (auto &layer : layers) {
       assert(!layer.incoming.empty());
 
-      vector<CuConnectionMemoryData *> outData = getAllOutgoingConnections(layer, timestamp);
+      vector<CuConnectionMemoryData *> outData =
+          getAllOutgoingConnections(layer, timestamp, memory);
 
       // This should only be possible if all the outgoing connections are recurrent.
       // Currently, this is assumed to not be possible.
       assert(!outData.empty());
 
-      CuConnectionMemoryData *targetOut = outData[0];
-      assert(!targetOut->haveActivation);
+      // The whole step of the layer is one fused task: the product over all of its incoming
+      // connections, then the activation, written to each of its outgoing connections.
+      ForwardLayerData step(curBatchSize, layer.activation);
 
       for (auto &in : layer.incoming) {
         if (in.first.timeOffset == 1 && timestamp == 0) {
           continue;
         }
 
-        CuConnectionMemoryData *inData = getConnectionMemoryData(in.first, timestamp);
+        CuConnectionMemoryData *inData = getConnectionMemoryData(in.first, timestamp, memory);
         assert(inData != nullptr && inData->haveActivation);
-
-        ConnectionActivation activationIn(curBatchSize, inData->activation, inData->derivative);
-        executor.Execute(
-            Task::ForwardIncrement(in.second.weights, activationIn, targetOut->activation));
+        step.AddInput(in.second.weights, inData->activation);
       }
 
-      ConnectionActivation outActivation(curBatchSize, targetOut->activation,
-                                         targetOut->derivative);
-      executor.Execute(Task::LayerActivation(outActivation, layer.activation));
-      targetOut->haveActivation = true;
-
-      for (unsigned i = 1; i < outData.size(); i++) {
-        assert(!outData[i]->haveActivation);
-
-        executor.Execute(Task::CopyMatrixD2D(targetOut->activation, outData[i]->activation));
-        executor.Execute(Task::CopyMatrixD2D(targetOut->derivative, outData[i]->derivative));
-        outData[i]->haveActivation = true;
+      for (auto *out : outData) {
+        assert(!out->haveActivation);
+        step.AddOutput(ConnectionActivation(curBatchSize, out->activation, out->derivative));
+        out->haveActivation = true;
       }
+
+      executor.Execute(Task::ForwardLayer(step));
     }
   }
 
-  vector<CuConnectionMemoryData *> getAllOutgoingConnections(const CuLayer &layer, int timestamp) {
+  vector<CuConnectionMemoryData *> getAllOutgoingConnections(const CuLayer &layer, int timestamp,
+                                                             CuLayerMemory &memory) {
     vector<CuConnectionMemoryData *> result;
 
     if (layer.isOutput) {
-      CuTimeSlice *ts = layerMemory.GetTimeSlice(timestamp);
+      CuTimeSlice *ts = memory.GetTimeSlice(timestamp);
       assert(ts != nullptr);
       result.push_back(&ts->networkOutput);
     } else {
       for (auto &conn : layer.outgoing) {
-        CuConnectionMemoryData *cmd = getConnectionMemoryData(conn, timestamp + conn.timeOffset);
+        CuConnectionMemoryData *cmd =
+            getConnectionMemoryData(conn, timestamp + conn.timeOffset, memory);
         if (cmd != nullptr) {
           result.push_back(cmd);
         }
@@ -572,7 +698,7 @@ struct CudaTrainer::CudaTrainerImpl {
     return result;
   }
 
-  void backProp(TaskExecutor &executor, int timestamp) {
+  void backProp(Executor &executor, int timestamp) {
     CuTimeSlice *ts = layerMemory.GetTimeSlice(timestamp);
     assert(ts != nullptr);
 
@@ -583,14 +709,17 @@ struct CudaTrainer::CudaTrainerImpl {
     assert(outputDelta != nullptr && outputDelta->samples == 0);
 
     executor.Execute(Task::ErrorMeasure(networkOut, traceTargets[timestamp], ts->actionsMask,
+                                        ts->weights,
                                         LayerBatchDeltas(curBatchSize, outputDelta->accumDelta)));
+    executor.Execute(
+        Task::CopyMatrixD2H(outputDelta->accumDelta, (*curStaging)[timestamp].outputDelta));
     outputDelta->samples = 1;
 
     assert(learningLayers.back().isOutput);
     recursiveBackprop(executor, learningLayers.back(), timestamp);
   }
 
-  void recursiveBackprop(TaskExecutor &executor, const CuLayer &layer, int timestamp) {
+  void recursiveBackprop(Executor &executor, const CuLayer &layer, int timestamp) {
     CuLayerAccum *layerDelta = deltaAccum.GetDelta(layer.layerId, timestamp);
     assert(layerDelta != nullptr);
 
@@ -637,8 +766,9 @@ struct CudaTrainer::CudaTrainerImpl {
     }
   }
 
-  CuConnectionMemoryData *getConnectionMemoryData(const LayerConnection &conn, int timestamp) {
-    CuTimeSlice *ts = layerMemory.GetTimeSlice(timestamp);
+  CuConnectionMemoryData *getConnectionMemoryData(const LayerConnection &conn, int timestamp,
+                                                  CuLayerMemory &memory) {
+    CuTimeSlice *ts = memory.GetTimeSlice(timestamp);
     if (ts == nullptr) {
       return nullptr;
     }
@@ -648,8 +778,10 @@ struct CudaTrainer::CudaTrainerImpl {
     return r;
   }
 
-  CuLayer *findLayer(unsigned layerId) {
-    for (auto &layer : learningLayers) {
+  CuLayer *findLayer(unsigned layerId) { return findLayer(learningLayers, layerId); }
+
+  static CuLayer *findLayer(vector<CuLayer> &layers, unsigned layerId) {
+    for (auto &layer : layers) {
       if (layer.layerId == layerId) {
         return &layer;
       }
@@ -658,10 +790,18 @@ struct CudaTrainer::CudaTrainerImpl {
   }
 };
 
-CudaTrainer::CudaTrainer(const RNNSpec &spec) : impl(new CudaTrainerImpl(spec)) {}
+CudaTrainer::CudaTrainer(const RNNSpec &spec) {
+  if (spec.trainerBackend == TrainerBackend::CUDA_HOST) {
+    impl = make_unique<ExecutorImpl<HostTaskExecutor>>(spec);
+  } else {
+    impl = make_unique<ExecutorImpl<TaskExecutor>>(spec);
+  }
+}
 
 CudaTrainer::~CudaTrainer() = default;
 
+bool CudaTrainer::IsAvailable(void) { return util::HaveDevice(); }
+
 void CudaTrainer::SetWeights(const vector<pair<LayerConnection, math::MatrixView>> &weights) {
   impl->SetWeights(weights);
 }
@@ -672,6 +812,26 @@ void CudaTrainer::GetWeights(vector<pair<LayerConnection, math::MatrixView>> &ou
 
 void CudaTrainer::UpdateTarget(void) { impl->UpdateTarget(); }
 
+void CudaTrainer::GetState(vector<TrainerConnectionState> &outState) {
+  impl->GetState(outState);
+}
+
+void CudaTrainer::SetState(const vector<TrainerConnectionState> &state) {
+  impl->SetState(state);
+}
+
 void CudaTrainer::Train(const vector<SliceBatch> &trace, float learnRate) {
   impl->Train(trace, learnRate);
 }
+
+vector<SliceBatch> &CudaTrainer::Staging(unsigned buffer) {
+  assert(buffer < impl->staging.size());
+  return impl->staging[buffer];
+}
+
+const EVector &CudaTrainer::TraceErrors(void) const { return impl->traceErrors; }
+
+void CudaTrainer::TrainStaged(unsigned buffer, unsigned batchSize, unsigned traceLength,
+                              float learnRate) {
+  impl->TrainStaged(buffer, batchSize, traceLength, learnRate);
+}
@@ -2,25 +2,40 @@
 
 #include "../common/Common.hpp"
 #include "../math/Math.hpp"
+#include "NetworkTrainer.hpp"
 #include "RNNSpec.hpp"
 #include "SliceBatch.hpp"
 #include <utility>
 
 namespace rnn {
 
-class CudaTrainer {
+// Trains on a CUDA device, or with the same tasks run on the host if the spec's trainerBackend is
+// CUDA_HOST.
+class CudaTrainer : public NetworkTrainer {
 public:
   CudaTrainer(const RNNSpec &spec);
-  ~CudaTrainer();
+  virtual ~CudaTrainer();
 
-  void SetWeights(const vector<pair<LayerConnection, math::MatrixView>> &weights);
-  void GetWeights(vector<pair<LayerConnection, math::MatrixView>> &outWeights);
-  void UpdateTarget(void);
+  // Returns whether there is a CUDA capable device that this trainer can run on.
+  static bool IsAvailable(void);
 
-  void Train(const vector<SliceBatch> &trace, float learnRate);
+  void SetWeights(const vector<pair<LayerConnection, math::MatrixView>> &weights) override;
+  void GetWeights(vector<pair<LayerConnection, math::MatrixView>> &outWeights) override;
+  void UpdateTarget(void) override;
+
+  void GetState(vector<TrainerConnectionState> &outState) override;
+  void SetState(const vector<TrainerConnectionState> &state) override;
+
+  void Train(const vector<SliceBatch> &trace, float learnRate) override;
+
+  vector<SliceBatch> &Staging(unsigned buffer) override;
+  void TrainStaged(unsigned buffer, unsigned batchSize, unsigned traceLength,
+                   float learnRate) override;
+  const EVector &TraceErrors(void) const override;
 
 private:
   struct CudaTrainerImpl;
+  template <typename Executor> struct ExecutorImpl;
   uptr<CudaTrainerImpl> impl;
 };
 }
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "../common/Common.hpp"
+#include "../math/Math.hpp"
+#include "Layer.hpp"
+#include "RNNSpec.hpp"
+#include <vector>
+
+namespace rnn {
+
+// Single step inference specialized for one topology, which an RNN uses in place of its generic
+// forward pass when the spec matches. The rnn library knows nothing of any particular topology,
+// so the user of the network, which does, passes one to the RNN (see FixedInferenceFor).
+class FixedInference {
+public:
+  // Recurrent memory, as RNNState.
+  class State {
+  public:
+    virtual ~State() = default;
+    virtual void Clear(void) = 0;
+  };
+
+  // A copy of one set of the network's weights, made whenever they change.
+  class Weights {
+  public:
+    virtual ~Weights() = default;
+    virtual void Process(const EVector &input, State &state, EVector &output) const = 0;
+  };
+
+  virtual ~FixedInference() = default;
+
+  virtual bool Matches(const RNNSpec &spec) const = 0;
+  virtual uptr<State> NewState(void) const = 0;
+  virtual uptr<Weights> NewWeights(const RNNSpec &spec, const vector<Layer> &layers) const = 0;
+};
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "../common/Common.hpp"
+#include "../math/Math.hpp"
+#include "FixedInference.hpp"
+#include "Layer.hpp"
+#include "LayerDef.hpp"
+#include "RNNSpec.hpp"
+#include <cassert>
+
+namespace rnn {
+
+// Single step inference for one fixed topology, NumInputs -> Hidden1 -> Hidden2 (self recurrent)
+// -> NumOutputs, with tanh hidden layers and a linear output. Every dimension is a template
+// parameter, so the weights and activations are fixed size Eigen objects and the products are
+// fully unrolled and vectorized, with no walking of layers or connections per step.
+//
+// Built from a matching RNNSpec (see Matches), and holds its own copy of the weights, which must be
+// refreshed with SetWeights whenever the network's weights change. An RNN uses one for its single
+// step inference when given a FixedInferenceFor it.
+template <int NumInputs, int Hidden1, int Hidden2, int NumOutputs> class FixedRNN {
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  using Input = Eigen::Matrix<float, NumInputs, 1>;
+  using Output = Eigen::Matrix<float, NumOutputs, 1>;
+
+  struct State {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    Eigen::Matrix<float, Hidden2, 1> hidden2; // the recurrent layer's output of the last step.
+    bool havePrevious;
+
+    State() { Clear(); }
+
+    void Clear(void) {
+      hidden2.setZero();
+      havePrevious = false;
+    }
+  };
+
+  // Whether the spec is exactly this topology, in which case the network's layers can be loaded
+  // with SetWeights.
+  static bool Matches(const RNNSpec &spec) {
+    if (spec.numInputs != static_cast<unsigned>(NumInputs) ||
+        spec.numOutputs != static_cast<unsigned>(NumOutputs) ||
+        spec.hiddenActivation != LayerActivation::TANH ||
+        spec.outputActivation != LayerActivation::LINEAR || spec.layers.size() != 3 ||
+        spec.connections.size() != 4) {
+      return false;
+    }
+
+    unsigned id1, id2, id3;
+    if (!findDst(spec, 0, id1) || !findDst(spec, id1, id2) || !findDst(spec, id2, id3) ||
+        id1 == id3) {
+      return false;
+    }
+
+    // The remaining connection has to be the recurrent one.
+    bool haveRecurrent = false;
+    for (const auto &c : spec.connections) {
+      haveRecurrent |= c.srcLayerId == id2 && c.dstLayerId == id2 && c.timeOffset == 1;
+    }
+    if (!haveRecurrent) {
+      return false;
+    }
+
+    for (const auto &ls : spec.layers) {
+      bool matches = (ls.uid == id1 && ls.numNodes == static_cast<unsigned>(Hidden1)) ||
+                     (ls.uid == id2 && ls.numNodes == static_cast<unsigned>(Hidden2)) ||
+                     (ls.uid == id3 && ls.numNodes == static_cast<unsigned>(NumOutputs));
+      if (!matches || ls.isOutput != (ls.uid == id3)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  FixedRNN(const RNNSpec &spec) : activationRate(spec.nodeActivationRate) {
+    assert(Matches(spec));
+    findDst(spec, 0, id1);
+    findDst(spec, id1, id2);
+    findDst(spec, id2, id3);
+  }
+
+  // Copies the weights out of the layers of a network built from the spec.
+  void SetWeights(const vector<Layer> &layers) {
+    for (const auto &layer : layers) {
+      for (const auto &w : layer.weights) {
+        const LayerConnection &c = w.first;
+        const EMatrix &m = w.second;
+
+        if (c.dstLayerId == id1) {
+          w1 = m.leftCols(NumInputs);
+          b1 = m.col(NumInputs);
+        } else if (c.dstLayerId == id2 && c.timeOffset == 0) {
+          w2 = m.leftCols(Hidden1);
+          b2 = m.col(Hidden1);
+        } else if (c.dstLayerId == id2) {
+          w2r = m.leftCols(Hidden2);
+          b2r = m.col(Hidden2);
+        } else {
+          assert(c.dstLayerId == id3);
+          w3 = m.leftCols(Hidden2);
+          b3 = m.col(Hidden2);
+        }
+      }
+    }
+  }
+
+  // Same as RNN::Process, for a state of this network. The input and output may be any Eigen
+  // vectors of the right size, e.g. Maps of an EVector.
+  template <typename InputType, typename OutputType>
+  void Process(const Eigen::MatrixBase<InputType> &input, State &state,
+               Eigen::MatrixBase<OutputType> &output) const {
+    static_assert(InputType::RowsAtCompileTime == NumInputs, "wrong input size");
+    static_assert(OutputType::RowsAtCompileTime == NumOutputs, "wrong output size");
+
+    Eigen::Matrix<float, Hidden1, 1> h1 = ((w1 * input + b1).array().tanh() * activationRate);
+
+    Eigen::Matrix<float, Hidden2, 1> sum2 = w2 * h1 + b2;
+    if (state.havePrevious) {
+      sum2.noalias() += w2r * state.hidden2;
+      sum2 += b2r;
+    }
+    state.hidden2 = sum2.array().tanh();
+    state.havePrevious = true;
+
+    output.noalias() = w3 * (state.hidden2 * activationRate);
+    output += b3;
+  }
+
+private:
+  float activationRate; // the scale of the non-recurrent outputs of the hidden layers.
+  unsigned id1, id2, id3;
+
+  Eigen::Matrix<float, Hidden1, NumInputs, Eigen::RowMajor> w1;
+  Eigen::Matrix<float, Hidden1, 1> b1;
+
+  Eigen::Matrix<float, Hidden2, Hidden1, Eigen::RowMajor> w2;
+  Eigen::Matrix<float, Hidden2, 1> b2;
+  Eigen::Matrix<float, Hidden2, Hidden2, Eigen::RowMajor> w2r;
+  Eigen::Matrix<float, Hidden2, 1> b2r;
+
+  Eigen::Matrix<float, NumOutputs, Hidden2, Eigen::RowMajor> w3;
+  Eigen::Matrix<float, NumOutputs, 1> b3;
+
+  // The destination of the non-recurrent connection out of src.
+  static bool findDst(const RNNSpec &spec, unsigned src, unsigned &outDst) {
+    for (const auto &c : spec.connections) {
+      if (c.srcLayerId == src && c.timeOffset == 0 && c.dstLayerId != src) {
+        outDst = c.dstLayerId;
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+// Adapts a FixedRNN specialization to FixedInference, for example
+// make_shared<FixedInferenceFor<FixedRNN<11, 64, 128, 9>>>().
+template <typename Network> class FixedInferenceFor : public FixedInference {
+public:
+  bool Matches(const RNNSpec &spec) const override { return Network::Matches(spec); }
+
+  uptr<State> NewState(void) const override { return make_unique<NetworkState>(); }
+
+  uptr<Weights> NewWeights(const RNNSpec &spec, const vector<Layer> &layers) const override {
+    auto result = make_unique<NetworkWeights>(spec);
+    result->network.SetWeights(layers);
+    return move(result);
+  }
+
+private:
+  struct NetworkState : public State {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    typename Network::State state;
+
+    void Clear(void) override { state.Clear(); }
+  };
+
+  struct NetworkWeights : public Weights {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    Network network;
+
+    NetworkWeights(const RNNSpec &spec) : network(spec) {}
+
+    void Process(const EVector &input, State &state, EVector &output) const override {
+      Eigen::Map<typename Network::Output> out(output.data());
+      network.Process(Eigen::Map<const typename Network::Input>(input.data()),
+                      static_cast<NetworkState &>(state).state, out);
+    }
+  };
+};
+}
@@ -0,0 +1,206 @@
+#include "ModelCheckpoint.hpp"
+#include "../common/BinaryFile.hpp"
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace rnn;
+
+static constexpr char FILE_MAGIC[8] = {'R', 'N', 'N', 'M', 'O', 'D', 'E', 'L'};
+static constexpr uint32_t FILE_FORMAT_VERSION = 1;
+static constexpr size_t SECTION_ALIGNMENT = 64;
+static const string FILE_KIND = "model checkpoint";
+
+struct FileHeader {
+  char magic[8];
+  uint32_t formatVersion;
+  uint32_t numInputs;
+  uint32_t numOutputs;
+  uint32_t numLayers;
+  uint32_t numConnections;
+  uint32_t hiddenActivation;
+  uint32_t outputActivation;
+  float nodeActivationRate;
+  uint32_t maxBatchSize;
+  uint32_t maxTraceLength;
+  uint64_t fileSize;
+  uint64_t checksum; // of everything after the header.
+};
+
+struct LayerEntry {
+  uint32_t uid;
+  uint32_t numNodes;
+  uint32_t isOutput;
+};
+
+struct ModelCheckpoint::WeightsEntry {
+  uint32_t srcLayerId;
+  uint32_t dstLayerId;
+  int32_t timeOffset;
+  uint32_t rows;
+  uint32_t cols;
+  uint32_t padding;
+  uint64_t offset; // from the start of the file.
+};
+
+static size_t aligned(size_t offset) {
+  return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+// Byte offsets of each section, which follow from the number of layers and connections.
+struct ModelCheckpoint::Layout {
+  size_t layers;
+  size_t connections;
+  size_t weights;
+
+  Layout(size_t numLayers, size_t numConnections) {
+    layers = aligned(sizeof(FileHeader));
+    connections = aligned(layers + numLayers * sizeof(LayerEntry));
+    weights = aligned(connections + numConnections * sizeof(WeightsEntry));
+  }
+};
+
+void ModelCheckpoint::Write(const string &path, const RNNSpec &spec,
+                            const vector<pair<LayerConnection, const EMatrix *>> &weights) {
+  assert(weights.size() == spec.connections.size());
+  Layout layout(spec.layers.size(), spec.connections.size());
+
+  // Weights in the order of the spec's connections, so the table can be read back without a
+  // search.
+  vector<const EMatrix *> ordered;
+  size_t totalSize = layout.weights;
+  for (const auto &connection : spec.connections) {
+    const EMatrix *m = nullptr;
+    for (const auto &w : weights) {
+      if (w.first == connection) {
+        m = w.second;
+      }
+    }
+    assert(m != nullptr);
+
+    ordered.push_back(m);
+    totalSize = aligned(totalSize + m->size() * sizeof(float));
+  }
+
+  vector<uint8_t> image(totalSize, 0);
+
+  FileHeader *header = reinterpret_cast<FileHeader *>(image.data());
+  memcpy(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+  header->formatVersion = FILE_FORMAT_VERSION;
+  header->numInputs = spec.numInputs;
+  header->numOutputs = spec.numOutputs;
+  header->numLayers = spec.layers.size();
+  header->numConnections = spec.connections.size();
+  header->hiddenActivation = static_cast<uint32_t>(spec.hiddenActivation);
+  header->outputActivation = static_cast<uint32_t>(spec.outputActivation);
+  header->nodeActivationRate = spec.nodeActivationRate;
+  header->maxBatchSize = spec.maxBatchSize;
+  header->maxTraceLength = spec.maxTraceLength;
+
+  LayerEntry *layerEntries = reinterpret_cast<LayerEntry *>(image.data() + layout.layers);
+  for (unsigned i = 0; i < spec.layers.size(); i++) {
+    const LayerSpec &ls = spec.layers[i];
+    layerEntries[i] = LayerEntry{ls.uid, ls.numNodes, static_cast<uint32_t>(ls.isOutput)};
+  }
+
+  WeightsEntry *weightsEntries =
+      reinterpret_cast<WeightsEntry *>(image.data() + layout.connections);
+  size_t offset = layout.weights;
+  for (unsigned i = 0; i < spec.connections.size(); i++) {
+    const LayerConnection &c = spec.connections[i];
+    const EMatrix &m = *ordered[i];
+
+    weightsEntries[i] = WeightsEntry{c.srcLayerId,
+                                     c.dstLayerId,
+                                     c.timeOffset,
+                                     static_cast<uint32_t>(m.rows()),
+                                     static_cast<uint32_t>(m.cols()),
+                                     0,
+                                     offset};
+    memcpy(image.data() + offset, m.data(), m.size() * sizeof(float));
+    offset = aligned(offset + m.size() * sizeof(float));
+  }
+
+  SealFileImage<FileHeader>(image.data(), image.size());
+  WriteFileAtomically(FILE_KIND, path, image.data(), image.size());
+}
+
+ModelCheckpoint::ModelCheckpoint(const string &path) : mapped(nullptr), mappedSize(0) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    FailFile(FILE_KIND, path, strerror(errno));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    FailFile(FILE_KIND, path, strerror(errno));
+  }
+  if (static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+    FailFile(FILE_KIND, path, "too small for a header");
+  }
+
+  mappedSize = st.st_size;
+  mapped = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    FailFile(FILE_KIND, path, strerror(errno));
+  }
+
+  const uint8_t *base = static_cast<const uint8_t *>(mapped);
+  CheckFileImage<FileHeader>(FILE_KIND, path, base, mappedSize, FILE_MAGIC, FILE_FORMAT_VERSION);
+  const FileHeader *header = reinterpret_cast<const FileHeader *>(base);
+
+  Layout layout(header->numLayers, header->numConnections);
+  if (layout.weights > mappedSize) {
+    FailFile(FILE_KIND, path, "truncated");
+  }
+
+  spec.numInputs = header->numInputs;
+  spec.numOutputs = header->numOutputs;
+  spec.hiddenActivation = static_cast<LayerActivation>(header->hiddenActivation);
+  spec.outputActivation = static_cast<LayerActivation>(header->outputActivation);
+  spec.nodeActivationRate = header->nodeActivationRate;
+  spec.maxBatchSize = header->maxBatchSize;
+  spec.maxTraceLength = header->maxTraceLength;
+
+  const LayerEntry *layerEntries = reinterpret_cast<const LayerEntry *>(base + layout.layers);
+  for (unsigned i = 0; i < header->numLayers; i++) {
+    spec.layers.emplace_back(layerEntries[i].uid, layerEntries[i].numNodes,
+                             layerEntries[i].isOutput != 0);
+  }
+
+  entries = reinterpret_cast<const WeightsEntry *>(base + layout.connections);
+  for (unsigned i = 0; i < header->numConnections; i++) {
+    const WeightsEntry &e = entries[i];
+    if (e.offset % SECTION_ALIGNMENT != 0 ||
+        e.offset + static_cast<uint64_t>(e.rows) * e.cols * sizeof(float) > mappedSize) {
+      FailFile(FILE_KIND, path, "weights out of bounds");
+    }
+    spec.connections.emplace_back(e.srcLayerId, e.dstLayerId, e.timeOffset);
+  }
+}
+
+ModelCheckpoint::~ModelCheckpoint() {
+  if (mapped != nullptr) {
+    munmap(mapped, mappedSize);
+  }
+}
+
+Eigen::Map<const EMatrix> ModelCheckpoint::Weights(const LayerConnection &connection) const {
+  for (unsigned i = 0; i < spec.connections.size(); i++) {
+    if (spec.connections[i] == connection) {
+      const WeightsEntry &e = entries[i];
+      const float *data =
+          reinterpret_cast<const float *>(static_cast<const uint8_t *>(mapped) + e.offset);
+      return Eigen::Map<const EMatrix>(data, e.rows, e.cols);
+    }
+  }
+
+  assert(false);
+  return Eigen::Map<const EMatrix>(nullptr, 0, 0);
+}
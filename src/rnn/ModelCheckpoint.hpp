@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../common/Common.hpp"
+#include "../math/Math.hpp"
+#include "LayerDef.hpp"
+#include "RNNSpec.hpp"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rnn {
+
+// A network's spec and weights in a versioned binary file: a header holding the spec, a table with
+// the shape and offset of each connection's weights, and then the weights themselves as dense row
+// major floats, each starting on a 64 byte boundary. The file is mapped read-only and the weights
+// are used straight from the mapping, so opening a checkpoint is a checksum pass with nothing to
+// parse or convert. Unlike RNN::Write the weights round-trip exactly.
+//
+// The layout is that of the machine that wrote it (native endianness), as with a ReplayStore file.
+class ModelCheckpoint {
+public:
+  // Writes the spec and the weights of each of its connections, in any order, to path. The file is
+  // written beside path and renamed over it once complete, so an existing checkpoint at path is
+  // never left half written.
+  static void Write(const string &path, const RNNSpec &spec,
+                    const vector<pair<LayerConnection, const EMatrix *>> &weights);
+
+  // Maps the checkpoint at path. Exits with an error if it is not a checkpoint of this format
+  // version, or fails its checksum.
+  ModelCheckpoint(const string &path);
+  ~ModelCheckpoint();
+
+  ModelCheckpoint(const ModelCheckpoint &other) = delete;
+  ModelCheckpoint &operator=(const ModelCheckpoint &other) = delete;
+
+  const RNNSpec &Spec(void) const { return spec; }
+
+  // The weights of one of the spec's connections, pointing into the mapping, so only valid for
+  // the lifetime of this checkpoint.
+  Eigen::Map<const EMatrix> Weights(const LayerConnection &connection) const;
+
+private:
+  struct WeightsEntry;
+  struct Layout;
+
+  RNNSpec spec;
+  void *mapped;
+  size_t mappedSize;
+  const WeightsEntry *entries; // one per connection of the spec, in the same order.
+};
+}
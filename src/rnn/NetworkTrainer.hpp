@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../common/Common.hpp"
+#include "../math/Math.hpp"
+#include "../math/MatrixView.hpp"
+#include "LayerDef.hpp"
+#include "SliceBatch.hpp"
+#include <utility>
+#include <vector>
+
+namespace rnn {
+
+// Everything a trainer has learned for one connection (see NetworkTrainer::GetState).
+struct TrainerConnectionState {
+  LayerConnection connection;
+  EMatrix weights;       // of the learning network.
+  EMatrix targetWeights; // of the target network.
+  EMatrix momentum;      // Adam's moment estimates.
+  EMatrix rms;
+};
+
+// Common interface for the training backends (CUDA or multithreaded CPU). The trainer owns the
+// learning and target copies of the network weights and the optimizer state.
+class NetworkTrainer {
+public:
+  // Number of independent sets of staging slices, so that the next trace can be written into one
+  // while another is being trained on.
+  static constexpr unsigned NUM_STAGING_BUFFERS = 2;
+
+  virtual ~NetworkTrainer() = default;
+
+  virtual void SetWeights(const vector<pair<LayerConnection, math::MatrixView>> &weights) = 0;
+  virtual void GetWeights(vector<pair<LayerConnection, math::MatrixView>> &outWeights) = 0;
+  virtual void UpdateTarget(void) = 0;
+
+  // The complete training state, one entry per connection of the spec, for checkpointing.
+  // GetState reuses the matrices of outState if it was filled by a previous call, so only the
+  // first call allocates. Restoring the state with SetState on a trainer of the same spec carries
+  // on training exactly as this trainer would.
+  virtual void GetState(vector<TrainerConnectionState> &outState) = 0;
+  virtual void SetState(const vector<TrainerConnectionState> &state) = 0;
+
+  virtual void Train(const vector<SliceBatch> &trace, float learnRate) = 0;
+
+  // The trainer's own input buffers: spec.maxTraceLength slices of spec.maxBatchSize rows, in the
+  // layout Train reads. Writing a trace into the leading rows and slices in place, then calling
+  // TrainStaged, skips building and copying a trace. The slices must not be resized. A buffer
+  // other than the one being trained on may be written to concurrently with TrainStaged, and a
+  // buffer may be rewritten as soon as TrainStaged on it returns.
+  virtual vector<SliceBatch> &Staging(unsigned buffer) = 0;
+  virtual void TrainStaged(unsigned buffer, unsigned batchSize, unsigned traceLength,
+                           float learnRate) = 0;
+
+  // The TD error of each batch element in the last Train, as the mean over the trace of the
+  // unweighted absolute error of the action taken. Has spec.maxBatchSize rows, of which the
+  // leading batch size are valid.
+  virtual const EVector &TraceErrors(void) const = 0;
+};
+}
@@ -1,39 +1,191 @@
 
 #include "RNN.hpp"
-#include "../common/Maybe.hpp"
+#include "../common/EpochReclaimer.hpp"
 #include "Activations.hpp"
+#include "CpuTrainer.hpp"
 #include "CudaTrainer.hpp"
+#include "FixedInference.hpp"
 #include "Layer.hpp"
 #include "LayerDef.hpp"
-#include "TimeSlice.hpp"
+#include "ModelCheckpoint.hpp"
+#include <atomic>
 #include <cassert>
 #include <utility>
 
 using namespace rnn;
 
+static constexpr int BATCH_BLOCK_ROWS = 128;
+
+// Where a layer's output goes during single step inference: a span of the packed input of the
+// destination layer, for the current step, or for the next step if the connection is recurrent.
+struct OutgoingConnection {
+  unsigned dstLayer; // index into the layers.
+  unsigned offset;
+  bool recurrent;
+  float scale;
+};
+
+// How to step a layer during inference, derived from the network's connections. Read only once
+// built, so it can be shared between threads. The activations of all of a layer's incoming
+// connections sit side by side in one packed input, so a step is a single product with the
+// layer's packed weights.
+struct LayerPlan {
+  unsigned inputSize;      // width of the packed input.
+  int networkInputOffset;  // where the network input goes in the packed input, or -1.
+  vector<unsigned> offsets; // parallel to Layer::weights.
+  vector<OutgoingConnection> outgoing;
+  bool isOutput;
+};
+
+// A layer's weights laid out to match its packed input, with the biases of its connections summed.
+// The recurrent biases are summed separately, as they only apply once there is a previous step.
+struct PackedLayer {
+  EMatrix weights;
+  EVector bias;
+  EVector recurrentBias;
+};
+
+// The weights read by inference. A snapshot is never modified once published: new weights go into
+// a new snapshot, which replaces the current one with an atomic pointer swap. A step loads the
+// current snapshot once and uses it throughout, so it always sees one consistent set of weights,
+// and the old snapshot is only deleted once no step can still be using it.
+struct WeightsSnapshot {
+  vector<PackedLayer> packed; // indexed by layer.
+  uptr<FixedInference::Weights> fixed; // set if the network has a FixedInference.
+};
+
+// Everything is allocated up front so that Process does not touch the heap. The packed layer
+// inputs are double buffered: a step writes its recurrent outputs into the other buffer, where the
+// next step reads them, and the buffers swap roles after every step.
+struct RNNState::RNNStateImpl {
+  vector<EVector> layerInputs[2]; // indexed by layer.
+  vector<EVector> layerSums;      // indexed by layer, holds the output after activation.
+  unsigned cur = 0;
+  bool havePrevious = false;
+
+  uptr<FixedInference::State> fixed; // used instead of the above if the network has one.
+};
+
+// The same layout as RNNStateImpl, with row i of each matrix belonging to state i.
+struct RNNBatchState::RNNBatchStateImpl {
+  vector<EMatrix> layerInputs[2];
+  vector<EMatrix> layerSums;
+  EVector havePrevious; // 1 if the state has been stepped since it was cleared.
+  unsigned cur = 0;
+};
+
+RNNState::RNNState(RNNStateImpl *impl) : impl(impl) {}
+RNNState::~RNNState() = default;
+
+// The recurrent inputs are zeroed as well, since the packed product multiplies them out rather
+// than skipping them.
+void RNNState::Clear(void) {
+  for (auto &v : impl->layerInputs[impl->cur]) {
+    v.setZero();
+  }
+  impl->havePrevious = false;
+  if (impl->fixed != nullptr) {
+    impl->fixed->Clear();
+  }
+}
+
+RNNBatchState::RNNBatchState(RNNBatchStateImpl *impl) : impl(impl) {}
+RNNBatchState::~RNNBatchState() = default;
+
+unsigned RNNBatchState::NumStates(void) const { return impl->havePrevious.rows(); }
+
+// As for RNNState, the recurrent inputs of the state are zeroed.
+void RNNBatchState::Clear(unsigned index) {
+  assert(index < NumStates());
+  for (auto &m : impl->layerInputs[impl->cur]) {
+    m.row(index).setZero();
+  }
+  impl->havePrevious(index) = 0.0f;
+}
+
+void RNNBatchState::ClearAll(void) {
+  for (auto &m : impl->layerInputs[impl->cur]) {
+    m.setZero();
+  }
+  impl->havePrevious.setZero();
+}
+
+// Applies an activation function in place to every row of values, softmax is taken per row.
+static void activateRows(LayerActivation func, Eigen::Ref<EMatrix> values) {
+  switch (func) {
+  case LayerActivation::TANH:
+    values = values.array().tanh().matrix();
+    return;
+  case LayerActivation::LINEAR:
+    return;
+  case LayerActivation::SOFTMAX:
+    for (int r = 0; r < values.rows(); r++) {
+      float maxVal = values.row(r).maxCoeff();
+      values.row(r) = (values.row(r).array() - maxVal).exp().matrix();
+      values.row(r) /= values.row(r).sum();
+    }
+    return;
+  default:
+    values = values.unaryExpr([func](float v) { return ActivationValue(func, v); });
+    return;
+  }
+}
+
 struct RNN::RNNImpl {
   RNNSpec spec;
   vector<Layer> layers;
-  Maybe<TimeSlice> previous;
 
-  CudaTrainer cudaTrainer;
+  vector<LayerPlan> plan;
+  sptr<const FixedInference> fixed; // null unless one matching the spec was given.
+
+  // Republished from the layers whenever their weights change.
+  atomic<const WeightsSnapshot *> snapshot;
+  mutable EpochReclaimer reclaimer;
 
-  RNNImpl(const RNNSpec &spec) : spec(spec), previous(Maybe<TimeSlice>::none), cudaTrainer(spec) {
+  uptr<NetworkTrainer> trainer;
+
+  RNNImpl(const RNNSpec &spec, const sptr<const FixedInference> &fixed)
+      : spec(spec), fixed(fixed != nullptr && fixed->Matches(spec) ? fixed : nullptr),
+        snapshot(nullptr), trainer(createTrainer(spec)) {
     for (const auto &ls : spec.layers) {
       layers.emplace_back(spec, ls);
     }
+    buildPlan();
+    publishWeights();
 
     vector<pair<LayerConnection, math::MatrixView>> weights = getHostWeights();
-    cudaTrainer.SetWeights(weights);
+    trainer->SetWeights(weights);
   }
 
+  static uptr<NetworkTrainer> createTrainer(const RNNSpec &spec) {
+    switch (spec.trainerBackend) {
+    case TrainerBackend::CUDA:
+    case TrainerBackend::CUDA_HOST:
+      return make_unique<CudaTrainer>(spec);
+    case TrainerBackend::CPU:
+      return make_unique<CpuTrainer>(spec);
+    case TrainerBackend::AUTO:
+      if (CudaTrainer::IsAvailable()) {
+        return make_unique<CudaTrainer>(spec);
+      } else {
+        return make_unique<CpuTrainer>(spec);
+      }
+    }
+
+    assert(false);
+    return nullptr;
+  }
+
+  ~RNNImpl() { delete snapshot.load(); }
+
   void Read(std::istream &in) {
     for (auto &layer : layers) {
       layer.Read(in);
     }
+    publishWeights();
 
     vector<pair<LayerConnection, math::MatrixView>> weights = getHostWeights();
-    cudaTrainer.SetWeights(weights);
+    trainer->SetWeights(weights);
   }
 
   void Write(std::ostream &out) const {
@@ -44,27 +196,126 @@ struct RNN::RNNImpl {
     }
   }
 
-  void ClearMemory(void) { previous = Maybe<TimeSlice>::none; }
+  void Read(const ModelCheckpoint &checkpoint) {
+    for (auto &layer : layers) {
+      for (auto &w : layer.weights) {
+        Eigen::Map<const EMatrix> m = checkpoint.Weights(w.first);
+        assert(m.rows() == w.second.rows() && m.cols() == w.second.cols());
+        w.second = m;
+      }
+    }
+    publishWeights();
+
+    vector<pair<LayerConnection, math::MatrixView>> weights = getHostWeights();
+    trainer->SetWeights(weights);
+  }
+
+  void WriteCheckpoint(const string &path) const {
+    vector<pair<LayerConnection, const EMatrix *>> weights;
+    for (const auto &layer : layers) {
+      for (const auto &w : layer.weights) {
+        weights.emplace_back(w.first, &w.second);
+      }
+    }
+    ModelCheckpoint::Write(path, spec, weights);
+  }
+
+  RNNState::RNNStateImpl *NewState(void) const {
+    auto *result = new RNNState::RNNStateImpl();
+    if (fixed != nullptr) {
+      result->fixed = fixed->NewState();
+      return result;
+    }
+
+    for (auto &mem : result->layerInputs) {
+      for (const auto &lp : plan) {
+        mem.push_back(EVector::Zero(lp.inputSize));
+      }
+    }
+    for (const auto &layer : layers) {
+      result->layerSums.push_back(EVector::Zero(layer.numNodes));
+    }
+    return result;
+  }
+
+  RNNBatchState::RNNBatchStateImpl *NewBatchState(unsigned numStates) const {
+    assert(numStates > 0);
+
+    auto *result = new RNNBatchState::RNNBatchStateImpl();
+    for (auto &mem : result->layerInputs) {
+      for (const auto &lp : plan) {
+        mem.push_back(EMatrix::Zero(numStates, lp.inputSize));
+      }
+    }
+    for (const auto &layer : layers) {
+      result->layerSums.push_back(EMatrix::Zero(numStates, layer.numNodes));
+    }
+    result->havePrevious = EVector::Zero(numStates);
+    return result;
+  }
 
-  EVector Process(const EVector &input) {
+  void Process(const EVector &input, RNNState::RNNStateImpl &state, EVector &output) const {
     assert(input.rows() == spec.numInputs);
+    output.resize(spec.numOutputs);
 
-    TimeSlice *prevSlice = previous.valid() ? &(previous.val()) : nullptr;
-    TimeSlice curSlice(0, input, layers);
+    EpochReclaimer::Guard guard(reclaimer);
+    const WeightsSnapshot &weights = *snapshot.load();
 
-    EVector output = forwardPass(prevSlice, curSlice);
-    previous = Maybe<TimeSlice>(curSlice);
-    return output;
+    if (weights.fixed != nullptr) {
+      weights.fixed->Process(input, *state.fixed, output);
+      return;
+    }
+
+    assert(state.layerInputs[0].size() == layers.size());
+    forwardPass(input, weights, state, output);
+
+    state.cur ^= 1;
+    state.havePrevious = true;
+  }
+
+  void ProcessBatch(const EMatrix &inputs, RNNBatchState::RNNBatchStateImpl &state,
+                    EMatrix &outputs) const {
+    assert(inputs.cols() == spec.numInputs);
+    assert(inputs.rows() == state.havePrevious.rows());
+    assert(state.layerInputs[0].size() == layers.size());
+
+    outputs.resize(inputs.rows(), spec.numOutputs);
+
+    EpochReclaimer::Guard guard(reclaimer);
+    batchForwardPass(inputs, *snapshot.load(), state, outputs);
+
+    state.cur ^= 1;
+    state.havePrevious.setOnes();
   }
 
   void Update(const vector<SliceBatch> &trace, float learnRate) {
-    cudaTrainer.Train(trace, learnRate);
+    trainer->Train(trace, learnRate);
+  }
+
+  void UpdateStaged(unsigned buffer, unsigned batchSize, unsigned traceLength, float learnRate) {
+    trainer->TrainStaged(buffer, batchSize, traceLength, learnRate);
   }
 
   void RefreshAndGetTarget(void) {
     vector<pair<LayerConnection, math::MatrixView>> weights = getHostWeights();
-    cudaTrainer.GetWeights(weights);
-    cudaTrainer.UpdateTarget();
+    trainer->GetWeights(weights);
+    publishWeights();
+    trainer->UpdateTarget();
+  }
+
+  void SetTrainingState(const vector<TrainerConnectionState> &state) {
+    trainer->SetState(state);
+
+    for (const auto &in : state) {
+      for (auto &layer : layers) {
+        for (auto &w : layer.weights) {
+          if (w.first == in.connection) {
+            w.second = in.targetWeights;
+          }
+        }
+      }
+    }
+    publishWeights();
   }
 
   vector<pair<LayerConnection, math::MatrixView>> getHostWeights(void) {
@@ -77,114 +328,237 @@ struct RNN::RNNImpl {
     return weights;
   }
 
-  EVector forwardPass(const TimeSlice *prevSlice, TimeSlice &curSlice) {
+  void buildPlan(void) {
+    auto layerIndex = [this](unsigned layerId) {
+      for (unsigned i = 0; i < layers.size(); i++) {
+        if (layers[i].layerId == layerId) {
+          return i;
+        }
+      }
+      assert(false);
+      return 0u;
+    };
+
     for (const auto &layer : layers) {
-      pair<EVector, EVector> layerOut = getLayerOutput(layer, prevSlice, curSlice);
+      LayerPlan lp;
+      lp.inputSize = 0;
+      lp.networkInputOffset = -1;
+      lp.isOutput = layer.isOutput;
+
+      for (const auto &connection : layer.weights) {
+        if (connection.first.srcLayerId == 0) { // special case for input
+          assert(connection.first.timeOffset == 0);
+          lp.networkInputOffset = lp.inputSize;
+        }
 
-      for (const auto &oc : layer.outgoing) {
-        ConnectionMemoryData *cmd = curSlice.GetConnectionData(oc);
-        assert(cmd != nullptr);
+        lp.offsets.push_back(lp.inputSize);
+        lp.inputSize += connection.second.cols() - 1; // the bias is summed separately.
+      }
 
-        cmd->activation = layerOut.first;
-        cmd->derivative = layerOut.second;
-        cmd->haveActivation = true;
+      plan.push_back(lp);
+    }
 
-        if (oc.timeOffset == 0) {
-          cmd->activation *= spec.nodeActivationRate;
+    for (unsigned li = 0; li < layers.size(); li++) {
+      for (const auto &oc : layers[li].outgoing) {
+        unsigned dst = layerIndex(oc.dstLayerId);
+
+        OutgoingConnection out;
+        out.dstLayer = dst;
+        out.offset = 0;
+        out.recurrent = oc.timeOffset != 0;
+        out.scale = out.recurrent ? 1.0f : spec.nodeActivationRate;
+
+        bool found = false;
+        for (unsigned ci = 0; ci < layers[dst].weights.size(); ci++) {
+          if (layers[dst].weights[ci].first == oc) {
+            out.offset = plan[dst].offsets[ci];
+            found = true;
+          }
         }
-      }
+        assert(found);
+        (void)found;
 
-      if (layer.isOutput) {
-        curSlice.networkOutput = layerOut.first;
+        plan[li].outgoing.push_back(out);
       }
     }
-
-    assert(curSlice.networkOutput.rows() == spec.numOutputs);
-    return curSlice.networkOutput;
   }
 
-  // Returns the output vector of the layer, and the derivative vector for the layer.
-  pair<EVector, EVector> getLayerOutput(const Layer &layer, const TimeSlice *prevSlice,
-                                        const TimeSlice &curSlice) {
-    EVector incoming(layer.numNodes);
-    incoming.fill(0.0f);
+  // Packs the layers' weights into a new snapshot and swaps it in for the current one. Never waits
+  // for inference, and must only be called from one thread at a time.
+  void publishWeights(void) {
+    auto *next = new WeightsSnapshot();
+    if (fixed != nullptr) {
+      next->fixed = fixed->NewWeights(spec, layers);
+    }
+
+    for (unsigned li = 0; li < layers.size(); li++) {
+      const Layer &layer = layers[li];
+
+      next->packed.emplace_back();
+      PackedLayer &pl = next->packed.back();
+      pl.weights = EMatrix::Zero(layer.numNodes, plan[li].inputSize);
+      pl.bias = EVector::Zero(layer.numNodes);
+      pl.recurrentBias = EVector::Zero(layer.numNodes);
 
-    for (const auto &connection : layer.weights) {
-      incrementIncomingWithConnection(connection, prevSlice, curSlice, incoming);
+      for (unsigned ci = 0; ci < layer.weights.size(); ci++) {
+        const EMatrix &weights = layer.weights[ci].second;
+        unsigned srcNodes = weights.cols() - 1;
+
+        pl.weights.middleCols(plan[li].offsets[ci], srcNodes) = weights.leftCols(srcNodes);
+        if (layer.weights[ci].first.timeOffset == 0) {
+          pl.bias += weights.col(srcNodes);
+        } else {
+          pl.recurrentBias += weights.col(srcNodes);
+        }
+      }
     }
 
-    return performLayerActivations(layer, incoming);
+    const WeightsSnapshot *previous = snapshot.exchange(next);
+    if (previous != nullptr) {
+      reclaimer.Retire(previous);
+    }
   }
 
-  void incrementIncomingWithConnection(const pair<LayerConnection, EMatrix> &connection,
-                                       const TimeSlice *prevSlice, const TimeSlice &curSlice,
-                                       EVector &incoming) {
+  void forwardPass(const EVector &input, const WeightsSnapshot &weights,
+                   RNNState::RNNStateImpl &state, EVector &output) const {
+    vector<EVector> &curInputs = state.layerInputs[state.cur];
+    vector<EVector> &nextInputs = state.layerInputs[state.cur ^ 1];
+
+    for (unsigned li = 0; li < layers.size(); li++) {
+      const LayerPlan &lp = plan[li];
+      const PackedLayer &pl = weights.packed[li];
+      EVector &sum = state.layerSums[li];
+
+      if (lp.networkInputOffset >= 0) {
+        curInputs[li].segment(lp.networkInputOffset, input.rows()) = input;
+      }
+
+      // Without a previous step the recurrent inputs are zero, only their biases need skipping.
+      sum.noalias() = pl.weights * curInputs[li];
+      sum += pl.bias;
+      if (state.havePrevious) {
+        sum += pl.recurrentBias;
+      }
 
-    if (connection.first.srcLayerId == 0) { // special case for input
-      assert(connection.first.timeOffset == 0);
-      incoming += connection.second * getInputWithBias(curSlice.networkInput);
-    } else {
-      const ConnectionMemoryData *connectionMemory = nullptr;
+      activateRows(layers[li].activation, Eigen::Map<EMatrix>(sum.data(), 1, sum.rows()));
 
-      if (connection.first.timeOffset == 0) {
-        connectionMemory = curSlice.GetConnectionData(connection.first);
-        assert(connectionMemory != nullptr);
-      } else if (prevSlice != nullptr) {
-        connectionMemory = prevSlice->GetConnectionData(connection.first);
-        assert(connectionMemory != nullptr);
+      for (const auto &oc : lp.outgoing) {
+        vector<EVector> &dst = oc.recurrent ? nextInputs : curInputs;
+        dst[oc.dstLayer].segment(oc.offset, sum.rows()).noalias() = sum * oc.scale;
       }
 
-      if (connectionMemory != nullptr) {
-        assert(connectionMemory->haveActivation);
-        incoming += connection.second * getInputWithBias(connectionMemory->activation);
+      if (lp.isOutput) {
+        output = sum;
       }
     }
   }
 
-  pair<EVector, EVector> performLayerActivations(const Layer &layer, const EVector &incoming) {
-    EVector activation(incoming.rows());
-    EVector derivatives(incoming.rows());
+  // Same as forwardPass, but for every state of a batch at once, so each layer is a single
+  // matrix-matrix product over the whole batch.
+  void batchForwardPass(const EMatrix &inputs, const WeightsSnapshot &weights,
+                        RNNBatchState::RNNBatchStateImpl &state, EMatrix &outputs) const {
+    vector<EMatrix> &curInputs = state.layerInputs[state.cur];
+    vector<EMatrix> &nextInputs = state.layerInputs[state.cur ^ 1];
 
-    if (layer.isOutput && spec.outputActivation == LayerActivation::SOFTMAX) {
-      activation = math::SoftmaxActivations(incoming);
-    } else {
-      for (int r = 0; r < activation.rows(); r++) {
-        activation(r) = ActivationValue(spec.hiddenActivation, incoming(r));
-        derivatives(r) = ActivationDerivative(spec.hiddenActivation, incoming(r), activation(r));
+    for (unsigned li = 0; li < layers.size(); li++) {
+      const LayerPlan &lp = plan[li];
+      const PackedLayer &pl = weights.packed[li];
+      EMatrix &sum = state.layerSums[li];
+
+      if (lp.networkInputOffset >= 0) {
+        curInputs[li].middleCols(lp.networkInputOffset, inputs.cols()) = inputs;
       }
-    }
 
-    return make_pair(activation, derivatives);
-  }
+      // The product is taken in blocks of rows so that Eigen's packing buffers fit within its
+      // stack allocation limit, rather than being heap allocated for large batches.
+      for (int r = 0; r < sum.rows(); r += BATCH_BLOCK_ROWS) {
+        int rows = std::min<int>(BATCH_BLOCK_ROWS, sum.rows() - r);
+        sum.middleRows(r, rows).noalias() =
+            curInputs[li].middleRows(r, rows) * pl.weights.transpose();
+      }
 
-  EVector getInputWithBias(const EVector &noBiasInput) const {
-    EVector result(noBiasInput.rows() + 1);
-    result.topRightCorner(noBiasInput.rows(), result.cols()) = noBiasInput;
-    result.bottomRightCorner(1, result.cols()).fill(1.0f);
-    return result;
+      // States without a previous step are masked from the recurrent biases.
+      sum.rowwise() += pl.bias.transpose();
+      sum.noalias() += state.havePrevious * pl.recurrentBias.transpose();
+
+      activateRows(layers[li].activation, sum);
+
+      for (const auto &oc : lp.outgoing) {
+        vector<EMatrix> &dst = oc.recurrent ? nextInputs : curInputs;
+        dst[oc.dstLayer].middleCols(oc.offset, sum.cols()).noalias() = sum * oc.scale;
+      }
+
+      if (lp.isOutput) {
+        outputs = sum;
+      }
+    }
   }
 };
 
-uptr<RNN> RNN::Read(std::istream &in) {
+uptr<RNN> RNN::Read(std::istream &in, const sptr<const FixedInference> &fixed) {
   RNNSpec spec = RNNSpec::Read(in);
-  uptr<RNN> result = make_unique<RNN>(spec);
+  uptr<RNN> result = make_unique<RNN>(spec, fixed);
   result->Read(in);
   return move(result);
 }
 
-RNN::RNN(const RNNSpec &spec) : impl(new RNNImpl(spec)) {}
+uptr<RNN> RNN::Read(const ModelCheckpoint &checkpoint, const sptr<const FixedInference> &fixed) {
+  uptr<RNN> result = make_unique<RNN>(checkpoint.Spec(), fixed);
+  result->impl->Read(checkpoint);
+  return result;
+}
+
+RNN::RNN(const RNNSpec &spec, const sptr<const FixedInference> &fixed)
+    : impl(new RNNImpl(spec, fixed)) {}
 RNN::~RNN() = default;
 
 void RNN::Write(std::ostream &out) const { impl->Write(out); }
 
+void RNN::WriteCheckpoint(const string &path) const { impl->WriteCheckpoint(path); }
+
 RNNSpec RNN::GetSpec(void) const { return impl->spec; }
 
-void RNN::ClearMemory(void) { impl->ClearMemory(); }
+uptr<RNNState> RNN::NewState(void) const { return uptr<RNNState>(new RNNState(impl->NewState())); }
 
-EVector RNN::Process(const EVector &input) { return impl->Process(input); }
+EVector RNN::Process(const EVector &input, RNNState &state) const {
+  EVector output(impl->spec.numOutputs);
+  impl->Process(input, *state.impl, output);
+  return output;
+}
+
+void RNN::Process(const EVector &input, RNNState &state, EVector &outOutput) const {
+  impl->Process(input, *state.impl, outOutput);
+}
+
+uptr<RNNBatchState> RNN::NewBatchState(unsigned numStates) const {
+  return uptr<RNNBatchState>(new RNNBatchState(impl->NewBatchState(numStates)));
+}
+
+void RNN::ProcessBatch(const EMatrix &inputs, RNNBatchState &states, EMatrix &outOutputs) const {
+  impl->ProcessBatch(inputs, *states.impl, outOutputs);
+}
 
 void RNN::Update(const vector<SliceBatch> &trace, float learnRate) {
   impl->Update(trace, learnRate);
 }
 
+vector<SliceBatch> &RNN::TrainingStaging(unsigned buffer) {
+  return impl->trainer->Staging(buffer);
+}
+
+void RNN::UpdateStaged(unsigned buffer, unsigned batchSize, unsigned traceLength,
+                       float learnRate) {
+  impl->UpdateStaged(buffer, batchSize, traceLength, learnRate);
+}
+
+const EVector &RNN::TraceErrors(void) const { return impl->trainer->TraceErrors(); }
+
 void RNN::RefreshAndGetTarget(void) { impl->RefreshAndGetTarget(); }
+
+void RNN::GetTrainingState(vector<TrainerConnectionState> &outState) {
+  impl->trainer->GetState(outState);
+}
+
+void RNN::SetTrainingState(const vector<TrainerConnectionState> &state) {
+  impl->SetTrainingState(state);
+}
@@ -3,31 +3,114 @@
 
 #include "../common/Common.hpp"
 #include "../math/Math.hpp"
+#include "NetworkTrainer.hpp"
 #include "RNNSpec.hpp"
 #include "SliceBatch.hpp"
 #include <iostream>
 
 namespace rnn {
 
+class FixedInference;
+class ModelCheckpoint;
+
+// Recurrent memory for stepping an RNN one input at a time, along with the scratch space that
+// needs. It is owned by the caller rather than the network, so any number of threads can step the
+// same network concurrently, each with its own state. Created by RNN::NewState, and only valid for
+// that network.
+class RNNState {
+public:
+  ~RNNState();
+
+  RNNState(const RNNState &) = delete;
+  RNNState &operator=(const RNNState &) = delete;
+
+  // Forgets all previous steps, as at the start of an episode.
+  void Clear(void);
+
+private:
+  friend class RNN;
+  struct RNNStateImpl;
+  uptr<RNNStateImpl> impl;
+
+  RNNState(RNNStateImpl *impl);
+};
+
+// As above, for a fixed number of independent states that are stepped together by
+// RNN::ProcessBatch, for example one per car. Created by RNN::NewBatchState.
+class RNNBatchState {
+public:
+  ~RNNBatchState();
+
+  RNNBatchState(const RNNBatchState &) = delete;
+  RNNBatchState &operator=(const RNNBatchState &) = delete;
+
+  unsigned NumStates(void) const;
+
+  void Clear(unsigned index);
+  void ClearAll(void);
+
+private:
+  friend class RNN;
+  struct RNNBatchStateImpl;
+  uptr<RNNBatchStateImpl> impl;
+
+  RNNBatchState(RNNBatchStateImpl *impl);
+};
+
 class RNN {
 public:
-  RNN(const RNNSpec &spec);
+  // Single step inference runs on fixed if it matches the spec, otherwise fixed is ignored.
+  RNN(const RNNSpec &spec, const sptr<const FixedInference> &fixed = nullptr);
   virtual ~RNN();
 
   RNN(const RNN &) = delete;
   RNN &operator=(const RNN &) = delete;
 
-  static uptr<RNN> Read(std::istream &in);
+  static uptr<RNN> Read(std::istream &in, const sptr<const FixedInference> &fixed = nullptr);
   void Write(std::ostream &out) const;
 
+  // Binary checkpoints (see ModelCheckpoint), which keep the weights exactly and load with no
+  // parsing. The checkpoint's spec has the default trainerBackend.
+  static uptr<RNN> Read(const ModelCheckpoint &checkpoint,
+                        const sptr<const FixedInference> &fixed = nullptr);
+  void WriteCheckpoint(const string &path) const;
+
   RNNSpec GetSpec(void) const;
 
-  void ClearMemory(void);
-  EVector Process(const EVector &input);
+  // Inference may run concurrently from several threads as long as each uses its own state, and
+  // never waits. A step reads an immutable snapshot of the weights, and the calls that change the
+  // weights (Read, RefreshAndGetTarget, SetTrainingState) publish a new snapshot with an atomic
+  // swap, which steps pick up as they start.
+  uptr<RNNState> NewState(void) const;
+  EVector Process(const EVector &input, RNNState &state) const;
+
+  // Same as above, but writes into outOutput. Does no heap allocation once outOutput has
+  // GetSpec().numOutputs rows.
+  void Process(const EVector &input, RNNState &state, EVector &outOutput) const;
+
+  // Steps state i with inputs.row(i) for each of the states, writing the network output for that
+  // state into outOutputs.row(i). inputs must have a row for every state.
+  uptr<RNNBatchState> NewBatchState(unsigned numStates) const;
+  void ProcessBatch(const EMatrix &inputs, RNNBatchState &states, EMatrix &outOutputs) const;
 
   void Update(const vector<SliceBatch> &trace, float learnRate);
+
+  // The trainer's reusable input slices (see NetworkTrainer::Staging). Filling them in place and
+  // calling UpdateStaged trains without allocating or copying the trace. There are
+  // NetworkTrainer::NUM_STAGING_BUFFERS of them, so one can be filled while another is trained on.
+  vector<SliceBatch> &TrainingStaging(unsigned buffer);
+  void UpdateStaged(unsigned buffer, unsigned batchSize, unsigned traceLength, float learnRate);
+
+  // Per batch element TD errors of the last update (see NetworkTrainer::TraceErrors).
+  const EVector &TraceErrors(void) const;
   void RefreshAndGetTarget(void);
 
+  // The trainer's complete state, for checkpointing training (see NetworkTrainer::GetState). The
+  // inference weights are always those of the target network, so SetTrainingState sets them to
+  // the restored target weights. Neither may run concurrently with training.
+  void GetTrainingState(vector<TrainerConnectionState> &outState);
+  void SetTrainingState(const vector<TrainerConnectionState> &state);
+
 private:
   struct RNNImpl;
   uptr<RNNImpl> impl;
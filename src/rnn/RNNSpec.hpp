@@ -9,6 +9,11 @@ using namespace std;
 
 namespace rnn {
 
+// Which backend performs the training updates. AUTO picks CUDA if a device is present, and falls
+// back to the multithreaded CPU trainer otherwise. CUDA_HOST runs the CudaTrainer's tasks on the
+// host with a HostTaskExecutor, as a reference for the device results.
+enum class TrainerBackend { AUTO, CUDA, CUDA_HOST, CPU };
+
 struct RNNSpec {
   unsigned numInputs;
   unsigned numOutputs;
@@ -22,6 +27,9 @@ struct RNNSpec {
   unsigned maxBatchSize;
   unsigned maxTraceLength;
 
+  // Runtime choice rather than a property of the network, so it is not serialized.
+  TrainerBackend trainerBackend = TrainerBackend::AUTO;
+
   // Helper function.
   unsigned LayerSize(unsigned layerId) const {
     if (layerId == 0) {
@@ -1,15 +1,81 @@
 #pragma once
 
 #include "../math/Math.hpp"
+#include <cstddef>
+#include <new>
+#include <vector>
 
 namespace rnn {
 
+// One timestep of a training batch. The matrices are views of a single block of floats, which is
+// either owned by the slice or given by the caller, so that a trainer can place a whole staging
+// buffer in one pinned allocation.
 struct SliceBatch {
-  EMatrix batchInput; // row-vectors, one per batch element.
-  EMatrix batchActions; // one hot encoding
-  EMatrix batchRewards;
+  Eigen::Map<EMatrix> batchInput;   // row-vectors, one per batch element.
+  Eigen::Map<EMatrix> batchActions; // one hot encoding
+  Eigen::Map<EMatrix> batchRewards;
+  Eigen::Map<EMatrix> batchWeights; // importance sampling weight scaling each batch element's error.
 
   SliceBatch(const EMatrix &batchInput, const EMatrix &batchActions, const EMatrix &batchRewards)
-      : batchInput(batchInput), batchActions(batchActions), batchRewards(batchRewards) {}
+      : SliceBatch(batchInput.rows(), batchInput.cols(), batchActions.cols()) {
+    assert(batchActions.rows() == batchInput.rows());
+    assert(batchRewards.rows() == batchInput.rows() && batchRewards.cols() == 1);
+    this->batchInput = batchInput;
+    this->batchActions = batchActions;
+    this->batchRewards = batchRewards;
+  }
+
+  // Zeroed slice with room for batchSize rows, all weighted 1.
+  SliceBatch(unsigned batchSize, unsigned numInputs, unsigned numOutputs)
+      : SliceBatch(batchSize, numInputs, numOutputs, nullptr) {}
+
+  // Same as above, but the matrices are placed in buffer, which must hold BufferSize floats and
+  // outlive the slice.
+  SliceBatch(unsigned batchSize, unsigned numInputs, unsigned numOutputs, float *buffer)
+      : batchInput(nullptr, 0, 0), batchActions(nullptr, 0, 0), batchRewards(nullptr, 0, 0),
+        batchWeights(nullptr, 0, 0) {
+    if (buffer == nullptr) {
+      storage.resize(BufferSize(batchSize, numInputs, numOutputs));
+      buffer = storage.data();
+    }
+    place(batchSize, numInputs, numOutputs, buffer);
+
+    batchInput.setZero();
+    batchActions.setZero();
+    batchRewards.setZero();
+    batchWeights.setOnes();
+  }
+
+  // A copy always owns its matrices.
+  SliceBatch(const SliceBatch &other)
+      : batchInput(nullptr, 0, 0), batchActions(nullptr, 0, 0), batchRewards(nullptr, 0, 0),
+        batchWeights(nullptr, 0, 0),
+        storage(other.batchInput.data(),
+                other.batchInput.data() + BufferSize(other.batchInput.rows(),
+                                                     other.batchInput.cols(),
+                                                     other.batchActions.cols())) {
+    place(other.batchInput.rows(), other.batchInput.cols(), other.batchActions.cols(),
+          storage.data());
+  }
+
+  SliceBatch &operator=(const SliceBatch &) = delete;
+
+  // Number of floats that a slice of this shape occupies.
+  static size_t BufferSize(unsigned batchSize, unsigned numInputs, unsigned numOutputs) {
+    return static_cast<size_t>(batchSize) * (numInputs + numOutputs + 2);
+  }
+
+private:
+  std::vector<float> storage; // empty if the matrices are in a caller's buffer.
+
+  void place(unsigned batchSize, unsigned numInputs, unsigned numOutputs, float *buffer) {
+    new (&batchInput) Eigen::Map<EMatrix>(buffer, batchSize, numInputs);
+    buffer += batchSize * numInputs;
+    new (&batchActions) Eigen::Map<EMatrix>(buffer, batchSize, numOutputs);
+    buffer += batchSize * numOutputs;
+    new (&batchRewards) Eigen::Map<EMatrix>(buffer, batchSize, 1);
+    buffer += batchSize;
+    new (&batchWeights) Eigen::Map<EMatrix>(buffer, batchSize, 1);
+  }
 };
 }
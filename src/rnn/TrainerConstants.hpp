@@ -0,0 +1,12 @@
+#pragma once
+
+namespace rnn {
+
+// Hyperparameters shared by all of the training backends, so they produce identical updates.
+constexpr float ADAM_BETA1 = 0.9f;
+constexpr float ADAM_BETA2 = 0.999f;
+constexpr float ADAM_LR = 0.001f;
+constexpr float ADAM_EPSILON = 10e-8;
+
+constexpr float TARGET_DISCOUNT_FACTOR = 0.9f;
+}
@@ -1,23 +1,22 @@
 
 #include "CuAdamState.hpp"
-#include "kernels/MatrixFillKernel.cuh"
 #include <cassert>
 
 using namespace rnn;
 using namespace rnn::cuda;
 
-CuAdamState::CuAdamState(const RNNSpec &spec) {
+CuAdamState::CuAdamState(const RNNSpec &spec, const MatrixAllocator &allocator) {
   allConnections.reserve(spec.connections.size());
   for (const auto &connection : spec.connections) {
     unsigned inputSize = spec.LayerSize(connection.srcLayerId) + 1;
     unsigned layerSize = spec.LayerSize(connection.dstLayerId);
-    allConnections.emplace_back(connection, layerSize, inputSize);
+    allConnections.emplace_back(connection, layerSize, inputSize, allocator);
   }
 }
 
-void CuAdamState::Cleanup(void) {
+void CuAdamState::Cleanup(const MatrixAllocator &allocator) {
   for (auto &c : allConnections) {
-    c.Cleanup();
+    c.Cleanup(allocator);
   }
 }
 
@@ -31,10 +30,3 @@ CuAdamConnection *CuAdamState::GetConnection(const LayerConnection &connection)
   assert(false);
   return nullptr;
 }
-
-void CuAdamState::Clear(void) {
-  for (auto &c : allConnections) {
-    MatrixFillKernel::Apply(c.momentum, 0.0f, 0);
-    MatrixFillKernel::Apply(c.rms, 0.0f, 0);
-  }
-}
@@ -3,7 +3,6 @@
 #include "../LayerDef.hpp"
 #include "../RNNSpec.hpp"
 #include "Types.hpp"
-#include "Util.hpp"
 #include <cassert>
 #include <vector>
 
@@ -18,24 +17,24 @@ struct CuAdamConnection {
   CuMatrix momentum;
   CuMatrix rms;
 
-  CuAdamConnection(const LayerConnection &connection, unsigned rows, unsigned cols)
-      : connection(connection), momentum(util::AllocMatrix(rows, cols)),
-        rms(util::AllocMatrix(rows, cols)) {}
+  CuAdamConnection(const LayerConnection &connection, unsigned rows, unsigned cols,
+                   const MatrixAllocator &allocator)
+      : connection(connection), momentum(allocator.allocMatrix(rows, cols)),
+        rms(allocator.allocMatrix(rows, cols)) {}
 
-  void Cleanup(void) {
-    util::FreeMatrix(momentum);
-    util::FreeMatrix(rms);
+  void Cleanup(const MatrixAllocator &allocator) {
+    allocator.freeMatrix(momentum);
+    allocator.freeMatrix(rms);
   }
 };
 
 struct CuAdamState {
   vector<CuAdamConnection> allConnections;
 
-  CuAdamState(const RNNSpec &spec);
-  void Cleanup(void);
+  CuAdamState(const RNNSpec &spec, const MatrixAllocator &allocator);
+  void Cleanup(const MatrixAllocator &allocator);
 
   CuAdamConnection *GetConnection(const LayerConnection &connection);
-  void Clear(void);
 };
 }
 }
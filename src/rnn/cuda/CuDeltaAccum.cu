@@ -1,26 +1,27 @@
 
 #include "CuDeltaAccum.hpp"
-#include "kernels/MatrixFillKernel.cuh"
 #include <cassert>
 
 using namespace rnn;
 using namespace rnn::cuda;
 
-CuDeltaAccum::CuDeltaAccum(const RNNSpec &spec, unsigned maxTraceLength) {
+CuDeltaAccum::CuDeltaAccum(const RNNSpec &spec, unsigned maxTraceLength,
+                           const MatrixAllocator &allocator) {
 
   assert(maxTraceLength > 0);
 
   allDeltaAccum.reserve(maxTraceLength * spec.layers.size());
   for (int timestamp = 0; timestamp < maxTraceLength; timestamp++) {
     for (const auto &layer : spec.layers) {
-      allDeltaAccum.emplace_back(layer.uid, timestamp, spec.maxBatchSize, layer.numNodes);
+      allDeltaAccum.emplace_back(layer.uid, timestamp, spec.maxBatchSize, layer.numNodes,
+                                 allocator);
     }
   }
 }
 
-void CuDeltaAccum::Cleanup(void) {
+void CuDeltaAccum::Cleanup(const MatrixAllocator &allocator) {
   for (auto &da : allDeltaAccum) {
-    da.Cleanup();
+    da.Cleanup(allocator);
   }
 }
 
@@ -34,10 +35,3 @@ CuLayerAccum *CuDeltaAccum::GetDelta(unsigned layerId, int timestamp) {
   assert(false);
   return nullptr;
 }
-
-void CuDeltaAccum::Clear(void) {
-  for (auto &da : allDeltaAccum) {
-    da.samples = 0;
-    MatrixFillKernel::Apply(da.accumDelta, 0.0f, 0);
-  }
-}
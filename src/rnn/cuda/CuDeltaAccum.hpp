@@ -3,7 +3,6 @@
 #include "../LayerDef.hpp"
 #include "../RNNSpec.hpp"
 #include "Types.hpp"
-#include "Util.hpp"
 #include <cassert>
 #include <vector>
 
@@ -19,21 +18,21 @@ struct CuLayerAccum {
   unsigned samples;
   CuMatrix accumDelta;
 
-  CuLayerAccum(unsigned layerId, int timestamp, unsigned deltaRows, unsigned deltaCols)
+  CuLayerAccum(unsigned layerId, int timestamp, unsigned deltaRows, unsigned deltaCols,
+               const MatrixAllocator &allocator)
       : layerId(layerId), timestamp(timestamp), samples(0),
-        accumDelta(util::AllocMatrix(deltaRows, deltaCols)) {}
+        accumDelta(allocator.allocMatrix(deltaRows, deltaCols)) {}
 
-  void Cleanup(void) { util::FreeMatrix(accumDelta); }
+  void Cleanup(const MatrixAllocator &allocator) { allocator.freeMatrix(accumDelta); }
 };
 
 struct CuDeltaAccum {
   vector<CuLayerAccum> allDeltaAccum;
 
-  CuDeltaAccum(const RNNSpec &spec, unsigned maxTraceLength);
-  void Cleanup(void);
+  CuDeltaAccum(const RNNSpec &spec, unsigned maxTraceLength, const MatrixAllocator &allocator);
+  void Cleanup(const MatrixAllocator &allocator);
 
   CuLayerAccum *GetDelta(unsigned layerId, int timestamp);
-  void Clear(void);
 };
 }
 }
@@ -1,23 +1,22 @@
 
 #include "CuGradientAccum.hpp"
-#include "kernels/MatrixFillKernel.cuh"
 #include <cassert>
 
 using namespace rnn;
 using namespace rnn::cuda;
 
-CuGradientAccum::CuGradientAccum(const RNNSpec &spec) {
+CuGradientAccum::CuGradientAccum(const RNNSpec &spec, const MatrixAllocator &allocator) {
   allWeightsAccum.reserve(spec.connections.size());
   for (const auto &connection : spec.connections) {
     unsigned inputSize = spec.LayerSize(connection.srcLayerId) + 1;
     unsigned layerSize = spec.LayerSize(connection.dstLayerId);
-    allWeightsAccum.emplace_back(connection, layerSize, inputSize);
+    allWeightsAccum.emplace_back(connection, layerSize, inputSize, allocator);
   }
 }
 
-void CuGradientAccum::Cleanup(void) {
+void CuGradientAccum::Cleanup(const MatrixAllocator &allocator) {
   for (auto &wa : allWeightsAccum) {
-    wa.Cleanup();
+    wa.Cleanup(allocator);
   }
 }
 
@@ -31,10 +30,3 @@ CuConnectionAccum *CuGradientAccum::GetConnection(const LayerConnection &connect
   assert(false);
   return nullptr;
 }
-
-void CuGradientAccum::Clear(void) {
-  for (auto &wa : allWeightsAccum) {
-    wa.samples = 0;
-    MatrixFillKernel::Apply(wa.accumGradient, 0.0f, 0);
-  }
-}
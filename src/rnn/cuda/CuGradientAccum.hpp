@@ -3,7 +3,6 @@
 #include "../LayerDef.hpp"
 #include "../RNNSpec.hpp"
 #include "Types.hpp"
-#include "Util.hpp"
 #include <cassert>
 #include <vector>
 
@@ -18,20 +17,21 @@ struct CuConnectionAccum {
   unsigned samples;
   CuMatrix accumGradient;
 
-  CuConnectionAccum(const LayerConnection &connection, unsigned connRows, unsigned connCols)
-      : connection(connection), samples(0), accumGradient(util::AllocMatrix(connRows, connCols)) {}
+  CuConnectionAccum(const LayerConnection &connection, unsigned connRows, unsigned connCols,
+                    const MatrixAllocator &allocator)
+      : connection(connection), samples(0),
+        accumGradient(allocator.allocMatrix(connRows, connCols)) {}
 
-  void Cleanup(void) { util::FreeMatrix(accumGradient); }
+  void Cleanup(const MatrixAllocator &allocator) { allocator.freeMatrix(accumGradient); }
 };
 
 struct CuGradientAccum {
   vector<CuConnectionAccum> allWeightsAccum;
 
-  CuGradientAccum(const RNNSpec &spec);
-  void Cleanup(void);
+  CuGradientAccum(const RNNSpec &spec, const MatrixAllocator &allocator);
+  void Cleanup(const MatrixAllocator &allocator);
 
   CuConnectionAccum *GetConnection(const LayerConnection &connection);
-  void Clear(void);
 };
 }
 }
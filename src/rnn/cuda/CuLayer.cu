@@ -1,13 +1,13 @@
 
 #include "CuLayer.hpp"
-#include "Util.hpp"
 #include <cassert>
 #include <iostream>
 
 using namespace rnn;
 using namespace rnn::cuda;
 
-CuLayer::CuLayer(const RNNSpec &nnSpec, const LayerSpec &layerSpec)
+CuLayer::CuLayer(const RNNSpec &nnSpec, const LayerSpec &layerSpec,
+                 const MatrixAllocator &allocator)
     : layerId(layerSpec.uid),
       activation(layerSpec.isOutput ? nnSpec.outputActivation : nnSpec.hiddenActivation),
       numNodes(layerSpec.numNodes), isOutput(layerSpec.isOutput) {
@@ -24,8 +24,8 @@ CuLayer::CuLayer(const RNNSpec &nnSpec, const LayerSpec &layerSpec)
     if (lc.dstLayerId == layerId) {
       // +1 accounts for the bias.
       unsigned inputSize = nnSpec.LayerSize(lc.srcLayerId) + 1;
-      CuMatrix weights = util::AllocMatrix(numNodes, inputSize);
-      CuMatrix weightsT = util::AllocMatrix(inputSize, numNodes);
+      CuMatrix weights = allocator.allocMatrix(numNodes, inputSize);
+      CuMatrix weightsT = allocator.allocMatrix(inputSize, numNodes);
       incoming.emplace_back(lc, CuWeights(weights, weightsT));
     }
 
@@ -35,10 +35,10 @@ CuLayer::CuLayer(const RNNSpec &nnSpec, const LayerSpec &layerSpec)
   }
 }
 
-void CuLayer::Cleanup(void) {
+void CuLayer::Cleanup(const MatrixAllocator &allocator) {
   for (auto& ic : incoming) {
-    util::FreeMatrix(ic.second.weights);
-    util::FreeMatrix(ic.second.weightsT);
+    allocator.freeMatrix(ic.second.weights);
+    allocator.freeMatrix(ic.second.weightsT);
   }
 }
 
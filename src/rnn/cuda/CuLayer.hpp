@@ -35,8 +35,8 @@ struct CuLayer {
   vector<pair<LayerConnection, CuWeights>> incoming;
   vector<LayerConnection> outgoing;
 
-  CuLayer(const RNNSpec &nnSpec, const LayerSpec &layerSpec);
-  void Cleanup(void);
+  CuLayer(const RNNSpec &nnSpec, const LayerSpec &layerSpec, const MatrixAllocator &allocator);
+  void Cleanup(const MatrixAllocator &allocator);
 
   CuWeights *GetWeights(const LayerConnection &connection);
 };
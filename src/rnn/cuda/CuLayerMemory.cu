@@ -5,18 +5,19 @@
 using namespace rnn;
 using namespace rnn::cuda;
 
-CuLayerMemory::CuLayerMemory(const RNNSpec &spec, unsigned maxTraceLength) {
+CuLayerMemory::CuLayerMemory(const RNNSpec &spec, unsigned maxTraceLength,
+                             const MatrixAllocator &allocator) {
   assert(maxTraceLength > 0);
 
   memory.reserve(maxTraceLength);
   for (int timestamp = 0; timestamp < maxTraceLength; timestamp++) {
-    memory.emplace_back(spec, timestamp);
+    memory.emplace_back(spec, timestamp, allocator);
   }
 }
 
-void CuLayerMemory::Cleanup(void) {
+void CuLayerMemory::Cleanup(const MatrixAllocator &allocator) {
   for (auto &ts : memory) {
-    ts.Cleanup();
+    ts.Cleanup(allocator);
   }
 }
 
@@ -29,9 +30,3 @@ CuTimeSlice *CuLayerMemory::GetTimeSlice(int timestamp) {
 
   return nullptr;
 }
-
-void CuLayerMemory::Clear(void) {
-  for (auto &ts : memory) {
-    ts.Clear();
-  }
-}
@@ -11,11 +11,10 @@ namespace cuda {
 
 class CuLayerMemory {
 public:
-  CuLayerMemory(const RNNSpec &spec, unsigned maxTraceLength);
-  void Cleanup(void);
+  CuLayerMemory(const RNNSpec &spec, unsigned maxTraceLength, const MatrixAllocator &allocator);
+  void Cleanup(const MatrixAllocator &allocator);
 
   CuTimeSlice *GetTimeSlice(int timestamp);
-  void Clear(void);
 
 private:
   vector<CuTimeSlice> memory;
@@ -1,32 +1,32 @@
 
 #include "CuTimeSlice.hpp"
-#include "kernels/MatrixFillKernel.cuh"
-#include "kernels/InitialiseOutputKernel.cuh"
 #include <cassert>
 
 using namespace rnn;
 using namespace rnn::cuda;
 
-CuTimeSlice::CuTimeSlice(const RNNSpec &spec, int timestamp)
+CuTimeSlice::CuTimeSlice(const RNNSpec &spec, int timestamp, const MatrixAllocator &allocator)
     : timestamp(timestamp),
-      networkOutput(LayerConnection(0, 0, 0), spec.maxBatchSize, spec.numOutputs + 1),
-      actionsMask(util::AllocMatrix(spec.maxBatchSize, spec.numOutputs)),
-      rewards(util::AllocMatrix(spec.maxBatchSize, 1)) {
+      networkOutput(LayerConnection(0, 0, 0), spec.maxBatchSize, spec.numOutputs + 1, allocator),
+      actionsMask(allocator.allocMatrix(spec.maxBatchSize, spec.numOutputs)),
+      rewards(allocator.allocMatrix(spec.maxBatchSize, 1)),
+      weights(allocator.allocMatrix(spec.maxBatchSize, 1)) {
 
   assert(timestamp >= 0);
   for (const auto &connection : spec.connections) {
     unsigned connectionCols = spec.LayerSize(connection.srcLayerId) + 1;
-    connectionData.emplace_back(connection, spec.maxBatchSize, connectionCols);
+    connectionData.emplace_back(connection, spec.maxBatchSize, connectionCols, allocator);
   }
 }
 
-void CuTimeSlice::Cleanup(void) {
-  util::FreeMatrix(actionsMask);
-  util::FreeMatrix(rewards);
+void CuTimeSlice::Cleanup(const MatrixAllocator &allocator) {
+  allocator.freeMatrix(actionsMask);
+  allocator.freeMatrix(rewards);
+  allocator.freeMatrix(weights);
   
-  networkOutput.Cleanup();
+  networkOutput.Cleanup(allocator);
   for (auto &cd : connectionData) {
-    cd.Cleanup();
+    cd.Cleanup(allocator);
   }
 }
 
@@ -40,16 +40,3 @@ CuConnectionMemoryData *CuTimeSlice::GetConnectionData(const LayerConnection &co
   assert(false);
   return nullptr;
 }
-
-void CuTimeSlice::Clear(void) {
-  networkOutput.haveActivation = false;
-  MatrixFillKernel::Apply(networkOutput.activation, 0.0f, 0);
-  MatrixFillKernel::Apply(networkOutput.derivative, 0.0f, 0);
-
-  for (auto &cd : connectionData) {
-    cd.haveActivation = false;
-    MatrixFillKernel::Apply(cd.activation, 0.0f, 0);
-    MatrixFillKernel::Apply(cd.derivative, 0.0f, 0);
-    InitialiseOutputKernel::Apply(cd.activation, 0);
-  }
-}
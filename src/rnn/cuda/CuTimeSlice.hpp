@@ -3,7 +3,6 @@
 #include "../LayerDef.hpp"
 #include "../RNNSpec.hpp"
 #include "Types.hpp"
-#include "Util.hpp"
 #include <cassert>
 #include <utility>
 #include <vector>
@@ -20,13 +19,15 @@ struct CuConnectionMemoryData {
   CuMatrix activation; // batch output, row per batch element.
   CuMatrix derivative;
 
-  CuConnectionMemoryData(const LayerConnection &connection, unsigned rows, unsigned cols)
-      : connection(connection), haveActivation(false), activation(util::AllocMatrix(rows, cols)),
-        derivative(util::AllocMatrix(rows, cols)) {}
+  CuConnectionMemoryData(const LayerConnection &connection, unsigned rows, unsigned cols,
+                         const MatrixAllocator &allocator)
+      : connection(connection), haveActivation(false),
+        activation(allocator.allocMatrix(rows, cols)),
+        derivative(allocator.allocMatrix(rows, cols)) {}
 
-  void Cleanup(void) {
-    util::FreeMatrix(activation);
-    util::FreeMatrix(derivative);
+  void Cleanup(const MatrixAllocator &allocator) {
+    allocator.freeMatrix(activation);
+    allocator.freeMatrix(derivative);
   }
 };
 
@@ -35,14 +36,14 @@ struct CuTimeSlice {
   CuConnectionMemoryData networkOutput;
   CuMatrix actionsMask;
   CuMatrix rewards;
+  CuMatrix weights;
 
   vector<CuConnectionMemoryData> connectionData;
 
-  CuTimeSlice(const RNNSpec &spec, int timestamp);
-  void Cleanup(void);
+  CuTimeSlice(const RNNSpec &spec, int timestamp, const MatrixAllocator &allocator);
+  void Cleanup(const MatrixAllocator &allocator);
 
   CuConnectionMemoryData *GetConnectionData(const LayerConnection &connection);
-  void Clear(void);
 };
 }
 }
@@ -0,0 +1,256 @@
+#include "HostTaskExecutor.hpp"
+#include "../../math/Math.hpp"
+#include "../Activations.hpp"
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+using namespace rnn;
+using namespace rnn::cuda;
+
+static constexpr size_t ROW_ALIGNMENT = 64;
+
+// A view of a pitched CuMatrix as an Eigen matrix, so the Eigen kernels (which use AVX2/AVX-512 when
+// compiled for them) can operate directly on the pitched buffer.
+typedef Eigen::Map<EMatrix, Eigen::Unaligned, Eigen::OuterStride<>> PitchedMap;
+typedef Eigen::Map<EMatrix> DenseMap;
+
+static PitchedMap pitched(const CuMatrix &m) {
+  assert(m.pitch % sizeof(float) == 0);
+  return PitchedMap(m.data, m.rows, m.cols, Eigen::OuterStride<>(m.pitch / sizeof(float)));
+}
+
+static DenseMap dense(const math::MatrixView &m) { return DenseMap(m.data, m.rows, m.cols); }
+
+CuMatrix host::AllocMatrix(unsigned rows, unsigned cols) {
+  assert(rows > 0 && cols > 0);
+
+  CuMatrix result;
+  result.rows = rows;
+  result.cols = cols;
+  result.pitch = ((cols * sizeof(float) + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT) * ROW_ALIGNMENT;
+
+  void *buf = nullptr;
+  int err = posix_memalign(&buf, ROW_ALIGNMENT, result.pitch * rows);
+  assert(err == 0 && buf != nullptr);
+  (void)err;
+
+  memset(buf, 0, result.pitch * rows);
+  result.data = static_cast<float *>(buf);
+  return result;
+}
+
+void host::FreeMatrix(CuMatrix &m) {
+  assert(m.data != nullptr);
+  free(m.data);
+  m.data = nullptr;
+}
+
+static void layerActivation(const ConnectionActivation &layer, LayerActivation activation) {
+  // The last column is the bias and is not activated.
+  auto values = pitched(layer.activation).topLeftCorner(layer.batchSize, layer.activation.cols - 1);
+  auto derivatives =
+      pitched(layer.derivative).topLeftCorner(layer.batchSize, layer.derivative.cols - 1);
+
+  switch (activation) {
+  case LayerActivation::SOFTMAX:
+    // Matches the GPU kernel, which leaves the derivative untouched.
+    for (int r = 0; r < values.rows(); r++) {
+      float maxVal = values.row(r).maxCoeff();
+      values.row(r) = (values.row(r).array() - maxVal).exp().matrix();
+      values.row(r) /= values.row(r).sum();
+    }
+    return;
+  case LayerActivation::TANH:
+    values = values.array().tanh().matrix();
+    derivatives = (1.0f - values.array().square()).matrix();
+    return;
+  case LayerActivation::LINEAR:
+    derivatives.fill(1.0f);
+    return;
+  default:
+    for (int r = 0; r < values.rows(); r++) {
+      for (int c = 0; c < values.cols(); c++) {
+        float in = values(r, c);
+        values(r, c) = ActivationValue(activation, in);
+        derivatives(r, c) = ActivationDerivative(activation, in, values(r, c));
+      }
+    }
+    return;
+  }
+}
+
+static void errorMeasure(const ErrorMeasureData &data) {
+  const LayerBatchDeltas &out = data.outputLayer;
+  assert(data.networkOutput.activation.cols == data.targetOutput.value.cols + 1);
+  assert(out.delta.cols == data.targetOutput.value.cols);
+
+  unsigned rows = out.batchSize;
+  unsigned cols = out.delta.cols;
+
+  auto delta = pitched(out.delta).topLeftCorner(rows, cols);
+  delta = pitched(data.deltaMask)
+              .topLeftCorner(rows, cols)
+              .cwiseProduct(pitched(data.networkOutput.activation).topLeftCorner(rows, cols) -
+                            pitched(data.targetOutput.value).topLeftCorner(rows, cols));
+  delta.array().colwise() *= pitched(data.rowWeights).topRows(rows).col(0).array();
+}
+
+// outDelta += (nextDelta * transposedWeights^T) .* connection.derivative, ignoring the bias row of
+// the transposed weights.
+static void propagateDelta(const PropagateDeltaData &data) {
+  const LayerBatchDeltas &out = data.outDelta;
+  assert(data.nextDelta.delta.cols == data.transposedWeights.cols);
+  assert(out.delta.cols == data.transposedWeights.rows - 1);
+  assert(data.nextDelta.batchSize == out.batchSize);
+
+  unsigned rows = out.batchSize;
+  unsigned cols = out.delta.cols;
+
+  auto nextDelta = pitched(data.nextDelta.delta).topRows(rows);
+  auto tw = pitched(data.transposedWeights).topRows(cols);
+
+  pitched(out.delta).topLeftCorner(rows, cols) +=
+      (nextDelta * tw.transpose())
+          .cwiseProduct(pitched(data.connection.derivative).topLeftCorner(rows, cols));
+}
+
+// outGradient += layerDeltas^T * connection.activation, summed over the batch.
+static void gradientIncrement(const GradientIncrementData &data) {
+  assert(data.layerDeltas.batchSize == data.connection.batchSize);
+  assert(data.layerDeltas.delta.cols == data.outGradient.rows);
+  assert(data.connection.activation.cols == data.outGradient.cols);
+
+  unsigned batchSize = data.layerDeltas.batchSize;
+  pitched(data.outGradient).noalias() +=
+      pitched(data.layerDeltas.delta).topRows(batchSize).transpose() *
+      pitched(data.connection.activation).topRows(batchSize);
+}
+
+// output += input * layerWeights^T, skipping the bias column of the output.
+static void forwardIncrement(const ForwardIncrementData &data) {
+  assert(data.layerWeights.cols == data.input.activation.cols);
+  assert(data.layerWeights.rows == data.output.cols - 1);
+  assert(data.input.batchSize <= data.output.rows);
+
+  unsigned rows = data.input.batchSize;
+  pitched(data.output).topLeftCorner(rows, data.output.cols - 1).noalias() +=
+      pitched(data.input.activation).topRows(rows) * pitched(data.layerWeights).transpose();
+}
+
+// outputs[0] = activation(sum of input * weights^T over the inputs), then copied to the other
+// outputs, skipping their bias columns.
+static void forwardLayer(const ForwardLayerData &data) {
+  const ConnectionActivation &out = data.outputs[0];
+  unsigned rows = data.batchSize;
+  unsigned cols = out.activation.cols - 1;
+
+  auto sum = pitched(out.activation).topLeftCorner(rows, cols);
+  sum.noalias() = pitched(data.inputs[0].activation).topRows(rows) *
+                  pitched(data.inputs[0].weights).transpose();
+  for (unsigned i = 1; i < data.numInputs; i++) {
+    sum.noalias() += pitched(data.inputs[i].activation).topRows(rows) *
+                     pitched(data.inputs[i].weights).transpose();
+  }
+  layerActivation(out, data.activation);
+
+  for (unsigned i = 1; i < data.numOutputs; i++) {
+    pitched(data.outputs[i].activation).topLeftCorner(rows, cols) = sum;
+    pitched(data.outputs[i].derivative).topLeftCorner(rows, cols) =
+        pitched(out.derivative).topLeftCorner(rows, cols);
+  }
+}
+
+static void targetQValues(const TargetQValuesData &data) {
+  assert(data.nextTargetActivation.cols == data.outTargetValue.cols + 1);
+  assert(data.batchRewards.cols == 1);
+
+  auto out = pitched(data.outTargetValue);
+  auto rewards = pitched(data.batchRewards);
+  auto next = pitched(data.nextTargetActivation);
+
+  for (unsigned r = 0; r < data.outTargetValue.rows; r++) {
+    float target = rewards(r, 0);
+    if (!data.useOnlyReward) {
+      target += data.discountFactor * next.row(r).head(next.cols() - 1).maxCoeff();
+    }
+    out.row(r).fill(target);
+  }
+}
+
+static void adamUpdate(const AdamUpdateData &data) {
+  auto g = pitched(data.gradient).array();
+  auto momentum = pitched(data.momentum);
+  auto rms = pitched(data.rms);
+
+  momentum = (momentum.array() * data.beta1 + g * (1.0f - data.beta1)).matrix();
+  rms = (rms.array() * data.beta2 + g.square() * (1.0f - data.beta2)).matrix();
+}
+
+static void adamIncrement(const AdamIncrementData &data) {
+  auto mc = pitched(data.momentum).array() / (1.0f - data.beta1);
+  auto rc = pitched(data.rms).array() / (1.0f - data.beta2);
+
+  pitched(data.weights).array() -= data.lr * mc / (rc + data.epsilon).sqrt();
+}
+
+void HostTaskExecutor::Execute(const Task &t) {
+  switch (t.type) {
+  case TaskType::LAYER_ACTIVATION:
+    layerActivation(t.data.layerActivationData.layer, t.data.layerActivationData.activation);
+    return;
+  case TaskType::ERROR_MEASURE:
+    errorMeasure(t.data.errorMeasureData);
+    return;
+  case TaskType::PROPAGATE_DELTA:
+    propagateDelta(t.data.propagateDeltaData);
+    return;
+  case TaskType::GRADIENT_INCREMENT:
+    gradientIncrement(t.data.gradientIncrementData);
+    return;
+  case TaskType::FILL_MATRIX:
+    pitched(t.data.fillMatrixData.target).fill(t.data.fillMatrixData.value);
+    return;
+  case TaskType::SCALE_MATRIX:
+    pitched(t.data.scaleMatrixData.target) *= t.data.scaleMatrixData.scale;
+    return;
+  case TaskType::TRANSPOSE_MATRIX: {
+    const CuMatrix &src = t.data.transposeMatrixData.src;
+    pitched(t.data.transposeMatrixData.dst).topLeftCorner(src.cols, src.rows) =
+        pitched(src).transpose();
+    return;
+  }
+  case TaskType::FORWARD_INCREMENT:
+    forwardIncrement(t.data.forwardIncrementData);
+    return;
+  case TaskType::FORWARD_LAYER:
+    forwardLayer(t.data.forwardLayerData);
+    return;
+  case TaskType::TARGET_QVALUES:
+    targetQValues(t.data.targetQValuesData);
+    return;
+  case TaskType::ADAM_UPDATE:
+    adamUpdate(t.data.adamUpdateData);
+    return;
+  case TaskType::ADAM_INCREMENT:
+    adamIncrement(t.data.adamIncrementData);
+    return;
+  case TaskType::COPY_MATRIX_D2H: {
+    const CuMatrix &src = t.data.copyMatrixD2HData.src;
+    dense(t.data.copyMatrixD2HData.dst).topLeftCorner(src.rows, src.cols) = pitched(src);
+    return;
+  }
+  case TaskType::COPY_MATRIX_H2D: {
+    const math::MatrixView &src = t.data.copyMatrixH2DData.src;
+    pitched(t.data.copyMatrixH2DData.dst).topLeftCorner(src.rows, src.cols) = dense(src);
+    return;
+  }
+  case TaskType::COPY_MATRIX_D2D: {
+    const CuMatrix &src = t.data.copyMatrixD2DData.src;
+    pitched(t.data.copyMatrixD2DData.dst).topLeftCorner(src.rows, src.cols) = pitched(src);
+    return;
+  }
+  default:
+    assert(false);
+  }
+}
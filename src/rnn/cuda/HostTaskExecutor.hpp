@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Task.hpp"
+#include "Types.hpp"
+
+namespace rnn {
+namespace cuda {
+
+namespace host {
+
+// Allocates a CuMatrix in host memory, using the same pitched row-major layout as
+// util::AllocMatrix. The pitch is padded to a whole number of 64 byte cache lines so that every row
+// starts on a SIMD aligned boundary.
+CuMatrix AllocMatrix(unsigned rows, unsigned cols);
+void FreeMatrix(CuMatrix &m);
+}
+
+// Executes Tasks on the CPU against CuMatrix buffers allocated with host::AllocMatrix. The results
+// match the CUDA kernels run by TaskExecutor, so this doubles as a numerical reference for the GPU
+// path. The "device" side of the copy tasks is host memory.
+class HostTaskExecutor {
+public:
+  // Tasks have already completed when Execute returns, so there is nothing to wait for.
+  struct Event {};
+
+  void Execute(const Task &task);
+
+  void Record(Event &) {}
+  void Wait(const Event &) {}
+  void Synchronize(void) {}
+};
+}
+}
@@ -16,6 +16,7 @@ enum class TaskType {
   SCALE_MATRIX,
   TRANSPOSE_MATRIX,
   FORWARD_INCREMENT,
+  FORWARD_LAYER,
   TARGET_QVALUES,
   ADAM_UPDATE,
   ADAM_INCREMENT,
@@ -37,13 +38,14 @@ struct ErrorMeasureData {
   ConnectionActivation networkOutput;
   TargetOutput targetOutput;
   CuMatrix deltaMask;
+  CuMatrix rowWeights; // one column, scales each batch element's delta.
   LayerBatchDeltas outputLayer;
 
   ErrorMeasureData() = default;
   ErrorMeasureData(ConnectionActivation networkOutput, TargetOutput targetOutput,
-                   CuMatrix deltaMask, LayerBatchDeltas outputLayer)
+                   CuMatrix deltaMask, CuMatrix rowWeights, LayerBatchDeltas outputLayer)
       : networkOutput(networkOutput), targetOutput(targetOutput), deltaMask(deltaMask),
-        outputLayer(outputLayer) {}
+        rowWeights(rowWeights), outputLayer(outputLayer) {}
 };
 
 struct PropagateDeltaData {
@@ -112,6 +114,46 @@ struct ForwardIncrementData {
       : layerWeights(layerWeights), input(input), output(output) {}
 };
 
+// Bounds on the connections of a ForwardLayerData, so that it can live in the TaskData union and
+// be passed to a kernel by value.
+constexpr unsigned MAX_LAYER_INPUTS = 8;
+constexpr unsigned MAX_LAYER_OUTPUTS = 8;
+
+struct LayerInput {
+  CuMatrix weights;
+  CuMatrix activation; // the source activations, with a bias column of ones.
+};
+
+// A whole forward step of a layer: the weighted sum over all of its incoming connections, then the
+// activation function, written to each of its outgoing connections.
+struct ForwardLayerData {
+  unsigned batchSize;
+  LayerActivation activation;
+
+  unsigned numInputs;
+  LayerInput inputs[MAX_LAYER_INPUTS];
+
+  unsigned numOutputs;
+  ConnectionActivation outputs[MAX_LAYER_OUTPUTS];
+
+  ForwardLayerData() = default;
+  ForwardLayerData(unsigned batchSize, LayerActivation activation)
+      : batchSize(batchSize), activation(activation), numInputs(0), numOutputs(0) {}
+
+  void AddInput(CuMatrix weights, CuMatrix activation) {
+    assert(numInputs < MAX_LAYER_INPUTS);
+    assert(weights.cols == activation.cols);
+    assert(batchSize <= activation.rows);
+    inputs[numInputs++] = LayerInput{weights, activation};
+  }
+
+  void AddOutput(ConnectionActivation output) {
+    assert(numOutputs < MAX_LAYER_OUTPUTS);
+    assert(output.batchSize == batchSize);
+    outputs[numOutputs++] = output;
+  }
+};
+
 struct TargetQValuesData {
   CuMatrix nextTargetActivation;
   CuMatrix nextActionMask;
@@ -210,6 +252,7 @@ union TaskData {
   ScaleMatrixData scaleMatrixData;
   TransposeMatrixData transposeMatrixData;
   ForwardIncrementData forwardIncrementData;
+  ForwardLayerData forwardLayerData;
   TargetQValuesData targetQValuesData;
   AdamUpdateData adamUpdateData;
   AdamIncrementData adamIncrementData;
@@ -230,11 +273,11 @@ struct Task {
   }
 
   static Task ErrorMeasure(ConnectionActivation networkOutput, TargetOutput targetOutput,
-                           CuMatrix deltaMask, LayerBatchDeltas outputLayer) {
+                           CuMatrix deltaMask, CuMatrix rowWeights, LayerBatchDeltas outputLayer) {
     Task task;
     task.type = TaskType::ERROR_MEASURE;
     task.data.errorMeasureData =
-        ErrorMeasureData(networkOutput, targetOutput, deltaMask, outputLayer);
+        ErrorMeasureData(networkOutput, targetOutput, deltaMask, rowWeights, outputLayer);
     return task;
   }
 
@@ -283,6 +326,18 @@ struct Task {
     return task;
   }
 
+  static Task ForwardLayer(const ForwardLayerData &data) {
+    assert(data.numInputs > 0 && data.numOutputs > 0);
+    for (unsigned i = 0; i < data.numInputs; i++) {
+      assert(data.inputs[i].weights.rows == data.outputs[0].activation.cols - 1);
+    }
+
+    Task task;
+    task.type = TaskType::FORWARD_LAYER;
+    task.data.forwardLayerData = data;
+    return task;
+  }
+
   static Task TargetQValues(CuMatrix nextTargetActivation, CuMatrix nextActionMask, CuMatrix batchRewards,
                             float discountFactor, bool useOnlyReward, CuMatrix outTargetValue) {
     Task task;
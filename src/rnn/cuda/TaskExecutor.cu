@@ -4,6 +4,7 @@
 #include "kernels/AdamKernel.cuh"
 #include "kernels/SoftmaxKernel.cuh"
 #include "kernels/BackwardDeltaKernel.cuh"
+#include "kernels/ForwardLayerKernel.cuh"
 #include "kernels/GradientIncrementKernel.cuh"
 #include "kernels/MatrixFillKernel.cuh"
 #include "kernels/MatrixScaleKernel.cuh"
@@ -43,7 +44,7 @@ struct TaskExecutor::TaskExecutorImpl {
     case TaskType::ERROR_MEASURE:
       ErrorMeasureKernel::Apply(t.data.errorMeasureData.networkOutput,
         t.data.errorMeasureData.targetOutput, t.data.errorMeasureData.deltaMask,
-        t.data.errorMeasureData.outputLayer, stream);
+        t.data.errorMeasureData.rowWeights, t.data.errorMeasureData.outputLayer, stream);
       return;
     case TaskType::PROPAGATE_DELTA:
       BackwardDeltaKernel::Apply(t.data.propagateDeltaData.nextDelta,
@@ -67,6 +68,15 @@ struct TaskExecutor::TaskExecutorImpl {
       WeightedIncrementKernel::Apply(t.data.forwardIncrementData.layerWeights,
         t.data.forwardIncrementData.input, t.data.forwardIncrementData.output, stream);
       return;
+    case TaskType::FORWARD_LAYER:
+      ForwardLayerKernel::Apply(t.data.forwardLayerData, stream);
+      if (t.data.forwardLayerData.activation == LayerActivation::SOFTMAX) {
+        // The fused kernel leaves softmax outputs linear, as it is not element-wise.
+        for (unsigned i = 0; i < t.data.forwardLayerData.numOutputs; i++) {
+          SoftmaxKernel::Apply(t.data.forwardLayerData.outputs[i], stream);
+        }
+      }
+      return;
     case TaskType::TARGET_QVALUES:
       TargetValuesKernel::Apply(t.data.targetQValuesData.nextTargetActivation, t.data.targetQValuesData.nextActionMask,
         t.data.targetQValuesData.batchRewards, t.data.targetQValuesData.discountFactor,
@@ -113,8 +123,29 @@ struct TaskExecutor::TaskExecutorImpl {
   }
 };
 
+struct TaskExecutor::Event::EventImpl {
+  cudaEvent_t event;
+
+  EventImpl() { CheckError(cudaEventCreateWithFlags(&event, cudaEventDisableTiming)); }
+  ~EventImpl() { cudaEventDestroy(event); }
+};
+
+TaskExecutor::Event::Event() : impl(new EventImpl()) {}
+
+TaskExecutor::Event::~Event() = default;
+
 TaskExecutor::TaskExecutor() : impl(new TaskExecutorImpl()) {}
 
 TaskExecutor::~TaskExecutor() = default;
 
 void TaskExecutor::Execute(const Task &task) { impl->Execute(task); }
+
+void TaskExecutor::Record(Event &event) {
+  CheckError(cudaEventRecord(event.impl->event, impl->stream));
+}
+
+void TaskExecutor::Wait(const Event &event) {
+  CheckError(cudaStreamWaitEvent(impl->stream, event.impl->event, 0));
+}
+
+void TaskExecutor::Synchronize(void) { CheckError(cudaStreamSynchronize(impl->stream)); }
@@ -6,13 +6,39 @@
 namespace rnn {
 namespace cuda {
 
+// Executes Tasks asynchronously on its own CUDA stream.
 class TaskExecutor {
 public:
+  // A point in an executor's stream, which Tasks on other executors can wait for without
+  // blocking the host.
+  class Event {
+  public:
+    Event();
+    ~Event();
+
+    Event(const Event &) = delete;
+    Event &operator=(const Event &) = delete;
+
+  private:
+    friend class TaskExecutor;
+    struct EventImpl;
+    std::unique_ptr<EventImpl> impl;
+  };
+
   TaskExecutor();
   ~TaskExecutor();
 
   void Execute(const Task &task);
 
+  // The event completes once all of the Tasks executed so far have.
+  void Record(Event &event);
+
+  // Tasks executed after this start once the event has completed.
+  void Wait(const Event &event);
+
+  // Waits for all of the Tasks executed so far to complete.
+  void Synchronize(void);
+
 private:
   struct TaskExecutorImpl;
   std::unique_ptr<TaskExecutorImpl> impl;
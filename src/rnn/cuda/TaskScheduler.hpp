@@ -0,0 +1,235 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace rnn {
+namespace cuda {
+
+template <typename Executor> class TaskScheduler;
+
+// A directed acyclic graph of work, each node issuing Tasks to an Executor (a TaskExecutor for the
+// device, or a HostTaskExecutor). A node may only depend on nodes added before it, so the graph
+// is acyclic by construction. Built once and run any number of times by a TaskScheduler.
+template <typename Executor> class TaskGraph {
+public:
+  using Work = std::function<void(Executor &)>;
+
+  // Adds a node that runs once all of the given nodes have completed, returns its id.
+  unsigned Add(Work work, const std::vector<unsigned> &dependencies = {}) {
+    unsigned id = nodes.size();
+    nodes.push_back(Node{std::move(work), dependencies, {}});
+
+    for (unsigned dependency : dependencies) {
+      assert(dependency < id);
+      nodes[dependency].successors.push_back(id);
+    }
+    return id;
+  }
+
+  unsigned NumNodes(void) const { return nodes.size(); }
+
+private:
+  friend class TaskScheduler<Executor>;
+
+  struct Node {
+    Work work;
+    std::vector<unsigned> dependencies;
+    std::vector<unsigned> successors;
+  };
+
+  std::vector<Node> nodes;
+};
+
+// Runs TaskGraphs on a pool of worker threads, each with its own Executor (and so, on the device,
+// its own stream). A node is queued once all of its dependencies have completed, on the worker
+// that completed the last of them, so a chain of nodes tends to stay on one stream. A worker takes
+// the newest node from its own queue, and when that is empty steals the oldest from another's.
+//
+// A node is done, as far as the scheduler is concerned, once its Tasks have been issued. Each node
+// records an Event after its Tasks, and a node's executor waits for the events of its
+// dependencies before issuing its own, so the ordering between streams is kept on the device
+// without the host waiting for every node. Run waits for the whole graph once at the end.
+template <typename Executor> class TaskScheduler {
+public:
+  TaskScheduler(unsigned numWorkers)
+      : numWorkers(numWorkers), queues(new WorkerQueue[numWorkers]), graph(nullptr),
+        numEvents(0), numQueued(0), numPending(0), exiting(false) {
+    assert(numWorkers > 0);
+    for (unsigned i = 0; i < numWorkers; i++) {
+      workers.emplace_back([this, i]() { workerLoop(i); });
+    }
+  }
+
+  ~TaskScheduler() {
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+      exiting = true;
+    }
+    wakeCv.notify_all();
+
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  TaskScheduler(const TaskScheduler &other) = delete;
+  TaskScheduler &operator=(const TaskScheduler &other) = delete;
+
+  // Runs every node of the graph and returns once they have all completed. Must not be called
+  // concurrently with another Run.
+  void Run(const TaskGraph<Executor> &graph) {
+    unsigned numNodes = graph.nodes.size();
+    if (numNodes == 0) {
+      return;
+    }
+
+    if (remainingDependencies.size() < numNodes) {
+      remainingDependencies = std::vector<std::atomic<unsigned>>(numNodes);
+    }
+    for (unsigned i = 0; i < numNodes; i++) {
+      remainingDependencies[i] = graph.nodes[i].dependencies.size();
+    }
+
+    if (numEvents < numNodes) {
+      events.reset(new typename Executor::Event[numNodes]);
+      numEvents = numNodes;
+    }
+
+    this->graph = &graph;
+    numPending = numNodes;
+
+    unsigned nextWorker = 0;
+    for (unsigned i = 0; i < numNodes; i++) {
+      if (graph.nodes[i].dependencies.empty()) {
+        push(nextWorker, i);
+        nextWorker = (nextWorker + 1) % numWorkers;
+      }
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(sleepMutex);
+      doneCv.wait(lock, [this]() { return numPending.load() == 0; });
+      this->graph = nullptr;
+    }
+
+    // Every node has been issued. Waiting for the nodes with no successors waits for all of the
+    // others too, as each of those waited for its own dependencies.
+    for (unsigned i = 0; i < numNodes; i++) {
+      if (graph.nodes[i].successors.empty()) {
+        joinExecutor.Wait(events[i]);
+      }
+    }
+    joinExecutor.Synchronize();
+  }
+
+private:
+  struct WorkerQueue {
+    std::mutex m;
+    std::deque<unsigned> nodes;
+  };
+
+  unsigned numWorkers;
+  std::vector<std::thread> workers;
+  std::unique_ptr<WorkerQueue[]> queues;
+
+  const TaskGraph<Executor> *graph;
+  std::vector<std::atomic<unsigned>> remainingDependencies; // indexed by node.
+
+  std::unique_ptr<typename Executor::Event[]> events; // indexed by node.
+  unsigned numEvents;
+  Executor joinExecutor; // waits for the end of each Run.
+
+  std::atomic<unsigned> numQueued;  // ready nodes that no worker has taken yet.
+  std::atomic<unsigned> numPending; // nodes of the current graph that have not completed.
+
+  std::mutex sleepMutex;
+  std::condition_variable wakeCv;
+  std::condition_variable doneCv;
+  bool exiting;
+
+  void workerLoop(unsigned index) {
+    Executor executor;
+
+    while (true) {
+      unsigned node;
+      if (!pop(index, node)) {
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeCv.wait(lock, [this]() { return numQueued.load() > 0 || exiting; });
+        if (exiting) {
+          return;
+        }
+        continue;
+      }
+
+      const typename TaskGraph<Executor>::Node &n = graph->nodes[node];
+      for (unsigned dependency : n.dependencies) {
+        executor.Wait(events[dependency]);
+      }
+      n.work(executor);
+      executor.Record(events[node]);
+
+      for (unsigned successor : n.successors) {
+        if (--remainingDependencies[successor] == 0) {
+          push(index, successor);
+        }
+      }
+
+      if (--numPending == 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        doneCv.notify_all();
+      }
+    }
+  }
+
+  void push(unsigned worker, unsigned node) {
+    // Counted before the node is published, as another worker may take it and decrement the
+    // count as soon as it is in the queue.
+    numQueued++;
+    {
+      std::lock_guard<std::mutex> lock(queues[worker].m);
+      queues[worker].nodes.push_back(node);
+    }
+
+    // Taking the lock orders the count above before any worker's check of it, so a worker about
+    // to sleep cannot miss this wake up.
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    wakeCv.notify_one();
+  }
+
+  bool pop(unsigned worker, unsigned &outNode) {
+    {
+      WorkerQueue &own = queues[worker];
+      std::lock_guard<std::mutex> lock(own.m);
+      if (!own.nodes.empty()) {
+        outNode = own.nodes.back();
+        own.nodes.pop_back();
+        numQueued--;
+        return true;
+      }
+    }
+
+    for (unsigned i = 1; i < numWorkers; i++) {
+      WorkerQueue &victim = queues[(worker + i) % numWorkers];
+      std::lock_guard<std::mutex> lock(victim.m);
+      if (!victim.nodes.empty()) {
+        outNode = victim.nodes.front();
+        victim.nodes.pop_front();
+        numQueued--;
+        return true;
+      }
+    }
+
+    return false;
+  }
+};
+}
+}
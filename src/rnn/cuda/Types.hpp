@@ -22,6 +22,13 @@ struct CuMatrix {
   void Print(void) const;
 };
 
+// Allocates the CuMatrix buffers of a trainer: util::AllocMatrix in device memory for a
+// TaskExecutor, or host::AllocMatrix in host memory for a HostTaskExecutor.
+struct MatrixAllocator {
+  CuMatrix (*allocMatrix)(unsigned rows, unsigned cols);
+  void (*freeMatrix)(CuMatrix &m);
+};
+
 struct TargetOutput {
   unsigned batchSize; // equal to the number of rows in the matrix actually used.
 
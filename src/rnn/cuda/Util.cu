@@ -15,6 +15,12 @@ void util::CudaSynchronize(void) {
   cudaDeviceSynchronize();
 }
 
+bool util::HaveDevice(void) {
+  int numDevices = 0;
+  cudaError_t err = cudaGetDeviceCount(&numDevices);
+  return err == cudaSuccess && numDevices > 0;
+}
+
 void *util::AllocPinned(size_t bufSize) {
   void* result = nullptr;
 
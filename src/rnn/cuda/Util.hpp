@@ -9,6 +9,9 @@ namespace util {
 
 void CudaSynchronize(void);
 
+// Returns true if there is at least one usable CUDA device. Safe to call on hosts with no GPU.
+bool HaveDevice(void);
+
 void *AllocPinned(size_t bufSize);
 void FreePinned(void *buf);
 
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../../LayerDef.hpp"
+#include <cassert>
+#include <cuda_runtime.h>
+
+namespace rnn {
+namespace cuda {
+
+// Element-wise activation functions, shared by the kernels that apply them. Softmax is not
+// element-wise, so SoftmaxKernel applies it separately.
+inline __device__ float activationValue(float in, const LayerActivation activation) {
+  switch(activation) {
+  case LayerActivation::TANH:
+    return tanhf(in);
+  case LayerActivation::LOGISTIC:
+    return 1.0f / (1.0f + expf(-in));
+  case LayerActivation::RELU:
+    return fmaxf(0.0f, in);
+  case LayerActivation::LEAKY_RELU:
+    return fmaxf(0.01f * in, in);
+  case LayerActivation::ELU:
+    return in > 0.0f ? in : (expf(in) - 1.0f);
+  case LayerActivation::LINEAR:
+  case LayerActivation::SOFTMAX:
+    return in;
+  }
+  assert(false); // should never get here.
+  return in;
+}
+
+inline __device__ float activationDerivative(float in, float out,
+                                            const LayerActivation activation) {
+  switch(activation) {
+  case LayerActivation::TANH:
+    return 1.0f - out * out;
+  case LayerActivation::LOGISTIC:
+    return out * (1.0f - out);
+  case LayerActivation::RELU:
+    return in > 0.0f ? 1.0f : 0.0f;
+  case LayerActivation::LEAKY_RELU:
+    return in > 0.0f ? 1.0f : 0.01f;
+  case LayerActivation::ELU:
+    return in > 0.0f ? 1.0f : (out + 1.0f);
+  case LayerActivation::LINEAR:
+  case LayerActivation::SOFTMAX:
+    return 1.0f;
+  }
+  assert(false); // should never get here.
+  return 1.0f;
+}
+}
+}
@@ -1,4 +1,5 @@
 #include "ActivationKernel.cuh"
+#include "ActivationFunctions.cuh"
 #include "Constants.hpp"
 #include "../Types.cuh"
 #include <cuda_runtime.h>
@@ -7,46 +8,6 @@
 using namespace rnn;
 using namespace rnn::cuda;
 
-__device__ float activationValue(float in, const LayerActivation activation) {
-  switch(activation) {
-  case LayerActivation::TANH:
-    return tanhf(in);
-  case LayerActivation::LOGISTIC:
-    return 1.0f / (1.0f + expf(-in));
-  case LayerActivation::RELU:
-    return fmaxf(0.0f, in);
-  case LayerActivation::LEAKY_RELU:
-    return fmaxf(0.01f * in, in);
-  case LayerActivation::ELU:
-    return in > 0.0f ? in : (expf(in) - 1.0f);
-  case LayerActivation::LINEAR:
-  case LayerActivation::SOFTMAX:
-    return in;
-  }
-  assert(false); // should never get here.
-  return in;
-}
-
-__device__ float activationDerivative(float in, float out, const LayerActivation activation) {
-  switch(activation) {
-  case LayerActivation::TANH:
-    return 1.0f - out * out;
-  case LayerActivation::LOGISTIC:
-    return out * (1.0f - out);
-  case LayerActivation::RELU:
-    return in > 0.0f ? 1.0f : 0.0f;
-  case LayerActivation::LEAKY_RELU:
-    return in > 0.0f ? 1.0f : 0.01f;
-  case LayerActivation::ELU:
-    return in > 0.0f ? 1.0f : (out + 1.0f);
-  case LayerActivation::LINEAR:
-  case LayerActivation::SOFTMAX:
-    return 1.0f;
-  }
-  assert(false); // should never get here.
-  return 1.0f;
-}
-
 __global__
 void activationKernel(ConnectionActivation layer, LayerActivation activation) {
   const unsigned row = blockDim.y * blockIdx.y + threadIdx.y;
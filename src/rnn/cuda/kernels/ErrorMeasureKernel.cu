@@ -11,7 +11,7 @@ using namespace rnn::cuda;
 
 __global__
 void errorMeasureKernel(ConnectionActivation nnOut, TargetOutput target, CuMatrix deltaMask,
-                        LayerBatchDeltas out) {
+                        CuMatrix rowWeights, LayerBatchDeltas out) {
 
   const unsigned row = blockDim.y * blockIdx.y + threadIdx.y;
   const unsigned col = blockDim.x * blockIdx.x + threadIdx.x;
@@ -20,7 +20,7 @@ void errorMeasureKernel(ConnectionActivation nnOut, TargetOutput target, CuMatri
     return;
   }
 
-  float mask = *Elem(deltaMask, row, col);
+  float mask = *Elem(deltaMask, row, col) * *Elem(rowWeights, row, 0);
   float derivative = 1.0f;//*Elem(nnOut.derivative, row, col);
   *Elem(out.delta, row, col) =
       mask * derivative * (*Elem(nnOut.activation, row, col) - *Elem(target.value, row, col));
@@ -28,17 +28,19 @@ void errorMeasureKernel(ConnectionActivation nnOut, TargetOutput target, CuMatri
 }
 
 void ErrorMeasureKernel::Apply(ConnectionActivation networkOutput, TargetOutput targetOutput,
-                               CuMatrix deltaMask, LayerBatchDeltas out, cudaStream_t stream) {
+                               CuMatrix deltaMask, CuMatrix rowWeights, LayerBatchDeltas out,
+                               cudaStream_t stream) {
 
   assert(networkOutput.activation.cols == targetOutput.value.cols + 1);
   assert(out.delta.cols == targetOutput.value.cols);
   assert(deltaMask.rows == out.delta.rows);
   assert(deltaMask.cols == out.delta.cols);
+  assert(rowWeights.rows == out.delta.rows && rowWeights.cols == 1);
 
   int bpgX = (out.delta.cols + TPB_X - 1) / TPB_X;
   int bpgY = (out.batchSize + TPB_Y - 1) / TPB_Y;
 
   errorMeasureKernel<<<dim3(bpgX, bpgY, 1), dim3(TPB_X, TPB_Y, 1), 0, stream>>>(
-      networkOutput, targetOutput, deltaMask, out);
+      networkOutput, targetOutput, deltaMask, rowWeights, out);
       // getchar();
 }
@@ -8,7 +8,7 @@ namespace cuda {
 namespace ErrorMeasureKernel {
 
 void Apply(ConnectionActivation networkOutput, TargetOutput targetOutput, CuMatrix deltaMask,
-           LayerBatchDeltas out, cudaStream_t stream);
+           CuMatrix rowWeights, LayerBatchDeltas out, cudaStream_t stream);
 }
 }
 }
@@ -0,0 +1,84 @@
+#include "ForwardLayerKernel.cuh"
+#include "ActivationFunctions.cuh"
+#include "Constants.hpp"
+#include "../Types.cuh"
+#include <cuda_runtime.h>
+
+using namespace rnn;
+using namespace rnn::cuda;
+
+// The same tiled product as weightedIncrementKernel, but accumulated over the chunks of every
+// incoming connection in turn, so the sum stays in a register. The activation function and its
+// derivative are then applied and written straight to each output, rather than in separate passes.
+__global__
+void forwardLayerKernel(ForwardLayerData data, const unsigned spitch) {
+
+  extern __shared__ float buf[]; // shared memory buffer
+
+  const unsigned row = blockDim.y * blockIdx.y + threadIdx.y;
+  const unsigned col = blockDim.x * blockIdx.x + threadIdx.x;
+
+  // buffer for holding the layer weight matrix chunk
+  float *lwChunk = (float *) buf;
+
+  // buffer for holding the prev outputs matrix chunk
+  float *inChunk = (float *) &buf[spitch * blockDim.y];
+
+  const int lwRow = blockDim.x * blockIdx.x + threadIdx.y;
+  const int inRow = row;
+
+  const int chunkIndex = threadIdx.x + threadIdx.y * spitch;
+
+  float sum = 0.0f;
+  for (unsigned i = 0; i < data.numInputs; i++) {
+    const CuMatrix &lw = data.inputs[i].weights;
+    const CuMatrix &in = data.inputs[i].activation;
+
+    const int numChunks = (lw.cols + blockDim.x - 1) / blockDim.x;
+    const int lim = numChunks * blockDim.x;
+
+    for (int chunkOffset = 0; chunkOffset < lim; chunkOffset += blockDim.x) {
+      const int lwCol = chunkOffset + threadIdx.x;
+      if (lwRow < lw.rows && lwCol < lw.cols) {
+        lwChunk[chunkIndex] = *Elem(lw, lwRow, lwCol);
+      }
+
+      const int inCol = lwCol;
+      if (inRow < data.batchSize && inCol < in.cols) {
+        inChunk[chunkIndex] = *Elem(in, inRow, inCol);
+      }
+      __syncthreads();
+
+      int chunkLim = min(blockDim.x, lw.cols - chunkOffset);
+      for (int j = 0; j < chunkLim; j++) {
+        sum += lwChunk[j + threadIdx.x * spitch] * inChunk[j + threadIdx.y * spitch];
+      }
+      __syncthreads();
+    }
+  }
+
+  if (row < data.batchSize && col < data.outputs[0].activation.cols - 1) {
+    float av = activationValue(sum, data.activation);
+    float dv = activationDerivative(sum, av, data.activation);
+
+    for (unsigned i = 0; i < data.numOutputs; i++) {
+      *Elem(data.outputs[i].activation, row, col) = av;
+      *Elem(data.outputs[i].derivative, row, col) = dv;
+    }
+  }
+}
+
+void ForwardLayerKernel::Apply(const ForwardLayerData &data, cudaStream_t stream) {
+  assert(data.numInputs > 0 && data.numOutputs > 0);
+
+  // -1 is here since we dont need to compute the bias term for the output vector.
+  unsigned outCols = data.outputs[0].activation.cols - 1;
+  int bpgX = (outCols + TPB_X - 1) / TPB_X;
+  int bpgY = (data.batchSize + TPB_Y - 1) / TPB_Y;
+
+  unsigned spitch = TPB_X + 1;
+  size_t sharedMemSize = 2 * spitch * TPB_Y * sizeof(float);
+
+  forwardLayerKernel<<<dim3(bpgX, bpgY, 1), dim3(TPB_X, TPB_Y, 1), sharedMemSize, stream>>>(
+      data, spitch);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "../Task.hpp"
+#include <cuda_runtime.h>
+
+namespace rnn {
+namespace cuda {
+namespace ForwardLayerKernel {
+
+void Apply(const ForwardLayerData &data, cudaStream_t stream);
+}
+}
+}
@@ -35,6 +35,10 @@ struct Car::CarImpl {
   pair<Vector2, vector<TrackRayIntersection>> rightEyeRays;
   pair<Vector2, vector<TrackRayIntersection>> sonarRays;
 
+  // Scratch space for samplePixels.
+  vector<Vector2> sampleRayDirs;
+  vector<Maybe<TrackRayIntersection>> sampleRayHits;
+
   CarImpl(const CarDef &def, Vector2 startPos, Vector2 startOrientation)
       : def(def), pos(startPos), velocity(0.0f, 0.0f), forward(startOrientation), turnFrac(0.0f),
         accelFrac(0.0f) {
@@ -122,6 +126,12 @@ struct Car::CarImpl {
   }
 
   bool checkCollisions(float seconds, Track *track, const Vector2 &prevPos) {
+    // Nothing to do if no wall is within reach of the car swept along its path, which is the case
+    // for most steps.
+    if (track->WallClearance(prevPos) > prevPos.distanceTo(pos) + def.size / 2.0f) {
+      return false;
+    }
+
     bool haveCollision = checkCollisionsRayMethod(seconds, track, prevPos);
     haveCollision |= checkCollisionsDisplacementMethod(seconds, track);
     if (haveCollision) {
@@ -201,34 +211,53 @@ struct Car::CarImpl {
 
   void sampleFromEyePosition(Track *track, float forwardRot, const Vector2 &eyePos,
                              vector<TrackRayIntersection> &samplesOut) {
-    assert(samplesOut.empty());
-
     Vector2 rForward = forward.rotated(forwardRot);
     Vector2 pixelRay = rForward.rotated(EYE_FOV / 2.0f - FOV_PER_PIXEL / 2.0f);
-    for (unsigned pi = 0; pi < PIXELS_PER_EYE; pi++) {
+    samplePixels(track, eyePos, pixelRay, PIXELS_PER_EYE, SAMPLER_PER_PIXEL, FOV_PER_PIXEL,
+                 FOV_PER_SAMPLE, samplesOut);
+  }
+
+  // Casts samplesPerPixel rays for each of numPixels pixels, sweeping clockwise from pixelRay,
+  // and averages the hits of each pixel. All of the rays go to the track as one packet.
+  void samplePixels(Track *track, const Vector2 &eyePos, Vector2 pixelRay, unsigned numPixels,
+                    unsigned samplesPerPixel, float fovPerPixel, float fovPerSample,
+                    vector<TrackRayIntersection> &samplesOut) {
+    assert(samplesOut.empty());
+
+    sampleRayDirs.clear();
+    for (unsigned pi = 0; pi < numPixels; pi++) {
+      Vector2 sampleRay = pixelRay.rotated(fovPerPixel / 2.0f - fovPerSample / 2.0f);
+      for (unsigned si = 0; si < samplesPerPixel; si++) {
+        sampleRayDirs.push_back(sampleRay);
+        sampleRay.rotate(-fovPerSample);
+      }
+      pixelRay.rotate(-fovPerPixel);
+    }
+
+    sampleRayHits.resize(sampleRayDirs.size());
+    track->IntersectRays(eyePos, sampleRayDirs.data(), sampleRayDirs.size(), sampleRayHits.data());
+
+    for (unsigned pi = 0; pi < numPixels; pi++) {
       ColorRGB avrgColor;
       Vector2 avrgNormal;
       Vector2 avrgPosition;
       unsigned numSamples = 0;
 
-      Vector2 sampleRay = pixelRay.rotated(FOV_PER_PIXEL / 2.0f - FOV_PER_SAMPLE / 2.0f);
-      for (unsigned si = 0; si < SAMPLER_PER_PIXEL; si++) {
-        Maybe<TrackRayIntersection> trackIntersection = track->IntersectRay(eyePos, sampleRay);
+      for (unsigned si = 0; si < samplesPerPixel; si++) {
+        const Maybe<TrackRayIntersection> &trackIntersection =
+            sampleRayHits[pi * samplesPerPixel + si];
         if (trackIntersection.valid()) {
           avrgPosition += trackIntersection.val().pos;
           avrgNormal += trackIntersection.val().normal;
           avrgColor += trackIntersection.val().color;
           numSamples++;
         }
-        sampleRay.rotate(-FOV_PER_SAMPLE);
       }
 
       numSamples = std::max<unsigned>(1, numSamples);
       avrgColor *= 1.0f / static_cast<float>(numSamples);
       avrgPosition *= 1.0f / static_cast<float>(numSamples);
       samplesOut.emplace_back(avrgPosition, avrgNormal, avrgColor);
-
-      pixelRay.rotate(-FOV_PER_PIXEL);
     }
   }
 
@@ -264,35 +293,9 @@ struct Car::CarImpl {
 
   void sampleFromSonarPosition(Track *track, const Vector2 &eyePos,
                                vector<TrackRayIntersection> &samplesOut) {
-    assert(samplesOut.empty());
-
     Vector2 pixelRay = forward.rotated(SONAR_FOV / 2.0f - FOV_PER_SONAR_PIXEL / 2.0f);
-    for (unsigned pi = 0; pi < SONAR_PIXELS; pi++) {
-      ColorRGB avrgColor;
-      Vector2 avrgNormal;
-      Vector2 avrgPosition;
-      unsigned numSamples = 0;
-
-      Vector2 sampleRay =
-          pixelRay.rotated(FOV_PER_SONAR_PIXEL / 2.0f - FOV_PER_SONAR_SAMPLE / 2.0f);
-      for (unsigned si = 0; si < SAMPLES_PER_SONAR_PIXEL; si++) {
-        Maybe<TrackRayIntersection> trackIntersection = track->IntersectRay(eyePos, sampleRay);
-        if (trackIntersection.valid()) {
-          avrgPosition += trackIntersection.val().pos;
-          avrgNormal += trackIntersection.val().normal;
-          avrgColor += trackIntersection.val().color;
-          numSamples++;
-        }
-        sampleRay.rotate(-FOV_PER_SONAR_SAMPLE);
-      }
-
-      numSamples = std::max<unsigned>(1, numSamples);
-      avrgColor *= 1.0f / static_cast<float>(numSamples);
-      avrgPosition *= 1.0f / static_cast<float>(numSamples);
-      samplesOut.emplace_back(avrgPosition, avrgNormal, avrgColor);
-
-      pixelRay.rotate(-FOV_PER_SONAR_PIXEL);
-    }
+    samplePixels(track, eyePos, pixelRay, SONAR_PIXELS, SAMPLES_PER_SONAR_PIXEL,
+                 FOV_PER_SONAR_PIXEL, FOV_PER_SONAR_SAMPLE, samplesOut);
   }
 };
 
@@ -5,9 +5,19 @@
 #include "../math/Math.hpp"
 #include "../math/Vector2.hpp"
 #include <cassert>
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <random>
 #include <vector>
 
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
 using namespace simulation;
 using namespace std;
 
@@ -22,19 +32,154 @@ struct WallSegment {
       : line(line), normal(normal), startColor(startColor), endColor(endColor) {}
 };
 
+// Uniform grid over the walls, used to accelerate IntersectRay. Each cell lists every wall whose
+// bounding box overlaps it. The lists are packed, the walls of cell c are
+// cellWalls[cellStart[c]] .. cellWalls[cellStart[c + 1] - 1].
+struct WallGrid {
+  Vector2 origin;
+  float cellSize;
+  int width;
+  int height;
+
+  vector<unsigned> cellStart;
+  vector<unsigned> cellWalls;
+
+  int cellX(float x) const {
+    return std::max(0, std::min(width - 1, static_cast<int>(floorf((x - origin.x) / cellSize))));
+  }
+
+  int cellY(float y) const {
+    return std::max(0, std::min(height - 1, static_cast<int>(floorf((y - origin.y) / cellSize))));
+  }
+};
+
+// Distance from the centre of each cell of a grid, finer than the WallGrid, to the nearest wall,
+// capped at the size of a WallGrid cell. Used to bound the distance from any point to the walls.
+struct ClearanceField {
+  Vector2 origin;
+  float cellSize;
+  int width;
+  int height;
+
+  vector<float> cellWallDist;
+
+  Vector2 cellCentre(int x, int y) const {
+    return origin + Vector2((x + 0.5f) * cellSize, (y + 0.5f) * cellSize);
+  }
+
+  int cellX(float x) const {
+    return std::max(0, std::min(width - 1, static_cast<int>(floorf((x - origin.x) / cellSize))));
+  }
+
+  int cellY(float y) const {
+    return std::max(0, std::min(height - 1, static_cast<int>(floorf((y - origin.y) / cellSize))));
+  }
+};
+
+// Structure-of-arrays copy of the wall segments for IntersectRays.
+struct WallArrays {
+  vector<float> startX;
+  vector<float> startY;
+  vector<float> vecX; // end - start
+  vector<float> vecY;
+};
+
+// Number of rays that IntersectRays tests together, one per SIMD lane.
+static constexpr unsigned RAY_PACKET_SIZE = 8;
+
+// Number of track line segments on either side of the hint that NearestSegment searches.
+static constexpr unsigned NEAREST_SEGMENT_WINDOW = 2;
+
+// Walls are binned by their bounding box grown by this much, so that hits that land exactly on a
+// cell boundary are not missed.
+static constexpr float WALL_GRID_PADDING = 0.01f;
+
+// Number of ClearanceField cells along each side of a WallGrid cell.
+static constexpr int CLEARANCE_SUBDIVISIONS = 4;
+
 struct Track::TrackImpl {
   vector<ColorRGB> leftWallPalette;
   vector<ColorRGB> rightWallPalette;
 
   vector<WallSegment> walls;
+  WallGrid wallGrid;
+  ClearanceField clearanceField;
+  WallArrays wallArrays;
   vector<Vector2> trackLine;
+  vector<float> trackLineDistance; // distance along the track to the start of each segment.
   float trackTotalLength;
   float trackMaxSize;
 
-  TrackImpl(const TrackSpec &spec) {
+  // Only used while generating, so that a seed always gives the same track.
+  std::mt19937 rng;
+
+  TrackImpl(const TrackSpec &spec, uint32_t seed) : rng(seed) {
     generateWallsPalette(spec);
     generateTrackLine(spec);
     generateWalls(spec);
+    buildIndices();
+  }
+
+  // Reads the track line and walls written by Write, the rest is derived from them.
+  TrackImpl(std::istream &in) {
+    uint32_t numLinePoints, numWalls;
+    readValue(in, numLinePoints);
+    readValue(in, numWalls);
+    assert(numLinePoints >= 3 && numWalls > 0);
+
+    trackLine.resize(numLinePoints);
+    for (auto &p : trackLine) {
+      readValue(in, p.x);
+      readValue(in, p.y);
+    }
+
+    walls.reserve(numWalls);
+    for (unsigned i = 0; i < numWalls; i++) {
+      Vector2 start, end, normal;
+      ColorRGB startColor, endColor;
+      for (float *v : {&start.x, &start.y, &end.x, &end.y, &normal.x, &normal.y, &startColor.r,
+                       &startColor.g, &startColor.b, &endColor.r, &endColor.g, &endColor.b}) {
+        readValue(in, *v);
+      }
+      walls.emplace_back(CollisionLineSegment(start, end), normal, startColor, endColor);
+    }
+    assert(in.good());
+
+    computeTrackLineDistances();
+    computeTrackMaxSize();
+    buildIndices();
+  }
+
+  void Write(std::ostream &out) const {
+    writeValue(out, static_cast<uint32_t>(trackLine.size()));
+    writeValue(out, static_cast<uint32_t>(walls.size()));
+
+    for (const auto &p : trackLine) {
+      writeValue(out, p.x);
+      writeValue(out, p.y);
+    }
+
+    for (const auto &w : walls) {
+      for (float v : {w.line.start.x, w.line.start.y, w.line.end.x, w.line.end.y, w.normal.x,
+                      w.normal.y, w.startColor.r, w.startColor.g, w.startColor.b, w.endColor.r,
+                      w.endColor.g, w.endColor.b}) {
+        writeValue(out, v);
+      }
+    }
+  }
+
+  template <typename T> static void writeValue(std::ostream &out, const T &value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  template <typename T> static void readValue(std::istream &in, T &value) {
+    in.read(reinterpret_cast<char *>(&value), sizeof(T));
+  }
+
+  void buildIndices(void) {
+    buildWallGrid();
+    buildClearanceField();
+    buildWallArrays();
   }
 
   void Render(renderer::Renderer *renderer) const {
@@ -54,27 +199,72 @@ struct Track::TrackImpl {
     return make_pair(startPos, startOrientation);
   }
 
+  pair<Vector2, Vector2> StartPosAndOrientation(unsigned segment) const {
+    assert(segment < trackLine.size());
+    unsigned next = (segment + 1) % trackLine.size();
+    return make_pair(trackLine[segment], (trackLine[next] - trackLine[segment]).normalised());
+  }
+
   float DistanceAlongTrack(const Vector2 &point) const {
-    float minDistance = 0.0f;
-    float bestResult = 0.0f;
+    return DistanceAlongTrack(point, NearestSegment(point));
+  }
 
-    float distanceSoFar = 0.0f;
+  float DistanceAlongTrack(const Vector2 &point, unsigned segment) const {
+    unsigned next = (segment + 1) % trackLine.size();
+    std::pair<Vector2, float> psd =
+        Geometry::PointSegmentDist(point, trackLine[segment], trackLine[next]);
+    return trackLineDistance[segment] + psd.first.distanceTo(trackLine[segment]);
+  }
 
-    for (unsigned i = 0; i < trackLine.size(); i++) {
-      unsigned next = (i + 1) % trackLine.size();
+  unsigned NearestSegment(const Vector2 &point) const {
+    return nearestSegmentInRange(point, 0, trackLine.size());
+  }
 
-      std::pair<Vector2, float> psd =
-          Geometry::PointSegmentDist(point, trackLine[i], trackLine[next]);
+  unsigned NearestSegment(const Vector2 &point, unsigned hint) const {
+    assert(hint < trackLine.size());
 
-      if (i == 0 || psd.second < minDistance) {
-        minDistance = psd.second;
-        bestResult = distanceSoFar + psd.first.distanceTo(trackLine[i]);
-      }
+    unsigned window = std::min<unsigned>(NEAREST_SEGMENT_WINDOW, (trackLine.size() - 1) / 2);
+    unsigned first = (hint + trackLine.size() - window) % trackLine.size();
+    unsigned count = 2 * window + 1;
 
-      distanceSoFar += trackLine[i].distanceTo(trackLine[next]);
+    unsigned result = nearestSegmentInRange(point, first, count);
+
+    // If the nearest segment is at the edge of the window then the point has moved further than
+    // expected since the hint, so it may not be the nearest overall.
+    if (result == first || result == (first + count - 1) % trackLine.size()) {
+      return NearestSegment(point);
     }
+    return result;
+  }
 
-    return bestResult;
+  // Searches count segments starting from first, wrapping around the end of the track. Ties go to
+  // the lowest index, as in a full scan.
+  unsigned nearestSegmentInRange(const Vector2 &point, unsigned first, unsigned count) const {
+    float minDistance = 0.0f;
+    unsigned result = first;
+
+    for (unsigned j = 0; j < count; j++) {
+      unsigned i = (first + j) % trackLine.size();
+      unsigned next = (i + 1) % trackLine.size();
+
+      float dist = Geometry::PointSegmentDist(point, trackLine[i], trackLine[next]).second;
+      if (j == 0 || dist < minDistance || (dist == minDistance && i < result)) {
+        minDistance = dist;
+        result = i;
+      }
+    }
+
+    return result;
+  }
+
+  Vector2 NextWaypoint(const Vector2 &point, unsigned segment) const {
+    Vector2 result = trackLine[(segment + 1) % trackLine.size()];
+
+    // Matches the full search, which skips a waypoint that the point is sitting on.
+    if (result.distanceTo2(point) <= Geometry::EPSILON) {
+      result = trackLine[(segment + 2) % trackLine.size()];
+    }
+    return result;
   }
 
   Vector2 NextWaypoint(const Vector2 &point) const {
@@ -96,12 +286,201 @@ struct Track::TrackImpl {
     return bestResult;
   }
 
+  // Walks the grid cells along the ray in order (Amanatides & Woo DDA), testing the walls of each
+  // cell and stopping at the first cell that ends beyond the nearest hit found so far.
   Maybe<TrackRayIntersection> IntersectRay(const Vector2 &start, const Vector2 &dir) const {
-    CollisionLineSegment line(start, start + dir * trackMaxSize);
+    const WallGrid &grid = wallGrid;
+
+    Vector2 end = start + dir * trackMaxSize;
+    Vector2 d = end - start;
+    float dd = d.dotProduct(d);
+    if (dd < Geometry::EPSILON) {
+      return Maybe<TrackRayIntersection>::none;
+    }
 
-    // TODO: if it makes sense we can have a quad-tree or some kind of spatial partitioning
-    // structure to make this intersection test faster. But maybe its not necessary given the
-    // mall number of walls.
+    // Clip the ray parameter range [t0, t1] to the grid bounds.
+    float t0 = 0.0f, t1 = 1.0f;
+    if (!clipToSlab(start.x, d.x, grid.origin.x, grid.origin.x + grid.width * grid.cellSize, t0,
+                    t1) ||
+        !clipToSlab(start.y, d.y, grid.origin.y, grid.origin.y + grid.height * grid.cellSize, t0,
+                    t1)) {
+      return Maybe<TrackRayIntersection>::none;
+    }
+
+    Vector2 entry = start + d * t0;
+    int cx = grid.cellX(entry.x);
+    int cy = grid.cellY(entry.y);
+
+    int stepX = d.x > 0.0f ? 1 : -1;
+    int stepY = d.y > 0.0f ? 1 : -1;
+
+    float tMaxX = std::numeric_limits<float>::infinity();
+    float tMaxY = std::numeric_limits<float>::infinity();
+    float tDeltaX = std::numeric_limits<float>::infinity();
+    float tDeltaY = std::numeric_limits<float>::infinity();
+
+    if (d.x != 0.0f) {
+      float boundary = grid.origin.x + (cx + (stepX > 0 ? 1 : 0)) * grid.cellSize;
+      tMaxX = (boundary - start.x) / d.x;
+      tDeltaX = grid.cellSize / fabsf(d.x);
+    }
+    if (d.y != 0.0f) {
+      float boundary = grid.origin.y + (cy + (stepY > 0 ? 1 : 0)) * grid.cellSize;
+      tMaxY = (boundary - start.y) / d.y;
+      tDeltaY = grid.cellSize / fabsf(d.y);
+    }
+
+    float bestT = std::numeric_limits<float>::infinity();
+    Vector2 bestPos;
+    unsigned bestWall = 0;
+
+    while (true) {
+      unsigned cell = cy * grid.width + cx;
+      for (unsigned i = grid.cellStart[cell]; i < grid.cellStart[cell + 1]; i++) {
+        unsigned wi = grid.cellWalls[i];
+        const CollisionLineSegment &wl = walls[wi].line;
+
+        Maybe<Vector2> hit = Geometry::IntersectLines(wl.start, wl.end, start, end);
+        if (hit.valid()) {
+          float t = (hit.val() - start).dotProduct(d) / dd;
+          if (t < bestT) {
+            bestT = t;
+            bestPos = hit.val();
+            bestWall = wi;
+          }
+        }
+      }
+
+      float tCellExit = std::min(tMaxX, tMaxY);
+      if (bestT <= tCellExit || tCellExit >= t1) {
+        break;
+      }
+
+      if (tMaxX < tMaxY) {
+        cx += stepX;
+        tMaxX += tDeltaX;
+      } else {
+        cy += stepY;
+        tMaxY += tDeltaY;
+      }
+
+      if (cx < 0 || cx >= grid.width || cy < 0 || cy >= grid.height) {
+        break;
+      }
+    }
+
+    if (bestT == std::numeric_limits<float>::infinity()) {
+      return Maybe<TrackRayIntersection>::none;
+    }
+
+    const WallSegment &wall = walls[bestWall];
+    float distToStart = bestPos.distanceTo(wall.line.start);
+    float f = distToStart / wall.line.length;
+    f = std::max(0.0f, std::min(1.0f, f)); // clip to range 0 - 1
+    ColorRGB color(wall.endColor * f + wall.startColor * (1.0f - f));
+
+    return Maybe<TrackRayIntersection>(TrackRayIntersection(bestPos, wall.normal, color));
+  }
+
+  void IntersectRays(const Vector2 &origin, const Vector2 dirs[], unsigned numRays,
+                     Maybe<TrackRayIntersection> out[]) const {
+#ifdef __AVX__
+    for (unsigned pi = 0; pi < numRays; pi += RAY_PACKET_SIZE) {
+      unsigned packetSize = std::min(RAY_PACKET_SIZE, numRays - pi);
+
+      float rayX[RAY_PACKET_SIZE], rayY[RAY_PACKET_SIZE];
+      for (unsigned i = 0; i < RAY_PACKET_SIZE; i++) {
+        // Unused lanes repeat the last ray, their results are discarded.
+        const Vector2 &dir = dirs[pi + std::min(i, packetSize - 1)];
+        rayX[i] = dir.x * trackMaxSize;
+        rayY[i] = dir.y * trackMaxSize;
+      }
+
+      float bestWallT[RAY_PACKET_SIZE];
+      int bestWall[RAY_PACKET_SIZE];
+      intersectPacket(origin, rayX, rayY, bestWallT, bestWall);
+
+      for (unsigned i = 0; i < packetSize; i++) {
+        if (bestWall[i] < 0) {
+          out[pi + i] = Maybe<TrackRayIntersection>::none;
+          continue;
+        }
+
+        const WallSegment &wall = walls[bestWall[i]];
+        Vector2 pos = wall.line.start + (wall.line.end - wall.line.start) * bestWallT[i];
+
+        float distToStart = pos.distanceTo(wall.line.start);
+        float f = distToStart / wall.line.length;
+        f = std::max(0.0f, std::min(1.0f, f)); // clip to range 0 - 1
+        ColorRGB color(wall.endColor * f + wall.startColor * (1.0f - f));
+
+        out[pi + i] = Maybe<TrackRayIntersection>(TrackRayIntersection(pos, wall.normal, color));
+      }
+    }
+#else
+    // Without SIMD, testing a packet against every wall is slower than walking the grid per ray.
+    for (unsigned i = 0; i < numRays; i++) {
+      out[i] = IntersectRay(origin, dirs[i]);
+    }
+#endif
+  }
+
+#ifdef __AVX__
+  // Finds the nearest wall hit by each ray of the packet, the rays start at origin and end at
+  // origin + (rayX, rayY). Outputs the hit wall index, or -1 for a miss, and the position of the
+  // hit along the wall. Uses the same tests and tolerances as Geometry::IntersectLines.
+  void intersectPacket(const Vector2 &origin, const float rayX[], const float rayY[],
+                       float bestWallTOut[], int bestWallOut[]) const {
+    static_assert(RAY_PACKET_SIZE == 8, "one packet per AVX register");
+    const WallArrays &wa = wallArrays;
+
+    const __m256 dx = _mm256_loadu_ps(rayX);
+    const __m256 dy = _mm256_loadu_ps(rayY);
+    const __m256 vlo = _mm256_set1_ps(-Geometry::EPSILON);
+    const __m256 vhi = _mm256_set1_ps(1.0f + Geometry::EPSILON);
+    const __m256 eps = _mm256_set1_ps(Geometry::EPSILON);
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+    __m256 bestRayT = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    __m256 bestWallT = _mm256_setzero_ps();
+    __m256 bestWall = _mm256_set1_ps(-1.0f);
+
+    for (unsigned wi = 0; wi < wa.startX.size(); wi++) {
+      float rx = wa.startX[wi] - origin.x;
+      float ry = wa.startY[wi] - origin.y;
+      __m256 wx = _mm256_set1_ps(wa.vecX[wi]);
+      __m256 wy = _mm256_set1_ps(wa.vecY[wi]);
+
+      __m256 denom = _mm256_sub_ps(_mm256_mul_ps(dy, wx), _mm256_mul_ps(dx, wy));
+      __m256 wallNum = _mm256_sub_ps(_mm256_mul_ps(dx, _mm256_set1_ps(ry)),
+                                     _mm256_mul_ps(dy, _mm256_set1_ps(rx)));
+      __m256 rayNum = _mm256_set1_ps(wa.vecX[wi] * ry - wa.vecY[wi] * rx);
+
+      __m256 invDenom = _mm256_div_ps(_mm256_set1_ps(1.0f), denom);
+      __m256 wallT = _mm256_mul_ps(wallNum, invDenom);
+      __m256 rayT = _mm256_mul_ps(rayNum, invDenom);
+
+      __m256 hit = _mm256_cmp_ps(_mm256_and_ps(denom, absMask), eps, _CMP_GE_OQ);
+      hit = _mm256_and_ps(hit, _mm256_cmp_ps(wallT, vlo, _CMP_GE_OQ));
+      hit = _mm256_and_ps(hit, _mm256_cmp_ps(wallT, vhi, _CMP_LE_OQ));
+      hit = _mm256_and_ps(hit, _mm256_cmp_ps(rayT, vlo, _CMP_GE_OQ));
+      hit = _mm256_and_ps(hit, _mm256_cmp_ps(rayT, vhi, _CMP_LE_OQ));
+      hit = _mm256_and_ps(hit, _mm256_cmp_ps(rayT, bestRayT, _CMP_LT_OQ));
+
+      bestRayT = _mm256_blendv_ps(bestRayT, rayT, hit);
+      bestWallT = _mm256_blendv_ps(bestWallT, wallT, hit);
+      bestWall = _mm256_blendv_ps(bestWall, _mm256_set1_ps(static_cast<float>(wi)), hit);
+    }
+
+    _mm256_storeu_ps(bestWallTOut, bestWallT);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(bestWallOut), _mm256_cvtps_epi32(bestWall));
+  }
+#endif
+
+  // Reference implementation of IntersectRay that tests every wall.
+  Maybe<TrackRayIntersection> IntersectRayBruteForce(const Vector2 &start,
+                                                     const Vector2 &dir) const {
+    CollisionLineSegment line(start, start + dir * trackMaxSize);
 
     CollisionResult wallCollision;
     unsigned wallIndex = 0;
@@ -129,11 +508,39 @@ struct Track::TrackImpl {
     }
   }
 
+  // The distance from any point to the nearest wall is at least the distance from the centre of
+  // its grid cell to the nearest wall, minus the distance between the point and that centre. This
+  // holds for points outside of the grid too, the bound is just looser there.
+  float WallClearance(const Vector2 &point) const {
+    const ClearanceField &field = clearanceField;
+    int cx = field.cellX(point.x);
+    int cy = field.cellY(point.y);
+
+    float bound = field.cellWallDist[cy * field.width + cx] -
+                  point.distanceTo(field.cellCentre(cx, cy)) - WALL_GRID_PADDING;
+    return std::max(0.0f, bound);
+  }
+
+  // Only the walls binned in the grid cells that the sphere's bounding box overlaps can intersect
+  // it. The results are in wall order, as for a scan of every wall.
   vector<CollisionResult> IntersectSphere(const Vector2 &pos, float radius) const {
     CollisionSphere sphere(pos, radius);
+    const WallGrid &grid = wallGrid;
+
+    vector<unsigned> candidates;
+    for (int y = grid.cellY(pos.y - radius); y <= grid.cellY(pos.y + radius); y++) {
+      for (int x = grid.cellX(pos.x - radius); x <= grid.cellX(pos.x + radius); x++) {
+        unsigned cell = y * grid.width + x;
+        candidates.insert(candidates.end(), grid.cellWalls.begin() + grid.cellStart[cell],
+                          grid.cellWalls.begin() + grid.cellStart[cell + 1]);
+      }
+    }
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
 
     vector<CollisionResult> result;
-    for (const auto &wall : walls) {
+    for (unsigned wi : candidates) {
+      const WallSegment &wall = walls[wi];
       if (wall.line.midPoint.distanceTo2(pos) >
           (radius + wall.line.length / 2.0f) * (radius + wall.line.length / 2.0f)) {
         continue;
@@ -149,6 +556,123 @@ struct Track::TrackImpl {
     return result;
   }
 
+  void buildWallArrays(void) {
+    for (const auto &w : walls) {
+      wallArrays.startX.push_back(w.line.start.x);
+      wallArrays.startY.push_back(w.line.start.y);
+      wallArrays.vecX.push_back(w.line.end.x - w.line.start.x);
+      wallArrays.vecY.push_back(w.line.end.y - w.line.start.y);
+    }
+  }
+
+  // Narrows [t0, t1] to the part of the ray start + t * d that lies within [lo, hi] along one axis.
+  static bool clipToSlab(float start, float d, float lo, float hi, float &t0, float &t1) {
+    if (d == 0.0f) {
+      return start >= lo && start <= hi;
+    }
+
+    float ta = (lo - start) / d;
+    float tb = (hi - start) / d;
+    if (ta > tb) {
+      std::swap(ta, tb);
+    }
+
+    t0 = std::max(t0, ta);
+    t1 = std::min(t1, tb);
+    return t0 <= t1;
+  }
+
+  void buildWallGrid(void) {
+    assert(!walls.empty());
+
+    Vector2 minCorner = walls[0].line.start;
+    Vector2 maxCorner = minCorner;
+    float totalLength = 0.0f;
+
+    for (const auto &w : walls) {
+      for (const auto &p : {w.line.start, w.line.end}) {
+        minCorner = Vector2(std::min(minCorner.x, p.x), std::min(minCorner.y, p.y));
+        maxCorner = Vector2(std::max(maxCorner.x, p.x), std::max(maxCorner.y, p.y));
+      }
+      totalLength += w.line.length;
+    }
+
+    // Roughly one wall per cell along the track.
+    WallGrid &grid = wallGrid;
+    grid.cellSize = std::max(totalLength / walls.size(), WALL_GRID_PADDING * 10.0f);
+    grid.origin = minCorner - Vector2(WALL_GRID_PADDING, WALL_GRID_PADDING);
+    grid.width = static_cast<int>(ceilf((maxCorner.x - grid.origin.x) / grid.cellSize)) + 1;
+    grid.height = static_cast<int>(ceilf((maxCorner.y - grid.origin.y) / grid.cellSize)) + 1;
+
+    vector<vector<unsigned>> cells(grid.width * grid.height);
+    for (unsigned wi = 0; wi < walls.size(); wi++) {
+      const CollisionLineSegment &l = walls[wi].line;
+
+      int x0 = grid.cellX(std::min(l.start.x, l.end.x) - WALL_GRID_PADDING);
+      int x1 = grid.cellX(std::max(l.start.x, l.end.x) + WALL_GRID_PADDING);
+      int y0 = grid.cellY(std::min(l.start.y, l.end.y) - WALL_GRID_PADDING);
+      int y1 = grid.cellY(std::max(l.start.y, l.end.y) + WALL_GRID_PADDING);
+
+      for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+          cells[y * grid.width + x].push_back(wi);
+        }
+      }
+    }
+
+    grid.cellStart.clear();
+    grid.cellWalls.clear();
+    for (const auto &c : cells) {
+      grid.cellStart.push_back(grid.cellWalls.size());
+      grid.cellWalls.insert(grid.cellWalls.end(), c.begin(), c.end());
+    }
+    grid.cellStart.push_back(grid.cellWalls.size());
+  }
+
+  // Covers the same area as the WallGrid, which must be built first. Any wall within a WallGrid
+  // cell's size of a point is binned in the point's WallGrid cell or one of its neighbours, so the
+  // distances are capped at that size and only those walls need to be searched.
+  void buildClearanceField(void) {
+    ClearanceField &field = clearanceField;
+    field.origin = wallGrid.origin;
+    field.cellSize = wallGrid.cellSize / CLEARANCE_SUBDIVISIONS;
+    field.width = wallGrid.width * CLEARANCE_SUBDIVISIONS;
+    field.height = wallGrid.height * CLEARANCE_SUBDIVISIONS;
+    field.cellWallDist.assign(field.width * field.height, wallGrid.cellSize);
+
+    vector<unsigned> nearbyWalls;
+    for (int gy = 0; gy < wallGrid.height; gy++) {
+      for (int gx = 0; gx < wallGrid.width; gx++) {
+        nearbyWalls.clear();
+        for (int ny = std::max(0, gy - 1); ny <= std::min(wallGrid.height - 1, gy + 1); ny++) {
+          for (int nx = std::max(0, gx - 1); nx <= std::min(wallGrid.width - 1, gx + 1); nx++) {
+            unsigned cell = ny * wallGrid.width + nx;
+            auto cellWalls = wallGrid.cellWalls.begin();
+            nearbyWalls.insert(nearbyWalls.end(), cellWalls + wallGrid.cellStart[cell],
+                               cellWalls + wallGrid.cellStart[cell + 1]);
+          }
+        }
+        sort(nearbyWalls.begin(), nearbyWalls.end());
+        nearbyWalls.erase(unique(nearbyWalls.begin(), nearbyWalls.end()), nearbyWalls.end());
+
+        for (int sy = 0; sy < CLEARANCE_SUBDIVISIONS; sy++) {
+          for (int sx = 0; sx < CLEARANCE_SUBDIVISIONS; sx++) {
+            int x = gx * CLEARANCE_SUBDIVISIONS + sx;
+            int y = gy * CLEARANCE_SUBDIVISIONS + sy;
+            Vector2 centre = field.cellCentre(x, y);
+
+            float &minDist = field.cellWallDist[y * field.width + x];
+            for (unsigned wi : nearbyWalls) {
+              const CollisionLineSegment &l = walls[wi].line;
+              minDist =
+                  std::min(minDist, Geometry::PointSegmentDist(centre, l.start, l.end).second);
+            }
+          }
+        }
+      }
+    }
+  }
+
   void generateWallsPalette(const TrackSpec &spec) {
     const float minChannelVal = 0.2f;
     // leftWallPalette.emplace_back(ColorRGB(1.0f, 0.0f, 0.0f));
@@ -160,12 +684,12 @@ struct Track::TrackImpl {
     // rightWallPalette.emplace_back(ColorRGB(1.0f, 0.0f, 0.0f));
 
     for (unsigned i = 0; i < spec.colorPaletteSize; i++) {
-      leftWallPalette.emplace_back(math::RandInterval(minChannelVal, 1.0f),
-                                   math::RandInterval(minChannelVal, 1.0f),
-                                   math::RandInterval(minChannelVal, 1.0f));
-      rightWallPalette.emplace_back(math::RandInterval(minChannelVal, 1.0f),
-                                    math::RandInterval(minChannelVal, 1.0f),
-                                    math::RandInterval(minChannelVal, 1.0f));
+      leftWallPalette.emplace_back(randInterval(minChannelVal, 1.0f),
+                                   randInterval(minChannelVal, 1.0f),
+                                   randInterval(minChannelVal, 1.0f));
+      rightWallPalette.emplace_back(randInterval(minChannelVal, 1.0f),
+                                    randInterval(minChannelVal, 1.0f),
+                                    randInterval(minChannelVal, 1.0f));
     }
   }
 
@@ -179,26 +703,37 @@ struct Track::TrackImpl {
       trackLine.emplace_back(cosf(theta) * r, sinf(theta) * r);
     }
 
+    computeTrackLineDistances();
+    return true;
+  }
+
+  void computeTrackLineDistances(void) {
     trackTotalLength = 0.0f;
+    trackLineDistance.reserve(trackLine.size());
     for (unsigned i = 0; i < trackLine.size(); i++) {
       unsigned next = (i + 1) % trackLine.size();
+      trackLineDistance.push_back(trackTotalLength);
       trackTotalLength += trackLine[i].distanceTo(trackLine[next]);
     }
+  }
 
-    return true;
+  float randInterval(float s, float e) {
+    return std::uniform_real_distribution<float>(s, e)(rng);
   }
 
-  vector<float> genPertubation(const TrackSpec &spec) const {
+  unsigned randIndex(unsigned n) { return std::uniform_int_distribution<unsigned>(0, n - 1)(rng); }
+
+  vector<float> genPertubation(const TrackSpec &spec) {
     vector<float> perturbAmounts(spec.numLinePoints, 0.0f);
 
     for (unsigned scale = 0; scale < 6; scale++) {
       unsigned skip = 1 << scale;
       float rs = pow(2.0f, scale);
 
-      int indexOffset = rand() % spec.numLinePoints;
+      int indexOffset = randIndex(spec.numLinePoints);
       for (unsigned i = 0; i < perturbAmounts.size(); i += skip) {
         perturbAmounts[(i + indexOffset) % perturbAmounts.size()] +=
-            math::RandInterval(-spec.maxModStrength * 0.5f * rs, spec.maxModStrength * rs);
+            randInterval(-spec.maxModStrength * 0.5f * rs, spec.maxModStrength * rs);
       }
     }
 
@@ -385,7 +920,7 @@ struct Track::TrackImpl {
     unsigned extra = 5;
     vector<float> result(trackLine.size() + extra);
     for (unsigned i = 0; i < trackLine.size(); i++) {
-      result[i] = math::RandInterval(spec.trackMinWidth, spec.trackMaxWidth);
+      result[i] = randInterval(spec.trackMinWidth, spec.trackMaxWidth);
     }
     for (unsigned i = 0; i < extra; i++) {
       result[i + trackLine.size()] = result[i];
@@ -410,7 +945,15 @@ struct Track::TrackImpl {
   }
 };
 
-Track::Track(const TrackSpec &spec) : impl(new TrackImpl(spec)) {}
+Track::Track(const TrackSpec &spec) : impl(new TrackImpl(spec, rand())) {}
+
+Track::Track(const TrackSpec &spec, uint32_t seed) : impl(new TrackImpl(spec, seed)) {}
+
+uptr<Track> Track::Read(std::istream &in) { return uptr<Track>(new Track(in)); }
+
+Track::Track(std::istream &in) : impl(new TrackImpl(in)) {}
+
+void Track::Write(std::ostream &out) const { impl->Write(out); }
 
 Track::~Track() = default;
 
@@ -420,6 +963,10 @@ pair<Vector2, Vector2> Track::StartPosAndOrientation(void) const {
   return impl->StartPosAndOrientation();
 }
 
+pair<Vector2, Vector2> Track::StartPosAndOrientation(unsigned segment) const {
+  return impl->StartPosAndOrientation(segment);
+}
+
 float Track::DistanceAlongTrack(const Vector2 &point) const {
   return impl->DistanceAlongTrack(point);
 }
@@ -428,12 +975,40 @@ Vector2 Track::NextWaypoint(const Vector2 &point) const {
   return impl->NextWaypoint(point);
 }
 
+unsigned Track::NearestSegment(const Vector2 &point) const { return impl->NearestSegment(point); }
+
+unsigned Track::NearestSegment(const Vector2 &point, unsigned hint) const {
+  return impl->NearestSegment(point, hint);
+}
+
+float Track::DistanceAlongTrack(const Vector2 &point, unsigned nearestSegment) const {
+  return impl->DistanceAlongTrack(point, nearestSegment);
+}
+
+Vector2 Track::NextWaypoint(const Vector2 &point, unsigned nearestSegment) const {
+  return impl->NextWaypoint(point, nearestSegment);
+}
+
 float Track::TrackLength(void) const { return impl->trackTotalLength; }
 
+unsigned Track::NumSegments(void) const { return impl->trackLine.size(); }
+
 Maybe<TrackRayIntersection> Track::IntersectRay(const Vector2 &start, const Vector2 &dir) const {
   return impl->IntersectRay(start, dir);
 }
 
+Maybe<TrackRayIntersection> Track::IntersectRayBruteForce(const Vector2 &start,
+                                                          const Vector2 &dir) const {
+  return impl->IntersectRayBruteForce(start, dir);
+}
+
+void Track::IntersectRays(const Vector2 &origin, const Vector2 dirs[], unsigned numRays,
+                          Maybe<TrackRayIntersection> out[]) const {
+  impl->IntersectRays(origin, dirs, numRays, out);
+}
+
+float Track::WallClearance(const Vector2 &point) const { return impl->WallClearance(point); }
+
 vector<CollisionResult> Track::IntersectSphere(const Vector2 &pos, float radius) const {
   return impl->IntersectSphere(pos, radius);
 }
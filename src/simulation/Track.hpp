@@ -4,6 +4,8 @@
 #include "../common/Maybe.hpp"
 #include "../math/CollisionResult.hpp"
 #include "../renderer/Renderer.hpp"
+#include <cstdint>
+#include <iosfwd>
 #include <utility>
 
 namespace simulation {
@@ -41,22 +43,61 @@ struct TrackRayIntersection {
 
 class Track {
 public:
+  // Generates a random track, using rand to pick the seed.
   Track(const TrackSpec &spec);
+
+  // Generates the track for a seed, which is always the same track given the same spec.
+  Track(const TrackSpec &spec, uint32_t seed);
+
   ~Track();
 
+  // Compact binary form of the track: its line and walls, native endianness. The wall index and
+  // other derived data are rebuilt by Read.
+  static uptr<Track> Read(std::istream &in);
+  void Write(std::ostream &out) const;
+
   void Render(renderer::Renderer *renderer) const;
 
+  // A random point on the track line, facing along the track, or the start of the given segment.
   pair<Vector2, Vector2> StartPosAndOrientation(void) const;
+  pair<Vector2, Vector2> StartPosAndOrientation(unsigned segment) const;
+  unsigned NumSegments(void) const;
 
   float DistanceAlongTrack(const Vector2 &point) const;
   Vector2 NextWaypoint(const Vector2 &point) const;
   float TrackLength(void) const;
 
+  // Index of the track line segment nearest to point. The hinted version is for a point that has
+  // moved a short distance since hint was its nearest segment, and only searches the segments
+  // around hint unless that turns out to be insufficient.
+  unsigned NearestSegment(const Vector2 &point) const;
+  unsigned NearestSegment(const Vector2 &point, unsigned hint) const;
+
+  // Same as above, given the nearest segment to point as returned by NearestSegment.
+  float DistanceAlongTrack(const Vector2 &point, unsigned nearestSegment) const;
+  Vector2 NextWaypoint(const Vector2 &point, unsigned nearestSegment) const;
+
   Maybe<TrackRayIntersection> IntersectRay(const Vector2 &start, const Vector2 &dir) const;
+
+  // Casts numRays rays from a common origin, out[i] receives the result for dirs[i]. Gives the same
+  // results as calling IntersectRay for each ray, but tests packets of rays against all of the
+  // walls at once using SIMD.
+  void IntersectRays(const Vector2 &origin, const Vector2 dirs[], unsigned numRays,
+                     Maybe<TrackRayIntersection> out[]) const;
+
+  // Same as IntersectRay but tests every wall rather than using the spatial index. For testing and
+  // benchmarking.
+  Maybe<TrackRayIntersection> IntersectRayBruteForce(const Vector2 &start, const Vector2 &dir) const;
   vector<CollisionResult> IntersectSphere(const Vector2 &pos, float radius) const;
 
+  // A lower bound on the distance from point to the nearest wall, for cheaply ruling out
+  // collisions. Zero near the walls.
+  float WallClearance(const Vector2 &point) const;
+
 private:
   struct TrackImpl;
   uptr<TrackImpl> impl;
+
+  Track(std::istream &in);
 };
 }
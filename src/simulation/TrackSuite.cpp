@@ -0,0 +1,137 @@
+#include "TrackSuite.hpp"
+#include "../common/BinaryFile.hpp"
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+
+using namespace simulation;
+
+static constexpr char FILE_MAGIC[8] = {'R', 'N', 'N', 'T', 'R', 'A', 'C', 'K'};
+static constexpr uint32_t FILE_FORMAT_VERSION = 1;
+static const string FILE_KIND = "track suite";
+
+struct TrackSuite::FileHeader {
+  char magic[8];
+  uint32_t formatVersion;
+  uint32_t seed;
+  uint32_t numTracks;
+
+  float radius;
+  float trackMinWidth;
+  float trackMaxWidth;
+  uint32_t numLinePoints;
+  uint32_t colorPaletteSize;
+  float maxModStrength;
+
+  uint64_t fileSize;
+  uint64_t checksum; // of everything after the header.
+};
+
+TrackSuite::TrackSuite(const TrackSpec &spec, unsigned numTracks, uint32_t seed,
+                       const string &cachePath) {
+  assert(numTracks > 0);
+
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+  header.formatVersion = FILE_FORMAT_VERSION;
+  header.seed = seed;
+  header.numTracks = numTracks;
+  header.radius = spec.radius;
+  header.trackMinWidth = spec.trackMinWidth;
+  header.trackMaxWidth = spec.trackMaxWidth;
+  header.numLinePoints = spec.numLinePoints;
+  header.colorPaletteSize = spec.colorPaletteSize;
+  header.maxModStrength = spec.maxModStrength;
+
+  if (!cachePath.empty() && read(cachePath, header)) {
+    return;
+  }
+
+  generate(spec, numTracks, seed);
+  if (!cachePath.empty()) {
+    write(cachePath, header);
+  }
+}
+
+// Each track gets its own seed drawn from the suite's, so a track doesn't depend on how many
+// random numbers generating the previous ones took.
+void TrackSuite::generate(const TrackSpec &spec, unsigned numTracks, uint32_t seed) {
+  std::mt19937 rng(seed);
+
+  tracks.clear();
+  startSegments.clear();
+  for (unsigned i = 0; i < numTracks; i++) {
+    uint32_t trackSeed = rng();
+    tracks.push_back(make_shared<Track>(spec, trackSeed));
+    startSegments.push_back(rng() % tracks.back()->NumSegments());
+  }
+}
+
+// Returns false if there is no usable suite in the file, in which case it is regenerated. Only a
+// file that isn't a suite at all is an error, so as not to overwrite something else.
+bool TrackSuite::read(const string &path, const FileHeader &expected) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in.is_open()) {
+    return false;
+  }
+
+  string image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (image.size() < sizeof(FileHeader)) {
+    FailFile(FILE_KIND, path, "too small for a header");
+  }
+
+  FileHeader header;
+  memcpy(&header, image.data(), sizeof(header));
+  if (memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+    FailFile(FILE_KIND, path, "not a track suite");
+  }
+
+  // Everything but the size and checksum has to match what was asked for.
+  FileHeader compared = header;
+  compared.fileSize = expected.fileSize;
+  compared.checksum = expected.checksum;
+  if (memcmp(&compared, &expected, sizeof(FileHeader)) != 0) {
+    return false;
+  }
+
+  if (!FileImageIntact<FileHeader>(image.data(), image.size())) {
+    std::cerr << FILE_KIND << " " << path << ": corrupt, regenerating" << std::endl;
+    return false;
+  }
+
+  std::istringstream body(image.substr(sizeof(FileHeader)));
+  for (unsigned i = 0; i < header.numTracks; i++) {
+    uint32_t startSegment;
+    body.read(reinterpret_cast<char *>(&startSegment), sizeof(startSegment));
+
+    tracks.push_back(Track::Read(body));
+    startSegments.push_back(startSegment);
+    assert(startSegment < tracks.back()->NumSegments());
+  }
+  assert(body.good());
+
+  return true;
+}
+
+void TrackSuite::write(const string &path, const FileHeader &header) const {
+  std::ostringstream body;
+  for (unsigned i = 0; i < tracks.size(); i++) {
+    uint32_t startSegment = startSegments[i];
+    body.write(reinterpret_cast<const char *>(&startSegment), sizeof(startSegment));
+    tracks[i]->Write(body);
+  }
+
+  string image(sizeof(FileHeader), '\0');
+  image += body.str();
+
+  memcpy(&image[0], &header, sizeof(header));
+  SealFileImage<FileHeader>(&image[0], image.size());
+
+  // Renamed over path once written, so a reader never sees a half written suite.
+  WriteFileAtomically(FILE_KIND, path, image.data(), image.size());
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../common/Common.hpp"
+#include "Track.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace simulation {
+
+// A fixed set of tracks for benchmarking agents, along with the segment that an episode on each
+// track starts at. Everything is derived from the seed, so the same seed always gives the same
+// suite and scores on it are comparable between runs.
+//
+// Generating tracks is slow, so the suite is cached in a file: a header with the seed, spec and
+// number of tracks, then each track's start segment and its Track::Write form. The layout is that
+// of the machine that wrote it (native endianness).
+class TrackSuite {
+public:
+  // Reads the suite from cachePath if the file there was written for the same spec, seed and
+  // number of tracks, otherwise generates the suite and writes it to cachePath. The cache is not
+  // used if cachePath is empty. Exits with an error if the file exists but is not a suite file.
+  TrackSuite(const TrackSpec &spec, unsigned numTracks, uint32_t seed, const string &cachePath);
+
+  unsigned NumTracks(void) const { return tracks.size(); }
+  const sptr<Track> &GetTrack(unsigned index) const { return tracks[index]; }
+  unsigned StartSegment(unsigned index) const { return startSegments[index]; }
+
+private:
+  struct FileHeader;
+
+  vector<sptr<Track>> tracks;
+  vector<unsigned> startSegments;
+
+  void generate(const TrackSpec &spec, unsigned numTracks, uint32_t seed);
+  bool read(const string &path, const FileHeader &expected);
+  void write(const string &path, const FileHeader &header) const;
+};
+}
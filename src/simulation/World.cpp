@@ -9,11 +9,16 @@ struct World::WorldImpl {
   float prevProgress = 0.0f;
   float curProgress = 0.0f;
 
-  WorldImpl(const sptr<Track> &track, const CarDef &carDef) : track(track) {
-    auto startState = track->StartPosAndOrientation();
+  // Track line segment nearest to the car, updated incrementally as the car moves.
+  unsigned progressSegment = 0;
+
+  WorldImpl(const sptr<Track> &track, const CarDef &carDef,
+            const pair<Vector2, Vector2> &startState)
+      : track(track) {
     car = make_unique<Car>(carDef, startState.first, startState.second);
 
-    curProgress = track->DistanceAlongTrack(car->GetPos());
+    progressSegment = track->NearestSegment(car->GetPos());
+    curProgress = track->DistanceAlongTrack(car->GetPos(), progressSegment);
     prevProgress = prevProgress;
   }
 
@@ -40,7 +45,8 @@ struct World::WorldImpl {
     float collisionPenalty = 0.0f; // collision ? -0.1f : 0.0f;
 
     prevProgress = curProgress;
-    curProgress = track->DistanceAlongTrack(car->GetPos());
+    progressSegment = track->NearestSegment(car->GetPos(), progressSegment);
+    curProgress = track->DistanceAlongTrack(car->GetPos(), progressSegment);
 
     float progressScale = car->MaxSpeed() * seconds * 2.0f;
 
@@ -58,13 +64,21 @@ struct World::WorldImpl {
   }
 };
 
-World::World(const sptr<Track> &track, const CarDef &carDef) : impl(new WorldImpl(track, carDef)) {}
+World::World(const sptr<Track> &track, const CarDef &carDef)
+    : impl(new WorldImpl(track, carDef, track->StartPosAndOrientation())) {}
+
+World::World(const sptr<Track> &track, const CarDef &carDef, unsigned startSegment)
+    : impl(new WorldImpl(track, carDef, track->StartPosAndOrientation(startSegment))) {}
 World::~World() = default;
 
 void World::Render(renderer::Renderer *renderer) const { impl->Render(renderer); }
 
 float World::Update(float seconds) { return impl->Update(seconds); }
 
+Vector2 World::NextWaypoint(void) const {
+  return impl->track->NextWaypoint(impl->car->GetPos(), impl->progressSegment);
+}
+
 float World::GetProgress(void) { return impl->curProgress / impl->track->TrackLength(); }
 
 Car *World::GetCar(void) { return impl->car.get(); }
@@ -10,6 +10,9 @@ namespace simulation {
 class World {
 public:
   World(const sptr<Track> &track, const CarDef &carDef);
+
+  // Starts the car at the start of the given track segment rather than a random one.
+  World(const sptr<Track> &track, const CarDef &carDef, unsigned startSegment);
   ~World();
 
   void Render(renderer::Renderer *renderer) const;
@@ -17,6 +20,10 @@ public:
   float Update(float seconds);
 
   float GetProgress(void);
+
+  // The next track waypoint ahead of the car, found using the progress tracked by Update.
+  Vector2 NextWaypoint(void) const;
+
   Car* GetCar(void);
   Track* GetTrack(void);
 